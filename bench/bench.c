@@ -0,0 +1,380 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "game.h"
+#include "snapshot.h"
+
+// every benchmark collects this many samples, a sample times a whole batch
+// of operations so the clock overhead disappears in the per op figure
+#define SAMPLES 200
+
+#define FIT_QUERIES 4096
+#define PIECE_GEN_BATCH 65536
+#define FRAMES_PER_SAMPLE 10
+#define SNAPSHOT_BATCH 1024
+#define SPECTATE_WARMUP_PIECES 10
+
+// keeps the compiler from dropping work whose result is unused
+static volatile uint32_t sink;
+
+static bool first_result = true;
+
+static double now_ns() {
+    return (double)SDL_GetPerformanceCounter() * 1e9 /
+           SDL_GetPerformanceFrequency();
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// prints one result object, samples are in ns per operation
+static void report(const char *name, double *samples, int count) {
+    qsort(samples, count, sizeof(double), compare_double);
+    int p99 = (count * 99 + 99) / 100 - 1;
+
+    printf("%s\n    {\"name\": \"%s\", \"unit\": \"ns/op\", \"samples\": %d, "
+           "\"min\": %.2f, \"median\": %.2f, \"p99\": %.2f}",
+           first_result ? "" : ",", name, count, samples[0],
+           samples[count / 2], samples[p99]);
+    fflush(stdout);
+    first_result = false;
+}
+
+// fills the board from the bottom with cells of the given density, the
+// top rows stay empty so pieces can spawn
+static void fill_board(GameState *state, int rows, int percent,
+                       uint32_t *rng) {
+    Board *board = &state->board;
+    for (int y = board->height - rows; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            if ((int)(engine_rand(rng) % 100) >= percent)
+                continue;
+            board->cells[y * board->width + x] = 1;
+            board->rows[y] |= UINT64_C(1) << x;
+            board->fill[y]++;
+        }
+    }
+}
+
+typedef struct {
+    int type;
+    int x;
+    int y;
+    int rotation;
+} FitQuery;
+
+static void bench_fit(const char *name,
+                      bool (*fits)(const Board *, int, int, int, int)) {
+    GameState state;
+    game_state_init(&state, BOARD_WIDTH, BOARD_HEIGHT, 1);
+    uint32_t rng = 1;
+    fill_board(&state, BOARD_HEIGHT / 2, 60, &rng);
+
+    // positions around the board including ones hanging off the edges
+    static FitQuery queries[FIT_QUERIES];
+    for (int i = 0; i < FIT_QUERIES; i++) {
+        queries[i] = (FitQuery){engine_rand(&rng) % PIECE_COUNT,
+                                (int)(engine_rand(&rng) % 14) - 2,
+                                engine_rand(&rng) % BOARD_HEIGHT,
+                                engine_rand(&rng) % 4};
+    }
+
+    double samples[SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+        uint32_t hits = 0;
+        double start = now_ns();
+        for (int i = 0; i < FIT_QUERIES; i++) {
+            const FitQuery *q = &queries[i];
+            hits += fits(&state.board, q->type, q->x, q->y, q->rotation);
+        }
+        samples[s] = (now_ns() - start) / FIT_QUERIES;
+        sink += hits;
+    }
+
+    report(name, samples, SAMPLES);
+    game_state_free(&state);
+}
+
+// locks a vertical I into a well on the right of four full rows at the
+// bottom, so every sample locks a piece and collapses the whole board above
+// four lines
+static void bench_lock_clear(int width, int height) {
+    GameState state;
+    if (!game_state_init(&state, width, height, 1)) {
+        fprintf(stderr, "ERROR: failed to initialize %dx%d board\n", width,
+                height);
+        exit(1);
+    }
+    state.clear_ticks = 0;
+    uint32_t rng = 1;
+
+    double samples[SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+        game_state_reset(&state, s + 1);
+        fill_board(&state, height / 2, 40, &rng);
+
+        Board *board = &state.board;
+        for (int y = height - 4; y < height; y++) {
+            memset(board->cells + y * width, 1, width - 1);
+            board->cells[y * width + width - 1] = 0;
+            board->rows[y] = board->full_row >> 1;
+            board->fill[y] = width - 1;
+        }
+        // the I occupies column 2 of its box
+        state.piece = (Piece){.type = 0, .x = width - 3, .y = height - 4};
+
+        double start = now_ns();
+        int events = game_state_step(&state);
+        samples[s] = now_ns() - start;
+
+        if (!(events & STEP_CLEARED) || state.lines_cleared != 4) {
+            fprintf(stderr, "ERROR: lock on %dx%d board didn't clear lines\n",
+                    width, height);
+            exit(1);
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "lock_clear/%dx%d", width, height);
+    report(name, samples, SAMPLES);
+    game_state_free(&state);
+}
+
+// marks the four rows on top of the stack changed as a lock there would
+static void change_surface(Board *board) {
+    board->changed_top = board->height / 2 - 4;
+    board->changed_bottom = board->height / 2 - 1;
+}
+
+// the undo history of practice mode, every op takes a snapshot of a board
+// half full after a lock changed four rows and drops the one before.
+// restoring goes back and forth between two snapshots four rows apart
+static void bench_snapshot(int width, int height) {
+    GameState state;
+    SnapshotArena arena;
+    if (!game_state_init(&state, width, height, 1) ||
+        !snapshot_arena_init(&arena, width, height)) {
+        fprintf(stderr, "ERROR: failed to initialize %dx%d board\n", width,
+                height);
+        exit(1);
+    }
+    uint32_t rng = 1;
+    fill_board(&state, height / 2, 60, &rng);
+    Snapshot *base = snapshot_take(&arena, &state, NULL);
+    if (base == NULL) {
+        fprintf(stderr, "ERROR: out of memory for snapshots\n");
+        exit(1);
+    }
+
+    double samples[SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+        double start = now_ns();
+        for (int i = 0; i < SNAPSHOT_BATCH; i++) {
+            change_surface(&state.board);
+            Snapshot *snapshot = snapshot_take(&arena, &state, base);
+            snapshot_release(&arena, base);
+            base = snapshot;
+        }
+        samples[s] = (now_ns() - start) / SNAPSHOT_BATCH;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "snapshot_take/%dx%d", width, height);
+    report(name, samples, SAMPLES);
+
+    Board *board = &state.board;
+    for (int y = height / 2 - 4; y < height / 2; y++) {
+        if (board->cells[y * width] != 0)
+            continue;
+        board->cells[y * width] = 1;
+        board->rows[y] |= 1;
+        board->fill[y]++;
+    }
+    change_surface(board);
+    Snapshot *other = snapshot_take(&arena, &state, base);
+    if (other == NULL) {
+        fprintf(stderr, "ERROR: out of memory for snapshots\n");
+        exit(1);
+    }
+
+    for (int s = 0; s < SAMPLES; s++) {
+        double start = now_ns();
+        for (int i = 0; i < SNAPSHOT_BATCH; i += 2) {
+            snapshot_restore(&arena, &state, base, other);
+            snapshot_restore(&arena, &state, other, base);
+        }
+        samples[s] = (now_ns() - start) / SNAPSHOT_BATCH;
+        sink += state.board.rows[height / 2 - 1];
+    }
+
+    snprintf(name, sizeof(name), "snapshot_restore/%dx%d", width, height);
+    report(name, samples, SAMPLES);
+
+    snapshot_release(&arena, other);
+    snapshot_release(&arena, base);
+    snapshot_arena_free(&arena);
+    game_state_free(&state);
+}
+
+static void bench_piece_gen() {
+    uint32_t rng = 1;
+    double samples[SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+        uint32_t sum = 0;
+        double start = now_ns();
+        for (int i = 0; i < PIECE_GEN_BATCH; i++)
+            sum += engine_rand(&rng) % PIECE_COUNT;
+        samples[s] = (now_ns() - start) / PIECE_GEN_BATCH;
+        sink += sum;
+    }
+    report("piece_gen", samples, SAMPLES);
+}
+
+// full play screen frames on the software renderer, or drawn by the raster
+// when cpu is set. the game restarts whenever it ends
+static void bench_frames(int width, int height, bool cpu) {
+    SDL_Window *window = SDL_CreateWindow("Tetris bench", 0, 0, WINDOW_WIDTH,
+                                          WINDOW_HEIGHT, SDL_WINDOW_HIDDEN);
+    SDL_Renderer *renderer =
+        window != NULL ? SDL_CreateRenderer(window, -1,
+                                            SDL_RENDERER_SOFTWARE |
+                                                SDL_RENDERER_TARGETTEXTURE)
+                       : NULL;
+    if (renderer == NULL) {
+        fprintf(stderr, "ERROR: failed to create renderer: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+
+    Game game;
+    game_init(&game, window, renderer, width, height, LINE_CLEAR_TICKS, 1);
+    if (!game_use_raster(&game, cpu)) {
+        fprintf(stderr, "ERROR: failed to set up the raster: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+
+    double samples[SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+        double start = now_ns();
+        for (int i = 0; i < FRAMES_PER_SAMPLE; i++) {
+            if (play_screen(&game) != SCREEN_PLAY)
+                new_game(&game, s + i);
+        }
+        samples[s] = (now_ns() - start) / FRAMES_PER_SAMPLE;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "play_frame%s/%dx%d", cpu ? "_cpu" : "",
+             width, height);
+    report(name, samples, SAMPLES);
+
+    game_free(&game);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+}
+
+// frames of the spectator screen drawn by the raster, with the games
+// running on their thread next to it as they do in the game. the bots
+// look at the current piece only, deeper searches would measure them
+static void bench_spectate_frames(int count) {
+    SDL_Window *window = SDL_CreateWindow("Tetris bench", 0, 0, WINDOW_WIDTH,
+                                          WINDOW_HEIGHT, SDL_WINDOW_HIDDEN);
+    SDL_Renderer *renderer =
+        window != NULL ? SDL_CreateRenderer(window, -1,
+                                            SDL_RENDERER_SOFTWARE |
+                                                SDL_RENDERER_TARGETTEXTURE)
+                       : NULL;
+    if (renderer == NULL) {
+        fprintf(stderr, "ERROR: failed to create renderer: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+
+    Game game;
+    Spectator spectator;
+    game_init(&game, window, renderer, BOARD_WIDTH, BOARD_HEIGHT,
+              LINE_CLEAR_TICKS, 1);
+    if (!game_use_raster(&game, true) ||
+        !spectator_init(&spectator, count, BOARD_WIDTH, BOARD_HEIGHT,
+                        LINE_CLEAR_TICKS, 1, 1, BOT_DEFAULT_BUDGET_MS,
+                        &BOT_DEFAULT_WEIGHTS, 1)) {
+        fprintf(stderr, "ERROR: failed to set up the spectator: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+    game_spectate(&game, &spectator);
+    // empty boards draw next to nothing, the stacks of the bots settle
+    // after ten pieces or so
+    while (SDL_AtomicGet(&spectator.pieces) < count * SPECTATE_WARMUP_PIECES)
+        SDL_Delay(100);
+
+    double samples[SAMPLES];
+    for (int s = 0; s < SAMPLES; s++) {
+        double start = now_ns();
+        for (int i = 0; i < FRAMES_PER_SAMPLE; i++)
+            spectate_screen(&game);
+        samples[s] = (now_ns() - start) / FRAMES_PER_SAMPLE;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "spectate_frame_cpu/%d", count);
+    report(name, samples, SAMPLES);
+
+    spectator_free(&spectator);
+    game_free(&game);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+}
+
+int main(int argc, char **argv) {
+    bool frames = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-frames") == 0) {
+            frames = false;
+        } else {
+            fprintf(stderr, "usage: %s [--no-frames]\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    printf("{\"benchmarks\": [");
+
+    bench_fit("does_piece_fit", does_piece_fit);
+    bench_fit("bitboard_piece_fits", bitboard_piece_fits);
+    bench_lock_clear(BOARD_WIDTH, BOARD_HEIGHT);
+    bench_lock_clear(40, 400);
+    bench_lock_clear(BOARD_MAX_WIDTH, BOARD_MAX_HEIGHT);
+    bench_piece_gen();
+    bench_snapshot(BOARD_WIDTH, BOARD_HEIGHT);
+    bench_snapshot(40, 400);
+
+    if (frames) {
+        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0 ||
+            TTF_Init() < 0) {
+            fprintf(stderr, "ERROR: failed to initialize SDL: %s\n",
+                    SDL_GetError());
+            exit(1);
+        }
+        bench_frames(BOARD_WIDTH, BOARD_HEIGHT, false);
+        bench_frames(40, 400, false);
+        bench_frames(BOARD_WIDTH, BOARD_HEIGHT, true);
+        bench_frames(40, 400, true);
+        bench_spectate_frames(SPECTATE_MIN_GAMES);
+        bench_spectate_frames(SPECTATE_MAX_GAMES);
+        TTF_Quit();
+        SDL_Quit();
+    }
+
+    printf("\n]}\n");
+    return 0;
+}
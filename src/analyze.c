@@ -0,0 +1,239 @@
+#include "analyze.h"
+
+#include <SDL2/SDL_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bot.h"
+#include "engine.h"
+#include "movegen.h"
+
+// score of running out of room
+#define ANALYZE_LOST -1e9f
+
+typedef struct {
+    MoveGen gen;
+    TransTable table;
+    BotWeights weights;
+    int *sequence;
+    // boards[0] is the game, the deeper ones hold the lookahead
+    Board boards[ANALYZE_MAX_DEPTH + 1];
+    MoveList lists[ANALYZE_MAX_DEPTH + 1];
+    uint64_t generated;
+} Analysis;
+
+static bool board_alloc(Board *board, int width, int height) {
+    *board = (Board){.width = width,
+                     .height = height,
+                     .full_row = (UINT64_C(1) << width) - 1,
+                     .cells = calloc((size_t)width * height, 1),
+                     .rows = calloc(height, sizeof(uint64_t)),
+                     .fill = calloc(height, sizeof(int))};
+    board_clean(board);
+    return board->cells != NULL && board->rows != NULL && board->fill != NULL;
+}
+
+static void board_copy(Board *dst, const Board *src) {
+    memcpy(dst->cells, src->cells, (size_t)src->width * src->height);
+    memcpy(dst->rows, src->rows, src->height * sizeof(uint64_t));
+    memcpy(dst->fill, src->fill, src->height * sizeof(int));
+}
+
+static void board_release(Board *board) {
+    free(board->cells);
+    free(board->rows);
+    free(board->fill);
+}
+
+static int board_top(const Board *board) {
+    int top = 0;
+    while (top < board->height && board->rows[top] == 0)
+        top++;
+    return top;
+}
+
+static int count_holes(const Board *board) {
+    int holes = 0;
+    uint64_t seen = 0;
+    for (int y = board_top(board); y < board->height; y++) {
+        holes += __builtin_popcountll(seen & ~board->rows[y]);
+        seen |= board->rows[y];
+    }
+    return holes;
+}
+
+// a straight drop down its column reaches the placement too
+static bool droppable(const Board *board, int type, const Placement *p) {
+    for (int y = 0; y < p->y; y++) {
+        if (!does_piece_fit(board, type, p->x, y, p->rotation))
+            return false;
+    }
+    return true;
+}
+
+// the value of a board only depends on the pieces still to be placed, so
+// the same board with the same pieces ahead shares an entry wherever in
+// the sequence it shows up
+static uint64_t search_key(const Analysis *a, uint64_t board_key, int i,
+                           int depth) {
+    uint64_t key = board_key;
+    for (int k = 0; k < depth; k++) {
+        // rotated by the position so the order of the pieces counts
+        uint64_t piece = a->gen.piece_keys[a->sequence[i + k]];
+        int shift = k * 13;
+        key ^= shift == 0 ? piece : (piece << shift) | (piece >> (64 - shift));
+    }
+    return key;
+}
+
+// best score reachable from boards[level] placing depth more pieces, the
+// first one being sequence[i]
+static float search(Analysis *a, int level, uint64_t board_key, int i,
+                    int depth) {
+    const Board *board = &a->boards[level];
+    if (depth == 0) {
+        return bot_evaluate(&a->weights, board->rows, board->width,
+                            board->height, board_top(board), 0);
+    }
+
+    uint64_t key = search_key(a, board_key, i, depth);
+    float value;
+    if (trans_table_probe(&a->table, key, depth, &value))
+        return value;
+
+    int type = a->sequence[i];
+    MoveList *list = &a->lists[level];
+    int count = movegen_generate(&a->gen, board, type, list);
+    a->generated += count;
+
+    float best = ANALYZE_LOST;
+    Board *child = &a->boards[level + 1];
+    for (int p = 0; p < count; p++) {
+        board_copy(child, board);
+        uint64_t child_key = board_key;
+        int lines = movegen_apply(&a->gen, child, &child_key, type,
+                                  &list->placements[p]);
+        value = a->weights.lines * lines +
+                search(a, level + 1, child_key, i + 1, depth - 1);
+        if (value > best)
+            best = value;
+    }
+
+    trans_table_store(&a->table, key, depth, best);
+    return best;
+}
+
+static void analysis_free(Analysis *a) {
+    movegen_free(&a->gen);
+    trans_table_free(&a->table);
+    free(a->sequence);
+    for (int i = 0; i <= ANALYZE_MAX_DEPTH; i++) {
+        board_release(&a->boards[i]);
+        move_list_free(&a->lists[i]);
+    }
+}
+
+bool analyze_sequence(int width, int height, uint32_t seed, int pieces,
+                      int depth) {
+    Analysis a = {.weights = BOT_DEFAULT_WEIGHTS};
+    bool ok = movegen_init(&a.gen, width, height, seed) &&
+              trans_table_init(&a.table, TRANS_TABLE_BITS);
+    a.sequence = malloc((pieces + depth) * sizeof(int));
+    ok = ok && a.sequence != NULL;
+    for (int i = 0; i <= depth; i++)
+        ok = board_alloc(&a.boards[i], width, height) && ok;
+    if (!ok) {
+        analysis_free(&a);
+        return false;
+    }
+
+    // the same pieces a game with this seed deals
+    GameState state;
+    if (!game_state_init(&state, width, height, seed)) {
+        analysis_free(&a);
+        return false;
+    }
+    a.sequence[0] = state.piece.type;
+    a.sequence[1] = state.next_piece.type;
+    for (int i = 2; i < pieces + depth; i++)
+        a.sequence[i] = engine_rand(&state.rng) % PIECE_COUNT;
+    game_state_free(&state);
+
+    Board *board = &a.boards[0];
+    uint64_t key = movegen_board_key(&a.gen, board);
+    MoveList choices = {0};
+    Board *after = &a.boards[1];
+
+    int placed = 0;
+    int lines = 0;
+    uint64_t total_placements = 0;
+    uint64_t tucks = 0;
+    int fewest = -1;
+    int forced_holes = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < pieces; i++) {
+        int type = a.sequence[i];
+        int count = movegen_generate(&a.gen, board, type, &choices);
+        a.generated += count;
+        if (count == 0)
+            break;
+
+        total_placements += count;
+        if (fewest < 0 || count < fewest)
+            fewest = count;
+
+        int holes = count_holes(board);
+        bool hole_free = false;
+        int best = 0;
+        float best_value = ANALYZE_LOST;
+        for (int p = 0; p < count; p++) {
+            const Placement *placement = &choices.placements[p];
+            if (!droppable(board, type, placement))
+                tucks++;
+
+            board_copy(after, board);
+            uint64_t after_key = key;
+            int cleared =
+                movegen_apply(&a.gen, after, &after_key, type, placement);
+            if (count_holes(after) <= holes)
+                hole_free = true;
+
+            float value = a.weights.lines * cleared +
+                          search(&a, 1, after_key, i + 1, depth - 1);
+            if (value > best_value) {
+                best_value = value;
+                best = p;
+            }
+        }
+        if (!hole_free)
+            forced_holes++;
+
+        lines += movegen_apply(&a.gen, board, &key, type,
+                               &choices.placements[best]);
+        placed++;
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) /
+                     SDL_GetPerformanceFrequency();
+
+    printf("seed %u: %d of %d pieces placed on %dx%d looking %d ahead, %d "
+           "lines%s\n",
+           seed, placed, pieces, width, height, depth - 1, lines,
+           placed < pieces ? ", topped out" : "");
+    printf("reachable placements per piece: mean %.1f, fewest %d, %.1f%% "
+           "need a tuck or spin\n",
+           placed > 0 ? (double)total_placements / placed : 0.0, fewest,
+           total_placements > 0 ? 100.0 * tucks / total_placements : 0.0);
+    printf("pieces with no placement free of new holes: %d (%.1f%%)\n",
+           forced_holes, placed > 0 ? 100.0 * forced_holes / placed : 0.0);
+    printf("%llu placements generated in %.3fs (%.0f/s), table hits "
+           "%llu/%llu\n",
+           (unsigned long long)a.generated, seconds,
+           seconds > 0 ? a.generated / seconds : 0.0,
+           (unsigned long long)a.table.hits,
+           (unsigned long long)a.table.probes);
+
+    move_list_free(&choices);
+    analysis_free(&a);
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// pieces the analysis looks ahead, the piece being placed included
+#define ANALYZE_MAX_DEPTH 4
+#define ANALYZE_DEFAULT_DEPTH 2
+
+// plays the first pieces pieces of the sequence a game started with seed
+// would get, each placed with full knowledge of the depth - 1 after it, and
+// prints how much room the sequence left: reachable placements, how many
+// need a tuck or spin, and how often every placement makes a hole. returns
+// false when the search could not be set up
+bool analyze_sequence(int width, int height, uint32_t seed, int pieces,
+                      int depth);
+
+#endif
@@ -0,0 +1,54 @@
+#include "assets.h"
+
+#include <SDL2/SDL_error.h>
+#include <stdint.h>
+#include <string.h>
+
+// defined in assets_pack.S
+extern const unsigned char assets_pack[];
+extern const unsigned char assets_pack_end[];
+
+#define HEADER_SIZE 8
+#define ENTRY_SIZE (ASSET_NAME_LENGTH + 8)
+
+static uint32_t get_u32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+const void *asset_data(const char *name, size_t *length) {
+    size_t size = assets_pack_end - assets_pack;
+    if (size < HEADER_SIZE || memcmp(assets_pack, "TPAK", 4) != 0) {
+        SDL_SetError("asset pack is corrupt");
+        return NULL;
+    }
+
+    uint32_t count = get_u32(assets_pack + 4);
+    if (count > (size - HEADER_SIZE) / ENTRY_SIZE) {
+        SDL_SetError("asset pack is corrupt");
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char *entry = assets_pack + HEADER_SIZE + i * ENTRY_SIZE;
+        if (strncmp((const char *)entry, name, ASSET_NAME_LENGTH) != 0)
+            continue;
+
+        uint32_t offset = get_u32(entry + ASSET_NAME_LENGTH);
+        uint32_t entry_length = get_u32(entry + ASSET_NAME_LENGTH + 4);
+        if (offset > size || entry_length > size - offset) {
+            SDL_SetError("asset %s is out of bounds", name);
+            return NULL;
+        }
+        *length = entry_length;
+        return assets_pack + offset;
+    }
+
+    SDL_SetError("no asset named %s", name);
+    return NULL;
+}
+
+SDL_RWops *asset_open(const char *name) {
+    size_t length;
+    const void *data = asset_data(name, &length);
+    return data != NULL ? SDL_RWFromConstMem(data, length) : NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <SDL2/SDL_rwops.h>
+#include <stddef.h>
+
+// the files under assets/ are packed into build/assets.pack by tools/pack.c
+// and linked into the binary, so nothing is read from the working
+// directory at run time
+//
+// pack layout, integers are little endian:
+//   "TPAK", entry count u32, then per entry a name of ASSET_NAME_LENGTH
+//   bytes padded with zeros, the offset u32 and size u32 of the data
+// the data of every entry starts at a multiple of 16
+
+#define ASSET_NAME_LENGTH 48
+
+// the embedded data of the packed file name and its length, NULL with the
+// SDL error set if there is no such file
+const void *asset_data(const char *name, size_t *length);
+
+// opens the packed file name, relative to assets/, as a read only stream
+// over the embedded data. returns NULL if there is no such file
+SDL_RWops *asset_open(const char *name);
+
+#endif
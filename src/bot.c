@@ -0,0 +1,430 @@
+#include "bot.h"
+
+#include <SDL2/SDL_timer.h>
+#include <stdlib.h>
+#include <string.h>
+
+// score of a board the game is lost on
+#define BOT_LOST -1e9f
+// nodes a worker visits between two looks at the clock
+#define CLOCK_INTERVAL 16
+
+static uint64_t *scratch_rows(Bot *bot, int worker, int level) {
+    return bot->scratch +
+           ((size_t)worker * BOT_MAX_DEPTH + level) * bot->height;
+}
+
+// rotations with the same mask as a lower one give the same placements
+static bool repeated_rotation(int type, int rotation) {
+    for (int r = 0; r < rotation; r++) {
+        if (memcmp(piece_masks[type][r], piece_masks[type][rotation], 4) ==
+            0)
+            return true;
+    }
+    return false;
+}
+
+// drops the piece straight down column x and collapses the lines it
+// completes, the result goes to out. returns the number of lines, or -1
+// when the piece doesn't fit above the stack
+static int drop(const Bot *bot, const uint64_t *rows, int top, int type,
+                int rotation, int x, uint64_t *out, int *out_top) {
+    // the search boards only have row masks, which is all the bitboard
+    // test reads
+    Board board = {.width = bot->width,
+                   .height = bot->height,
+                   .full_row = bot->full_row,
+                   .rows = (uint64_t *)rows};
+
+    // everything above top is empty, so the piece falls freely until there
+    int y = top > 4 ? top - 4 : 0;
+    if (!bitboard_piece_fits(&board, type, x, y, rotation))
+        return -1;
+    while (bitboard_piece_fits(&board, type, x, y + 1, rotation))
+        y++;
+
+    // nothing reads more than 4 rows above the top of a board, so only the
+    // stack is copied, with 4 empty rows on top of it
+    int start = top > 4 ? top - 4 : 0;
+    int clear = start > 4 ? start - 4 : 0;
+    memset(out + clear, 0, (start - clear) * sizeof(uint64_t));
+    memcpy(out + start, rows + start,
+           (bot->height - start) * sizeof(uint64_t));
+    const uint8_t *mask = piece_masks[type][rotation];
+    int lines = 0;
+    for (int py = 0; py < 4; py++) {
+        if (mask[py] == 0)
+            continue;
+        out[y + py] |= x < 0 ? (uint64_t)mask[py] >> -x
+                             : (uint64_t)mask[py] << x;
+        if (out[y + py] == bot->full_row)
+            lines++;
+    }
+
+    int new_top = y < top ? y : top;
+    if (lines > 0) {
+        int dst = y + 3 < bot->height ? y + 3 : bot->height - 1;
+        for (int src = dst; src >= new_top; src--) {
+            if (out[src] != bot->full_row)
+                out[dst--] = out[src];
+        }
+        while (dst >= new_top)
+            out[dst--] = 0;
+        new_top += lines;
+    }
+
+    *out_top = new_top;
+    return lines;
+}
+
+float bot_evaluate(const BotWeights *weights, const uint64_t *rows,
+                   int width, int height, int top, int lines) {
+    int heights[BOARD_MAX_WIDTH] = {0};
+    int holes = 0;
+    uint64_t seen = 0;
+    for (int y = top; y < height; y++) {
+        holes += __builtin_popcountll(seen & ~rows[y]);
+        for (uint64_t fresh = rows[y] & ~seen; fresh != 0;
+             fresh &= fresh - 1)
+            heights[__builtin_ctzll(fresh)] = height - y;
+        seen |= rows[y];
+    }
+
+    int aggregate = heights[0];
+    int bumpiness = 0;
+    for (int x = 1; x < width; x++) {
+        aggregate += heights[x];
+        bumpiness += abs(heights[x] - heights[x - 1]);
+    }
+
+    return weights->height * aggregate + weights->lines * lines +
+           weights->holes * holes + weights->bumpiness * bumpiness;
+}
+
+static float evaluate(const Bot *bot, const uint64_t *rows, int top,
+                      int lines) {
+    return bot_evaluate(&bot->weights, rows, bot->width, bot->height, top,
+                        lines);
+}
+
+// counts a node and gives up the search once the budget is spent
+static bool visit(Bot *bot, int worker) {
+    uint64_t nodes = ++bot->counters[worker].nodes;
+    if (bot->deadline != 0 && nodes % CLOCK_INTERVAL == 0 &&
+        SDL_GetPerformanceCounter() > bot->deadline)
+        SDL_AtomicSet(&bot->abort, 1);
+    return !SDL_AtomicGet(&bot->abort);
+}
+
+static float expected(Bot *bot, int worker, const uint64_t *rows, int top,
+                      int plies, int lines, int level);
+
+// best score over the placements of type, with plies more pieces to come
+// after it
+static float best_placement(Bot *bot, int worker, const uint64_t *rows,
+                            int top, int type, int plies, int lines,
+                            int level) {
+    uint64_t *out = scratch_rows(bot, worker, level);
+    float best = BOT_LOST;
+    for (int r = 0; r < 4; r++) {
+        if (repeated_rotation(type, r))
+            continue;
+
+        for (int x = -3; x < bot->width; x++) {
+            int out_top;
+            int cleared = drop(bot, rows, top, type, r, x, out, &out_top);
+            if (cleared < 0)
+                continue;
+            if (!visit(bot, worker))
+                return best;
+
+            float value =
+                plies == 0
+                    ? evaluate(bot, out, out_top, lines + cleared)
+                    : expected(bot, worker, out, out_top, plies,
+                               lines + cleared, level + 1);
+            if (value > best)
+                best = value;
+        }
+    }
+    return best;
+}
+
+// the pieces after the next one are unknown, so average over all of them
+static float expected(Bot *bot, int worker, const uint64_t *rows, int top,
+                      int plies, int lines, int level) {
+    float sum = 0;
+    for (int type = 0; type < PIECE_COUNT; type++)
+        sum += best_placement(bot, worker, rows, top, type, plies - 1, lines,
+                              level);
+    return sum / PIECE_COUNT;
+}
+
+// places the next piece after a root placement and searches what is left
+static void search_child(void *arg, int worker) {
+    BotTask *task = arg;
+    Bot *bot = task->bot;
+    if (SDL_AtomicGet(&bot->abort))
+        return;
+
+    const BotTask *root = &bot->roots[task->root];
+    const uint64_t *rows = bot->root_rows + (size_t)task->root * bot->height;
+    uint64_t *out = scratch_rows(bot, worker, 0);
+    int top;
+    int cleared = drop(bot, rows, root->top, bot->next_type, task->rotation,
+                       task->x, out, &top);
+    int plies = bot->search_depth - 2;
+    task->value =
+        plies == 0
+            ? evaluate(bot, out, top, root->lines + cleared)
+            : expected(bot, worker, out, top, plies, root->lines + cleared,
+                       1);
+}
+
+// spawns a task for every placement of the next piece after the root
+static void search_root(void *arg, int worker) {
+    BotTask *task = arg;
+    Bot *bot = task->bot;
+    int i = task - bot->roots;
+    const uint64_t *rows = bot->root_rows + (size_t)i * bot->height;
+
+    if (bot->search_depth == 1) {
+        task->value = evaluate(bot, rows, task->top, task->lines);
+        return;
+    }
+
+    BotTask *children = bot->children + (size_t)i * bot->max_moves;
+    uint64_t *out = scratch_rows(bot, worker, 0);
+    int count = 0;
+    for (int r = 0; r < 4; r++) {
+        if (repeated_rotation(bot->next_type, r))
+            continue;
+
+        for (int x = -3; x < bot->width; x++) {
+            int top;
+            if (drop(bot, rows, task->top, bot->next_type, r, x, out, &top) <
+                0)
+                continue;
+            if (!visit(bot, worker))
+                break;
+
+            children[count] = (BotTask){
+                .bot = bot, .root = i, .rotation = r, .x = x, .value = 0};
+            pool_push(&bot->pool, worker, search_child, &children[count]);
+            count++;
+        }
+    }
+    bot->child_count[i] = count;
+}
+
+bool bot_init(Bot *bot, int width, int height, int depth, int threads) {
+    memset(bot, 0, sizeof(*bot));
+    if (!pool_init(&bot->pool, threads))
+        return false;
+
+    bot->weights = BOT_DEFAULT_WEIGHTS;
+    bot->depth = depth;
+    bot->budget_ms = BOT_DEFAULT_BUDGET_MS;
+    bot->width = width;
+    bot->height = height;
+    bot->full_row = (UINT64_C(1) << width) - 1;
+    bot->max_moves = 4 * (width + 3);
+
+    int workers = bot->pool.thread_count;
+    size_t rows = height * sizeof(uint64_t);
+    bot->board_rows = malloc(rows);
+    bot->roots = calloc(bot->max_moves, sizeof(BotTask));
+    bot->children =
+        calloc((size_t)bot->max_moves * bot->max_moves, sizeof(BotTask));
+    bot->child_count = calloc(bot->max_moves, sizeof(int));
+    bot->root_rows = malloc(bot->max_moves * rows);
+    bot->scratch = malloc((size_t)workers * BOT_MAX_DEPTH * rows);
+    bot->counters = aligned_alloc(alignof(BotCounter),
+                                  workers * sizeof(BotCounter));
+    if (bot->board_rows == NULL || bot->roots == NULL ||
+        bot->children == NULL || bot->child_count == NULL ||
+        bot->root_rows == NULL || bot->scratch == NULL ||
+        bot->counters == NULL) {
+        bot_free(bot);
+        return false;
+    }
+    memset(bot->counters, 0, workers * sizeof(BotCounter));
+    return true;
+}
+
+// best placement of the current piece according to the last finished
+// search
+static BotMove best_root(const Bot *bot) {
+    BotMove best = {.score = BOT_LOST};
+    for (int i = 0; i < bot->root_count; i++) {
+        const BotTask *root = &bot->roots[i];
+        float value = root->value;
+        if (bot->search_depth > 1) {
+            // the next piece fits nowhere, the game ends here
+            value = BOT_LOST;
+            const BotTask *children =
+                bot->children + (size_t)i * bot->max_moves;
+            for (int j = 0; j < bot->child_count[i]; j++) {
+                if (children[j].value > value)
+                    value = children[j].value;
+            }
+        }
+
+        if (!best.found || value > best.score) {
+            best = (BotMove){.rotation = root->rotation,
+                             .x = root->x,
+                             .score = value,
+                             .found = true};
+        }
+    }
+    return best;
+}
+
+BotMove bot_decide(Bot *bot, const GameState *state) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    // an aborted ply takes a moment to wind down, keep a tenth of the
+    // budget for it
+    // the counter runs in the trillions, only the offset goes through
+    // floating point
+    bot->deadline =
+        bot->budget_ms > 0
+            ? start + (Uint64)(bot->budget_ms * 0.9 * frequency / 1000)
+            : 0;
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < bot->pool.thread_count; i++)
+        nodes += bot->counters[i].nodes;
+
+    // completed lines may still be on the board, waiting for the clear
+    // animation to end
+    const Board *board = &state->board;
+    int dst = bot->height - 1;
+    for (int y = bot->height - 1; y >= 0; y--) {
+        if (board->rows[y] != bot->full_row)
+            bot->board_rows[dst--] = board->rows[y];
+    }
+    while (dst >= 0)
+        bot->board_rows[dst--] = 0;
+    int top = 0;
+    while (top < bot->height && bot->board_rows[top] == 0)
+        top++;
+
+    // the placements of the current piece are few, find them right here
+    int type = state->piece.type;
+    bot->next_type = state->next_piece.type;
+    bot->root_count = 0;
+    for (int r = 0; r < 4; r++) {
+        if (repeated_rotation(type, r))
+            continue;
+
+        for (int x = -3; x < bot->width; x++) {
+            BotTask *root = &bot->roots[bot->root_count];
+            int lines = drop(
+                bot, bot->board_rows, top, type, r, x,
+                bot->root_rows + (size_t)bot->root_count * bot->height,
+                &root->top);
+            if (lines < 0)
+                continue;
+
+            bot->counters[0].nodes++;
+            root->bot = bot;
+            root->root = -1;
+            root->rotation = r;
+            root->x = x;
+            root->lines = lines;
+            bot->root_count++;
+        }
+    }
+
+    // deepen one ply at a time, a ply cut short by the deadline is thrown
+    // away. the first one only evaluates the roots and always finishes
+    BotMove best = {.score = BOT_LOST};
+    bot->last_depth = 0;
+    // nodes of the last two plies, the first one is the roots
+    uint64_t prev_nodes = 1;
+    uint64_t ply_nodes = bot->root_count;
+    Uint64 ply_time = 0;
+    for (int depth = 1; depth <= bot->depth; depth++) {
+        Uint64 ply_start = SDL_GetPerformanceCounter();
+        if (depth > 1 && bot->deadline != 0) {
+            // a ply costs about as many times the last one as the last one
+            // did its predecessor, and the first ply past the next piece
+            // also averages over seven pieces. don't start what can't
+            // finish anyway
+            double growth = (double)ply_nodes / prev_nodes;
+            if (depth == 3)
+                growth *= PIECE_COUNT;
+            if (ply_start >= bot->deadline ||
+                ply_time * growth > (double)(bot->deadline - ply_start))
+                break;
+        }
+
+        uint64_t before = 0;
+        for (int i = 0; i < bot->pool.thread_count; i++)
+            before += bot->counters[i].nodes;
+
+        bot->search_depth = depth;
+        SDL_AtomicSet(&bot->abort, 0);
+        for (int i = 0; i < bot->root_count; i++)
+            pool_push(&bot->pool, 0, search_root, &bot->roots[i]);
+        pool_run(&bot->pool);
+        ply_time = SDL_GetPerformanceCounter() - ply_start;
+
+        if (depth > 1) {
+            uint64_t after = 0;
+            for (int i = 0; i < bot->pool.thread_count; i++)
+                after += bot->counters[i].nodes;
+            prev_nodes = ply_nodes;
+            ply_nodes = after - before;
+        }
+
+        if (SDL_AtomicGet(&bot->abort))
+            break;
+        best = best_root(bot);
+        bot->last_depth = depth;
+    }
+
+    uint64_t total = 0;
+    for (int i = 0; i < bot->pool.thread_count; i++)
+        total += bot->counters[i].nodes;
+    bot->last_nodes = total - nodes;
+    bot->last_ms =
+        (double)(SDL_GetPerformanceCounter() - start) * 1000 / frequency;
+
+    bot->decisions++;
+    bot->total_nodes += bot->last_nodes;
+    bot->total_ms += bot->last_ms;
+    if (bot->last_ms > bot->max_ms)
+        bot->max_ms = bot->last_ms;
+    return best;
+}
+
+int bot_input(const Piece *piece, BotMove move) {
+    if (!move.found)
+        return INPUT_NONE;
+    if (piece->rotation != move.rotation)
+        return INPUT_ROTATE;
+    if (piece->x < move.x)
+        return INPUT_RIGHT;
+    if (piece->x > move.x)
+        return INPUT_LEFT;
+    return INPUT_SOFT_DROP;
+}
+
+double bot_nodes_per_second(const Bot *bot) {
+    return bot->total_ms > 0 ? bot->total_nodes * 1000.0 / bot->total_ms
+                             : 0.0;
+}
+
+void bot_free(Bot *bot) {
+    pool_free(&bot->pool);
+    free(bot->board_rows);
+    free(bot->roots);
+    free(bot->children);
+    free(bot->child_count);
+    free(bot->root_rows);
+    free(bot->scratch);
+    free(bot->counters);
+    memset(bot, 0, sizeof(*bot));
+}
@@ -0,0 +1,130 @@
+#ifndef BOT_H
+#define BOT_H
+
+// computer player. it tries every rotation and column of the current
+// piece, then every placement of the next piece on each resulting board,
+// and beyond that averages over the seven pieces that could come. boards
+// are scored by a weighted sum of features
+//
+// the search is spread over a work stealing pool and deepened one ply at a
+// time until the time budget runs out, the deepest finished ply decides
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_stdinc.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine.h"
+#include "pool.h"
+
+// plies, the first two are the current and the next piece
+#define BOT_MAX_DEPTH 4
+#define BOT_DEFAULT_DEPTH 2
+// one tick
+#define BOT_DEFAULT_BUDGET_MS (1000.0f / TICK_RATE)
+
+typedef struct {
+    // sum of the column heights
+    float height;
+    // lines cleared on the way to the board
+    float lines;
+    // empty cells with a filled cell somewhere above them
+    float holes;
+    // sum of the height differences of neighbouring columns
+    float bumpiness;
+} BotWeights;
+
+// tuned for 10x20 boards
+#define BOT_DEFAULT_WEIGHTS                                                    \
+    ((BotWeights){.height = -0.510066f,                                        \
+                  .lines = 0.760666f,                                          \
+                  .holes = -0.35663f,                                          \
+                  .bumpiness = -0.184483f})
+
+typedef struct {
+    int rotation;
+    int x;
+    float score;
+    // false when the piece fits nowhere
+    bool found;
+} BotMove;
+
+// a placement searched by a pool task, root is the index of the placement
+// of the current piece it follows, or -1 for those of the current piece
+typedef struct {
+    struct Bot *bot;
+    int root;
+    int rotation;
+    int x;
+    // lines cleared by the placements up to this one
+    int lines;
+    // no row above top has anything in it
+    int top;
+    float value;
+} BotTask;
+
+// node counter of a worker, on its own cache line
+typedef struct {
+    alignas(64) uint64_t nodes;
+} BotCounter;
+
+typedef struct Bot {
+    TaskPool pool;
+    BotWeights weights;
+    int depth;
+    // time a decision may take, 0 always searches depth plies
+    float budget_ms;
+    int width;
+    int height;
+    uint64_t full_row;
+    // placements a piece can have on this board size
+    int max_moves;
+
+    // search in progress
+    int search_depth;
+    int next_type;
+    Uint64 deadline;
+    SDL_atomic_t abort;
+    // board of the game without the lines waiting to collapse
+    uint64_t *board_rows;
+    BotTask *roots;
+    int root_count;
+    // children of root i are children[i * max_moves], child_count[i] of them
+    BotTask *children;
+    int *child_count;
+    // board after each root placement, height rows each
+    uint64_t *root_rows;
+    // per worker boards for the deeper plies, BOT_MAX_DEPTH * height rows
+    uint64_t *scratch;
+    BotCounter *counters;
+
+    // last decision
+    int last_depth;
+    uint64_t last_nodes;
+    double last_ms;
+    // all decisions so far
+    int decisions;
+    uint64_t total_nodes;
+    double total_ms;
+    double max_ms;
+} Bot;
+
+// score of the board given by its row masks, top is a row with nothing
+// above it and lines the lines cleared on the way there
+float bot_evaluate(const BotWeights *weights, const uint64_t *rows,
+                   int width, int height, int top, int lines);
+
+// threads <= 0 uses every core. returns false when the pool or the search
+// buffers could not be set up
+bool bot_init(Bot *bot, int width, int height, int depth, int threads);
+// picks where the current piece of state should go
+BotMove bot_decide(Bot *bot, const GameState *state);
+// the input that brings piece one step closer to move: rotate, then slide,
+// then soft drop
+int bot_input(const Piece *piece, BotMove move);
+// nodes per second over all decisions so far
+double bot_nodes_per_second(const Bot *bot);
+void bot_free(Bot *bot);
+
+#endif
@@ -0,0 +1,599 @@
+#include "engine.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TETRIMINO_I "..x...x...x...x."
+#define TETRIMINO_O ".xx..xx........."
+#define TETRIMINO_S ".....xx.xx......"
+#define TETRIMINO_Z "....xx...xx....."
+#define TETRIMINO_L ".....x...x...xx."
+#define TETRIMINO_J "......x...x..xx."
+#define TETRIMINO_T "....xxx..x......"
+
+const char tetriminos[PIECE_COUNT][16] = {
+    TETRIMINO_I, TETRIMINO_O, TETRIMINO_S, TETRIMINO_Z,
+    TETRIMINO_L, TETRIMINO_J, TETRIMINO_T};
+
+// compile time version of rotate()
+#define ROTATE(x, y, r)                                                        \
+    ((r) == 0   ? (y) * 4 + (x)                                                \
+     : (r) == 1 ? 12 + (y) - 4 * (x)                                           \
+     : (r) == 2 ? 15 - (x) - 4 * (y)                                           \
+                : 3 - (y) + 4 * (x))
+
+#define CELL_BIT(s, x, y, r) (((s)[ROTATE(x, y, r)] == 'x') << (x))
+#define ROW_MASK(s, y, r)                                                      \
+    (CELL_BIT(s, 0, y, r) | CELL_BIT(s, 1, y, r) | CELL_BIT(s, 2, y, r) |      \
+     CELL_BIT(s, 3, y, r))
+#define ROTATION_MASKS(s, r)                                                   \
+    {ROW_MASK(s, 0, r), ROW_MASK(s, 1, r), ROW_MASK(s, 2, r), ROW_MASK(s, 3, r)}
+#define PIECE_MASKS(s)                                                         \
+    {ROTATION_MASKS(s, 0), ROTATION_MASKS(s, 1), ROTATION_MASKS(s, 2),         \
+     ROTATION_MASKS(s, 3)}
+
+const uint8_t piece_masks[PIECE_COUNT][4][4] = {
+    PIECE_MASKS(TETRIMINO_I), PIECE_MASKS(TETRIMINO_O),
+    PIECE_MASKS(TETRIMINO_S), PIECE_MASKS(TETRIMINO_Z),
+    PIECE_MASKS(TETRIMINO_L), PIECE_MASKS(TETRIMINO_J),
+    PIECE_MASKS(TETRIMINO_T)};
+
+int rotate(int x, int y, int rotation) {
+    switch (rotation) {
+    // 0 deg
+    case 0:
+        return y * 4 + x;
+    // 90 deg
+    case 1:
+        return 12 + y - 4 * x;
+    // 180 deg
+    case 2:
+        return 15 - x - 4 * y;
+    // 270 deg
+    case 3:
+        return 3 - y + 4 * x;
+    }
+
+    return 0;
+}
+
+bool board_size_valid(int width, int height) {
+    // pieces need a 4x4 box to spawn in
+    return width >= 4 && width <= BOARD_MAX_WIDTH && height >= 4 &&
+           height <= BOARD_MAX_HEIGHT;
+}
+
+static void mark_dirty(Board *board, int top, int bottom) {
+    if (top < board->dirty_top)
+        board->dirty_top = top;
+    if (bottom > board->dirty_bottom)
+        board->dirty_bottom = bottom;
+    if (top < board->changed_top)
+        board->changed_top = top;
+    if (bottom > board->changed_bottom)
+        board->changed_bottom = bottom;
+}
+
+void board_clean(Board *board) {
+    board->dirty_top = board->height;
+    board->dirty_bottom = -1;
+}
+
+bool does_piece_fit(const Board *board, int type, int x, int y, int rotation) {
+    const char *shape = tetriminos[type];
+    for (int px = 0; px < 4; px++) {
+        for (int py = 0; py < 4; py++) {
+            // get index into piece
+            int pi = rotate(px, py, rotation);
+
+            // get index into board
+            int bi = (py + y) * board->width + (px + x);
+
+            if (shape[pi] == 'x') {
+                if (px + x < 0 || px + x >= board->width || py + y < 0 ||
+                    py + y >= board->height) {
+                    return false;
+                }
+            }
+
+            if (px + x >= 0 && px + x < board->width && py + y >= 0 &&
+                py + y < board->height) {
+                if (shape[pi] == 'x' && board->cells[bi] != 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool bitboard_piece_fits(const Board *board, int type, int x, int y,
+                         int rotation) {
+    // the whole 4x4 box is past a wall
+    if (x <= -4 || x >= board->width)
+        return false;
+
+    const uint8_t *mask = piece_masks[type][rotation];
+    for (int py = 0; py < 4; py++) {
+        uint64_t m = mask[py];
+        if (m == 0)
+            continue;
+
+        if (y + py < 0 || y + py >= board->height)
+            return false;
+
+        if (x < 0) {
+            // cells shifted past the left wall
+            if (m & ((UINT64_C(1) << -x) - 1))
+                return false;
+            m >>= -x;
+        } else {
+            m <<= x;
+        }
+
+        if ((m & ~board->full_row) || (board->rows[y + py] & m))
+            return false;
+    }
+    return true;
+}
+
+// every fit test of the engine, make test checks that it agrees with
+// does_piece_fit
+static inline bool piece_fits(const Board *board, int type, int x, int y,
+                              int rotation) {
+    return bitboard_piece_fits(board, type, x, y, rotation);
+}
+
+#ifndef NDEBUG
+// row mask rebuilt from the cells, used to check the locking code
+static uint64_t row_bits(const Board *board, int py) {
+    uint64_t bits = 0;
+    for (int px = 0; px < board->width; px++) {
+        if (board->cells[py * board->width + px] != 0)
+            bits |= UINT64_C(1) << px;
+    }
+    return bits;
+}
+#endif
+
+// xorshift32, every game carries its own state so games stay independent
+uint32_t engine_rand(uint32_t *rng) {
+    uint32_t x = *rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng = x;
+    return x;
+}
+
+static uint32_t seed_rng(uint32_t seed) {
+    // xorshift gets stuck on zero
+    return seed != 0 ? seed : 0x9e3779b9u;
+}
+
+Piece spawn_piece(const Board *board, int type) {
+    // keep the 4x4 box on narrow boards
+    int x = board->width / 2;
+    if (x > board->width - 4)
+        x = board->width - 4;
+    return (Piece){.type = type, .x = x, .y = 0, .rotation = 0};
+}
+
+static void board_clear(Board *board) {
+    memset(board->cells, 0, (size_t)board->width * board->height);
+    memset(board->rows, 0, board->height * sizeof(uint64_t));
+    memset(board->fill, 0, board->height * sizeof(int));
+    board->dirty_top = 0;
+    board->dirty_bottom = board->height - 1;
+    board->changed_top = 0;
+    board->changed_bottom = board->height - 1;
+}
+
+static void apply_input(const Board *board, Piece *piece, int input) {
+    if (input & INPUT_ROTATE) {
+        int next_rot = (piece->rotation + 1) % 4;
+        if (piece_fits(board, piece->type, piece->x, piece->y, next_rot))
+            piece->rotation = next_rot;
+    }
+
+    if (input & INPUT_RIGHT) {
+        if (piece_fits(board, piece->type, piece->x + 1, piece->y,
+                       piece->rotation))
+            piece->x += 1;
+    }
+
+    if (input & INPUT_LEFT) {
+        if (piece_fits(board, piece->type, piece->x - 1, piece->y,
+                       piece->rotation))
+            piece->x -= 1;
+    }
+
+    if (input & INPUT_SOFT_DROP) {
+        if (piece_fits(board, piece->type, piece->x, piece->y + 1,
+                       piece->rotation))
+            piece->y += 1;
+    }
+}
+
+// applies one tick of gravity to the piece, or locks it and spawns the
+// next one. the piece never moves more than one row per tick. completed
+// lines are marked with CELL_LINE and recorded in lines
+static int step_piece(Board *board, Piece *piece, int *next_type, int *fall,
+                      int yspeed, uint32_t *rng, int *lines,
+                      int *line_count) {
+    if (piece_fits(board, piece->type, piece->x, piece->y + 1,
+                   piece->rotation)) {
+        *fall += yspeed;
+        if (*fall >= TICK_RATE) {
+            *fall -= TICK_RATE;
+            piece->y += 1;
+        }
+        return 0;
+    }
+
+    int events = STEP_LOCKED;
+
+    // piece can't fit, so copy it onto the board. the masks only touch
+    // rows and columns the fit test already proved to be on the board.
+    // rows are visited top to bottom so lines ends up sorted
+    const uint8_t *mask = piece_masks[piece->type][piece->rotation];
+    for (int py = 0; py < 4; py++) {
+        if (mask[py] == 0)
+            continue;
+
+        int by = piece->y + py;
+        mark_dirty(board, by, by);
+        uint64_t m = piece->x < 0 ? (uint64_t)mask[py] >> -piece->x
+                                  : (uint64_t)mask[py] << piece->x;
+        board->rows[by] |= m;
+        board->fill[by] += __builtin_popcountll(m);
+
+        unsigned char *row = board->cells + by * board->width;
+        for (int px = 0; px < 4; px++) {
+            if (mask[py] & (1 << px))
+                row[piece->x + px] = piece->type + 1;
+        }
+        assert(board->rows[by] == row_bits(board, by));
+
+        // check if line is formed
+        if (board->fill[by] == board->width) {
+            memset(row, CELL_LINE, board->width);
+            lines[(*line_count)++] = by;
+            events |= STEP_LINES;
+        }
+    }
+
+    *piece = spawn_piece(board, *next_type);
+    *next_type = engine_rand(rng) % PIECE_COUNT;
+    *fall = 0;
+
+    if (!piece_fits(board, piece->type, piece->x, piece->y, piece->rotation))
+        events |= STEP_OVER;
+
+    return events;
+}
+
+// collapses the marked lines in a single bottom up pass where every
+// surviving row moves at most once, returns the points earned
+static uint32_t clear_lines(Board *board, const int *lines, int line_count) {
+    if (line_count == 0)
+        return 0;
+
+    int w = board->width;
+
+    // rows below the lowest cleared line stay where they are
+    int dst = lines[line_count - 1];
+    mark_dirty(board, 0, dst);
+    for (int src = dst; src >= 0; src--) {
+        if (board->fill[src] == w)
+            continue;
+
+        if (dst != src) {
+            memcpy(board->cells + dst * w, board->cells + src * w, w);
+            board->rows[dst] = board->rows[src];
+            board->fill[dst] = board->fill[src];
+        }
+        dst--;
+    }
+
+    // the top is left empty
+    memset(board->cells, 0, (size_t)(dst + 1) * w);
+    memset(board->rows, 0, (dst + 1) * sizeof(uint64_t));
+    memset(board->fill, 0, (dst + 1) * sizeof(int));
+
+    return 100 * line_count;
+}
+
+bool game_state_init(GameState *state, int width, int height, uint32_t seed) {
+    memset(state, 0, sizeof(*state));
+    if (!board_size_valid(width, height))
+        return false;
+
+    Board *board = &state->board;
+    board->width = width;
+    board->height = height;
+    board->full_row = (UINT64_C(1) << width) - 1;
+    board->cells = malloc((size_t)width * height);
+    board->rows = malloc(height * sizeof(uint64_t));
+    board->fill = malloc(height * sizeof(int));
+    state->lines = malloc(height * sizeof(int));
+    state->clear_ticks = LINE_CLEAR_TICKS;
+
+    if (board->cells == NULL || board->rows == NULL || board->fill == NULL ||
+        state->lines == NULL) {
+        game_state_free(state);
+        return false;
+    }
+
+    game_state_reset(state, seed);
+    return true;
+}
+
+void game_state_reset(GameState *state, uint32_t seed) {
+    Board *board = &state->board;
+    board_clear(board);
+    state->line_count = 0;
+    state->clear_timer = 0;
+    state->buffered_input = INPUT_NONE;
+    state->rng = seed_rng(seed);
+    state->piece = spawn_piece(board, engine_rand(&state->rng) % PIECE_COUNT);
+    state->next_piece =
+        spawn_piece(board, engine_rand(&state->rng) % PIECE_COUNT);
+    state->fall = 0;
+    state->yspeed = 3;
+    state->score = 0;
+    state->lines_cleared = 0;
+    state->over = !piece_fits(board, state->piece.type, state->piece.x,
+                              state->piece.y, state->piece.rotation);
+}
+
+void game_state_apply_input(GameState *state, int input) {
+    if (state->over)
+        return;
+
+    // hold on to the input until the lines are gone
+    if (state->line_count > 0) {
+        state->buffered_input |= input;
+        return;
+    }
+
+    apply_input(&state->board, &state->piece, input | state->buffered_input);
+    state->buffered_input = INPUT_NONE;
+}
+
+int game_state_step(GameState *state) {
+    if (state->over)
+        return STEP_OVER;
+
+    // the lines are still showing, nothing else moves
+    if (state->line_count > 0) {
+        if (--state->clear_timer > 0)
+            return 0;
+        game_state_clear_lines(state);
+        return STEP_CLEARED;
+    }
+
+    int next_type = state->next_piece.type;
+    int events = step_piece(&state->board, &state->piece, &next_type,
+                            &state->fall, state->yspeed, &state->rng,
+                            state->lines, &state->line_count);
+
+    if (events & STEP_LOCKED)
+        state->next_piece = spawn_piece(&state->board, next_type);
+
+    if (events & STEP_LINES) {
+        state->clear_timer = state->clear_ticks;
+        if (state->clear_timer <= 0) {
+            game_state_clear_lines(state);
+            events |= STEP_CLEARED;
+        }
+    }
+
+    state->over = events & STEP_OVER;
+    return events;
+}
+
+void game_state_clear_lines(GameState *state) {
+    state->score +=
+        clear_lines(&state->board, state->lines, state->line_count);
+    state->lines_cleared += state->line_count;
+    state->line_count = 0;
+    state->clear_timer = 0;
+}
+
+void game_state_add_garbage(GameState *state, int count, int hole) {
+    assert(state->line_count == 0);
+    Board *board = &state->board;
+    int w = board->width;
+    if (state->over || count <= 0)
+        return;
+
+    // whatever sits in the rows pushed past the top tops the game out
+    if (count > board->height)
+        count = board->height;
+    for (int y = 0; y < count; y++) {
+        if (board->rows[y] != 0)
+            state->over = true;
+    }
+
+    int kept = board->height - count;
+    memmove(board->cells, board->cells + count * w, (size_t)kept * w);
+    memmove(board->rows, board->rows + count, kept * sizeof(uint64_t));
+    memmove(board->fill, board->fill + count, kept * sizeof(int));
+
+    uint64_t bits = board->full_row & ~(UINT64_C(1) << hole);
+    for (int y = kept; y < board->height; y++) {
+        memset(board->cells + y * w, CELL_GARBAGE, w);
+        board->cells[y * w + hole] = 0;
+        board->rows[y] = bits;
+        board->fill[y] = w - 1;
+    }
+    mark_dirty(board, 0, board->height - 1);
+
+    Piece *piece = &state->piece;
+    if (!piece_fits(board, piece->type, piece->x, piece->y, piece->rotation))
+        state->over = true;
+}
+
+uint64_t game_state_hash(const GameState *state) {
+    const Board *board = &state->board;
+    size_t size = (size_t)board->width * board->height;
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= board->cells[i];
+        hash *= UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+void game_state_free(GameState *state) {
+    free(state->board.cells);
+    free(state->board.rows);
+    free(state->board.fill);
+    free(state->lines);
+    memset(state, 0, sizeof(*state));
+}
+
+// view of the i-th board of the batch
+static Board batch_board(const GameBatch *batch, int i) {
+    return (Board){
+        .width = batch->width,
+        .height = batch->height,
+        .full_row = (UINT64_C(1) << batch->width) - 1,
+        .cells = batch->cells + (size_t)i * batch->width * batch->height,
+        .rows = batch->rows + (size_t)i * batch->height,
+        .fill = batch->fill + (size_t)i * batch->height};
+}
+
+bool game_batch_init(GameBatch *batch, int count, int width, int height,
+                     uint32_t seed) {
+    return game_batch_init_shared(batch, count, width, height, seed, NULL);
+}
+
+bool game_batch_init_shared(GameBatch *batch, int count, int width,
+                            int height, uint32_t seed, unsigned char *cells) {
+    memset(batch, 0, sizeof(*batch));
+    if (count <= 0 || !board_size_valid(width, height))
+        return false;
+
+    batch->count = count;
+    batch->width = width;
+    batch->height = height;
+    batch->shared_cells = cells != NULL;
+    batch->cells =
+        cells != NULL ? cells : malloc((size_t)count * width * height);
+    batch->rows = malloc((size_t)count * height * sizeof(uint64_t));
+    batch->fill = malloc((size_t)count * height * sizeof(int));
+    batch->lines = malloc(height * sizeof(int));
+    batch->piece_type = malloc(count * sizeof(int));
+    batch->piece_x = malloc(count * sizeof(int));
+    batch->piece_y = malloc(count * sizeof(int));
+    batch->piece_rotation = malloc(count * sizeof(int));
+    batch->next_type = malloc(count * sizeof(int));
+    batch->fall = malloc(count * sizeof(int));
+    batch->yspeed = malloc(count * sizeof(int));
+    batch->score = malloc(count * sizeof(uint32_t));
+    batch->rng = malloc(count * sizeof(uint32_t));
+    batch->over = malloc(count * sizeof(uint8_t));
+
+    if (batch->cells == NULL || batch->rows == NULL || batch->fill == NULL ||
+        batch->lines == NULL || batch->piece_type == NULL ||
+        batch->piece_x == NULL || batch->piece_y == NULL ||
+        batch->piece_rotation == NULL || batch->next_type == NULL ||
+        batch->fall == NULL || batch->yspeed == NULL || batch->score == NULL ||
+        batch->rng == NULL || batch->over == NULL) {
+        game_batch_free(batch);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        game_batch_reset(batch, i, seed + i);
+    }
+    return true;
+}
+
+void game_batch_reset(GameBatch *batch, int i, uint32_t seed) {
+    Board board = batch_board(batch, i);
+    board_clear(&board);
+    batch->rng[i] = seed_rng(seed);
+    Piece piece =
+        spawn_piece(&board, engine_rand(&batch->rng[i]) % PIECE_COUNT);
+    batch->piece_type[i] = piece.type;
+    batch->piece_x[i] = piece.x;
+    batch->piece_y[i] = piece.y;
+    batch->piece_rotation[i] = piece.rotation;
+    batch->next_type[i] = engine_rand(&batch->rng[i]) % PIECE_COUNT;
+    batch->fall[i] = 0;
+    batch->yspeed[i] = 3;
+    batch->score[i] = 0;
+    batch->over[i] = !piece_fits(&board, piece.type, piece.x, piece.y,
+                                 piece.rotation);
+}
+
+int game_batch_step_game(GameBatch *batch, int i, int input) {
+    if (batch->over[i])
+        return STEP_OVER;
+
+    Board board = batch_board(batch, i);
+    Piece piece = {.type = batch->piece_type[i],
+                   .x = batch->piece_x[i],
+                   .y = batch->piece_y[i],
+                   .rotation = batch->piece_rotation[i]};
+    int line_count = 0;
+
+    if (input != INPUT_NONE)
+        apply_input(&board, &piece, input);
+
+    int events =
+        step_piece(&board, &piece, &batch->next_type[i], &batch->fall[i],
+                   batch->yspeed[i], &batch->rng[i], batch->lines,
+                   &line_count);
+
+    // no animation in batch mode, collapse right away
+    if (events & STEP_LINES) {
+        batch->score[i] += clear_lines(&board, batch->lines, line_count);
+        events |= STEP_CLEARED;
+    }
+
+    batch->piece_type[i] = piece.type;
+    batch->piece_x[i] = piece.x;
+    batch->piece_y[i] = piece.y;
+    batch->piece_rotation[i] = piece.rotation;
+    batch->over[i] = (events & STEP_OVER) != 0;
+    return events;
+}
+
+int game_batch_step(GameBatch *batch, const uint8_t *inputs) {
+    int running = 0;
+
+    for (int i = 0; i < batch->count; i++) {
+        if (batch->over[i])
+            continue;
+
+        game_batch_step_game(batch, i,
+                             inputs != NULL ? inputs[i] : INPUT_NONE);
+        running += !batch->over[i];
+    }
+
+    return running;
+}
+
+void game_batch_free(GameBatch *batch) {
+    if (!batch->shared_cells)
+        free(batch->cells);
+    free(batch->rows);
+    free(batch->fill);
+    free(batch->lines);
+    free(batch->piece_type);
+    free(batch->piece_x);
+    free(batch->piece_y);
+    free(batch->piece_rotation);
+    free(batch->next_type);
+    free(batch->fall);
+    free(batch->yspeed);
+    free(batch->score);
+    free(batch->rng);
+    free(batch->over);
+    memset(batch, 0, sizeof(*batch));
+}
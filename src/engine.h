@@ -0,0 +1,172 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// default board size
+#define BOARD_WIDTH 10
+#define BOARD_HEIGHT 20
+
+// row masks are 64 bits wide and a piece box may hang 3 columns past the
+// right edge while being tested
+#define BOARD_MAX_WIDTH 60
+#define BOARD_MAX_HEIGHT 4096
+
+#define PIECE_COUNT 7
+
+// the simulation advances in fixed steps of 1 / TICK_RATE seconds, so a
+// game plays out the same whatever the frame rate of the machine is
+#define TICK_RATE 60
+
+// marks the cells of a completed line until it is collapsed
+#define CELL_LINE 127
+// cells of the rows pushed in by the opponent of a versus match
+#define CELL_GARBAGE 126
+
+// default length of the line clear animation, 100ms
+#define LINE_CLEAR_TICKS 6
+
+// player inputs, can be combined
+#define INPUT_NONE 0
+#define INPUT_LEFT (1 << 0)
+#define INPUT_RIGHT (1 << 1)
+#define INPUT_ROTATE (1 << 2)
+#define INPUT_SOFT_DROP (1 << 3)
+
+// events reported by game_state_step
+#define STEP_LOCKED (1 << 0)
+#define STEP_LINES (1 << 1)
+#define STEP_OVER (1 << 2)
+#define STEP_CLEARED (1 << 3)
+
+extern const char tetriminos[PIECE_COUNT][16];
+
+// piece_masks[type][rotation][py] holds the occupied columns of row py of
+// the rotated 4x4 shape
+extern const uint8_t piece_masks[PIECE_COUNT][4][4];
+
+typedef struct {
+    int type;
+    int x;
+    int y;
+    int rotation;
+} Piece;
+
+// cells hold the color of every cell, rows mirror them as one bit per
+// column and fill counts the occupied cells of each row. rows dirty_top to
+// dirty_bottom changed since the last board_clean, the range is empty when
+// dirty_top > dirty_bottom. changed_top to changed_bottom is the same for
+// the last snapshot taken or restored, see snapshot.h
+typedef struct {
+    int width;
+    int height;
+    uint64_t full_row;
+    unsigned char *cells;
+    uint64_t *rows;
+    int *fill;
+    int dirty_top;
+    int dirty_bottom;
+    int changed_top;
+    int changed_bottom;
+} Board;
+
+// state of a single game, no renderer involved
+typedef struct {
+    Board board;
+    int *lines;
+    int line_count;
+    // completed lines stay on the board for clear_ticks ticks before they
+    // collapse, clear_timer counts down the ticks left. the game is frozen
+    // meanwhile and inputs are kept in buffered_input until it resumes
+    int clear_ticks;
+    int clear_timer;
+    int buffered_input;
+    Piece piece;
+    Piece next_piece;
+    // progress towards the next row in 1 / TICK_RATE rows, yspeed is in
+    // rows per second
+    int fall;
+    int yspeed;
+    uint32_t score;
+    uint32_t lines_cleared;
+    uint32_t rng;
+    bool over;
+} GameState;
+
+// many independent games stored as struct of arrays
+typedef struct {
+    int count;
+    int width;
+    int height;
+    // the cells of game i start at i * width * height. they may live in
+    // memory owned by the caller, see game_batch_init_shared
+    unsigned char *cells;
+    bool shared_cells;
+    uint64_t *rows;
+    int *fill;
+    int *lines;
+    int *piece_type;
+    int *piece_x;
+    int *piece_y;
+    int *piece_rotation;
+    int *next_type;
+    int *fall;
+    int *yspeed;
+    uint32_t *score;
+    uint32_t *rng;
+    uint8_t *over;
+} GameBatch;
+
+bool board_size_valid(int width, int height);
+
+// forgets the dirty rows, called once they were redrawn
+void board_clean(Board *board);
+
+// returns the index of (x, y) corresponding to the rotated shape
+int rotate(int x, int y, int rotation);
+
+// checks if the piece fits into the board
+bool does_piece_fit(const Board *board, int type, int x, int y, int rotation);
+
+// same as does_piece_fit but tests against the row masks of the board
+bool bitboard_piece_fits(const Board *board, int type, int x, int y,
+                         int rotation);
+
+// where a new piece of type enters the board, rotation 0 at the top
+Piece spawn_piece(const Board *board, int type);
+
+uint32_t engine_rand(uint32_t *rng);
+
+bool game_state_init(GameState *state, int width, int height, uint32_t seed);
+// starts a new game on the already allocated board
+void game_state_reset(GameState *state, uint32_t seed);
+void game_state_apply_input(GameState *state, int input);
+// advances the game by one tick
+int game_state_step(GameState *state);
+// collapses the completed lines right away, ending the animation
+void game_state_clear_lines(GameState *state);
+// pushes the stack up by count rows and fills the rows that come in at the
+// bottom except for column hole. must not be called while lines are
+// showing. the game is over when the stack or the piece no longer fits
+void game_state_add_garbage(GameState *state, int count, int hole);
+// FNV-1a hash of the board cells, two games that played out the same way
+// end with the same hash
+uint64_t game_state_hash(const GameState *state);
+void game_state_free(GameState *state);
+
+bool game_batch_init(GameBatch *batch, int count, int width, int height,
+                     uint32_t seed);
+// same as game_batch_init but keeps the cells in the given buffer of
+// count * width * height bytes, which game_batch_free leaves alone
+bool game_batch_init_shared(GameBatch *batch, int count, int width,
+                            int height, uint32_t seed, unsigned char *cells);
+void game_batch_reset(GameBatch *batch, int i, uint32_t seed);
+// advances game i by one tick and returns the STEP_* events
+int game_batch_step_game(GameBatch *batch, int i, int input);
+// advances every running game by one tick, inputs holds one input mask per
+// game and may be NULL. returns the number of games still running
+int game_batch_step(GameBatch *batch, const uint8_t *inputs);
+void game_batch_free(GameBatch *batch);
+
+#endif
@@ -0,0 +1,189 @@
+#include "env.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "engine.h"
+
+// spins on the request counter before giving the cpu away, the yield only
+// happens while the trainer is busy with something else or when both sides
+// share a core
+#define IDLE_SPINS 1024
+
+static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void observe(const GameBatch *batch, int i, EnvObservation *obs) {
+    obs->piece_type = batch->piece_type[i];
+    obs->piece_rotation = batch->piece_rotation[i];
+    obs->next_type = batch->next_type[i];
+    obs->piece_x = batch->piece_x[i];
+    obs->piece_y = batch->piece_y[i];
+    obs->score = batch->score[i];
+}
+
+// steers the piece of game i to the placement one input per tick and soft
+// drops it until it locks. returns the STEP_* events of the last tick
+static int place(GameBatch *batch, int i, EnvAction action) {
+    int target_rotation = action.rotation % 4;
+    bool aligned = false;
+
+    // enough ticks to rotate, cross the board and fall all the way down
+    int limit = 4 + batch->width + 2 * batch->height;
+    for (int tick = 0; tick < limit; tick++) {
+        int rotation = batch->piece_rotation[i];
+        int x = batch->piece_x[i];
+
+        int input = INPUT_SOFT_DROP;
+        if (!aligned) {
+            if (rotation != target_rotation)
+                input = INPUT_ROTATE;
+            else if (x < action.x)
+                input = INPUT_RIGHT;
+            else if (x > action.x)
+                input = INPUT_LEFT;
+            else
+                aligned = true;
+        }
+
+        int events = game_batch_step_game(batch, i, input);
+        if (events & (STEP_LOCKED | STEP_OVER))
+            return events;
+
+        // blocked, drop from here
+        if (input != INPUT_SOFT_DROP && batch->piece_rotation[i] == rotation &&
+            batch->piece_x[i] == x)
+            aligned = true;
+    }
+
+    return 0;
+}
+
+bool env_run(const char *name, int count, int width, int height,
+             uint32_t seed) {
+    if (count <= 0 || !board_size_valid(width, height))
+        return false;
+
+    size_t slot_size = align_up(sizeof(EnvSlot), 8) +
+                       align_up(count * sizeof(EnvAction), 8) +
+                       count * sizeof(EnvObservation);
+    slot_size = align_up(slot_size, 64);
+    size_t boards_offset = align_up(sizeof(EnvHeader), 64);
+    size_t ring_offset =
+        align_up(boards_offset + (size_t)count * width * height, 64);
+    size_t size = ring_offset + ENV_RING_SIZE * slot_size;
+
+    // a segment left behind by a crashed run is replaced
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    EnvHeader *header = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    header->count = count;
+    header->width = width;
+    header->height = height;
+    header->ring_size = ENV_RING_SIZE;
+    header->boards_offset = boards_offset;
+    header->ring_offset = ring_offset;
+    header->slot_size = slot_size;
+    header->actions_offset = align_up(sizeof(EnvSlot), 8);
+    header->observations_offset =
+        header->actions_offset + align_up(count * sizeof(EnvAction), 8);
+    atomic_init(&header->request, 0);
+    atomic_init(&header->done, 0);
+
+    GameBatch batch;
+    uint32_t *episodes = calloc(count, sizeof(uint32_t));
+    if (episodes == NULL ||
+        !game_batch_init_shared(&batch, count, width, height, seed,
+                                ENV_BOARD(header, 0))) {
+        free(episodes);
+        munmap(header, size);
+        shm_unlink(name);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        game_batch_reset(&batch, i, env_episode_seed(seed, i, 0));
+        observe(&batch, i, &ENV_OBSERVATIONS(header, ENV_SLOT(header, 0))[i]);
+    }
+
+    // the header goes last, a client that sees the magic sees everything
+    header->version = ENV_VERSION;
+    atomic_store_explicit(&header->magic, ENV_MAGIC, memory_order_release);
+
+    for (uint64_t step = 1;; step++) {
+        int spins = 0;
+        while (atomic_load_explicit(&header->request, memory_order_acquire) <
+               step) {
+            cpu_relax();
+            if (++spins == IDLE_SPINS) {
+                sched_yield();
+                spins = 0;
+            }
+        }
+
+        EnvSlot *slot = ENV_SLOT(header, step);
+        const EnvAction *actions = ENV_ACTIONS(header, slot);
+        EnvObservation *obs = ENV_OBSERVATIONS(header, slot);
+
+        if (slot->command == ENV_CLOSE)
+            break;
+
+        if (slot->command == ENV_RESET) {
+            seed = slot->seed;
+            memset(episodes, 0, count * sizeof(uint32_t));
+        }
+
+        for (int i = 0; i < count; i++) {
+            uint32_t score = batch.score[i];
+            bool over = false;
+
+            if (slot->command == ENV_RESET) {
+                game_batch_reset(&batch, i, env_episode_seed(seed, i, 0));
+                score = 0;
+            } else {
+                over = place(&batch, i, actions[i]) & STEP_OVER;
+            }
+
+            obs[i].reward = batch.score[i] - score;
+            obs[i].done = over;
+            if (over) {
+                episodes[i]++;
+                game_batch_reset(&batch, i,
+                                 env_episode_seed(seed, i, episodes[i]));
+            }
+            obs[i].episode = episodes[i];
+            observe(&batch, i, &obs[i]);
+        }
+
+        atomic_store_explicit(&header->done, step, memory_order_release);
+    }
+
+    game_batch_free(&batch);
+    free(episodes);
+    munmap(header, size);
+    shm_unlink(name);
+    return true;
+}
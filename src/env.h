@@ -0,0 +1,120 @@
+#ifndef ENV_H
+#define ENV_H
+
+// training environment shared with a trainer process through POSIX shared
+// memory. the trainer maps the segment, writes actions and reads
+// observations in place, and both sides synchronize by spinning on two
+// sequence counters, so a step costs no syscalls and no copies
+//
+// this header is all a client needs, it depends on nothing but libc
+//
+// protocol, steps are numbered from 1:
+//   - the environment publishes the first observation in slot 0 and sets
+//     done to 0
+//   - for step n the trainer fills slot n % ENV_RING_SIZE (command, seed,
+//     actions) and stores n in request
+//   - the environment plays step n, fills the observations of the same
+//     slot and stores n in done
+// the trainer may queue up to ENV_RING_SIZE - 1 steps ahead of done. the
+// boards are not part of the ring, they are the live cells of the games
+// and only valid while no step is in flight (done == request)
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ENV_MAGIC 0x564e4554 // "TENV"
+#define ENV_VERSION 1
+#define ENV_RING_SIZE 4
+
+// commands of a ring slot
+#define ENV_STEP 0
+// restarts every game at episode 0 with the seed of the slot, see
+// env_episode_seed
+#define ENV_RESET 1
+// the environment unlinks the segment and exits
+#define ENV_CLOSE 2
+
+// where to place the current piece, rotation 0-3 and the column of the
+// left edge of its 4x4 box. the piece is moved there under the normal
+// rules and dropped, if something is in the way it drops where it got to
+typedef struct {
+    uint8_t rotation;
+    int8_t x;
+} EnvAction;
+
+typedef struct {
+    // points scored by the step
+    int32_t reward;
+    // the game ended with this step and was restarted, piece and board
+    // already belong to the new game
+    uint8_t done;
+    uint8_t piece_type;
+    uint8_t piece_rotation;
+    uint8_t next_type;
+    int16_t piece_x;
+    int16_t piece_y;
+    uint32_t score;
+    // games played so far by this environment
+    uint32_t episode;
+} EnvObservation;
+
+// slot layout: EnvSlot, then count EnvAction, then count EnvObservation at
+// observations_offset
+typedef struct {
+    uint32_t command;
+    uint32_t seed;
+} EnvSlot;
+
+// the seed of the episode-th game played by game since the environment
+// started or was reset with seed, counted from 0 like
+// EnvObservation.episode. the engine deals the pieces of that game from
+// it, the same way game_state_reset does
+static inline uint32_t env_episode_seed(uint32_t seed, int game,
+                                        uint32_t episode) {
+    uint32_t h = seed + game * 0x9e3779b9u + episode * 0x85ebca6bu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+typedef struct {
+    // set last, once everything else is in place
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t width;
+    uint32_t height;
+    uint32_t ring_size;
+    // offsets from the start of the segment and of a slot
+    uint64_t boards_offset;
+    uint64_t ring_offset;
+    uint64_t slot_size;
+    uint64_t actions_offset;
+    uint64_t observations_offset;
+    // on separate cache lines so the two sides don't fight over one
+    alignas(64) _Atomic uint64_t request;
+    alignas(64) _Atomic uint64_t done;
+} EnvHeader;
+
+#define ENV_SLOT(header, n)                                                    \
+    ((EnvSlot *)((char *)(header) + (header)->ring_offset +                    \
+                 ((n) % (header)->ring_size) * (header)->slot_size))
+#define ENV_ACTIONS(header, slot)                                              \
+    ((EnvAction *)((char *)(slot) + (header)->actions_offset))
+#define ENV_OBSERVATIONS(header, slot)                                         \
+    ((EnvObservation *)((char *)(slot) + (header)->observations_offset))
+// cells of game i, width * height bytes row by row, 0 is empty and 1-7 a
+// piece color
+#define ENV_BOARD(header, i)                                                   \
+    ((uint8_t *)(header) + (header)->boards_offset +                           \
+     (size_t)(i) * (header)->width * (header)->height)
+
+// runs count games in the shared memory object name until a trainer sends
+// ENV_CLOSE. returns false if the segment could not be set up
+bool env_run(const char *name, int count, int width, int height,
+             uint32_t seed);
+
+#endif
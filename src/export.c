@@ -0,0 +1,376 @@
+#include "export.h"
+
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+#include <SDL2/SDL_ttf.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "assets.h"
+#include "game.h"
+#include "pool.h"
+#include "replay.h"
+#include "svg.h"
+
+// a full resolution luma plane and two quarter size chroma planes
+#define FRAME_SIZE (WINDOW_WIDTH * WINDOW_HEIGHT * 3 / 2)
+
+// what a worker renders with, and the ring it hands the frames to its
+// writer through
+typedef struct {
+    Game game;
+    uint8_t *frames[EXPORT_RING_FRAMES];
+    SDL_sem *free_slots;
+    SDL_sem *full_slots;
+    // the file of the segment being written and how many frames it gets,
+    // write_failed is only touched by the writer until it is joined
+    FILE *file;
+    uint32_t frame_count;
+    bool write_failed;
+} ExportWorker;
+
+typedef struct Exporter Exporter;
+
+// frames first_frame up to first_frame + frame_count of a game, part is -1
+// when that is the whole game
+typedef struct {
+    Exporter *exporter;
+    const Replay *replay;
+    const char *path;
+    int part;
+    uint32_t first_frame;
+    uint32_t frame_count;
+    bool ok;
+} ExportSegment;
+
+struct Exporter {
+    ExportOptions options;
+    TaskPool pool;
+    ExportWorker *workers;
+    // every tile size a board fits the frame with, the replays may be of
+    // boards of any size
+    SvgStrips atlas;
+    RasterImage atlas_image;
+    TTF_Font *font;
+};
+
+// BT.601 full range, which is what C420jpeg means. chroma is the average
+// of each 2x2 block
+static void convert_frame(const RasterImage *image, uint8_t *out) {
+    int w = image->w;
+    int h = image->h;
+    uint8_t *luma = out;
+    uint8_t *cb = out + w * h;
+    uint8_t *cr = cb + (w / 2) * (h / 2);
+
+    for (int y = 0; y < h; y++) {
+        const uint32_t *row = image->pixels + y * w;
+        for (int x = 0; x < w; x++) {
+            uint32_t p = row[x];
+            int r = p >> 16 & 0xff, g = p >> 8 & 0xff, b = p & 0xff;
+            luma[y * w + x] = (77 * r + 150 * g + 29 * b) >> 8;
+        }
+    }
+
+    for (int y = 0; y < h / 2; y++) {
+        const uint32_t *top = image->pixels + 2 * y * w;
+        const uint32_t *bottom = top + w;
+        for (int x = 0; x < w / 2; x++) {
+            uint32_t block[4] = {top[2 * x], top[2 * x + 1], bottom[2 * x],
+                                 bottom[2 * x + 1]};
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++) {
+                r += block[i] >> 16 & 0xff;
+                g += block[i] >> 8 & 0xff;
+                b += block[i] & 0xff;
+            }
+            // the sums are 4 times the average, >> 10 instead of >> 8
+            cb[y * (w / 2) + x] = ((-43 * r - 85 * g + 128 * b) >> 10) + 128;
+            cr[y * (w / 2) + x] = ((128 * r - 107 * g - 21 * b) >> 10) + 128;
+        }
+    }
+}
+
+static int write_frames(void *data) {
+    ExportWorker *worker = data;
+    for (uint32_t i = 0; i < worker->frame_count; i++) {
+        SDL_SemWait(worker->full_slots);
+        const uint8_t *frame = worker->frames[i % EXPORT_RING_FRAMES];
+        if (!worker->write_failed &&
+            (fputs("FRAME\n", worker->file) < 0 ||
+             fwrite(frame, FRAME_SIZE, 1, worker->file) != 1))
+            worker->write_failed = true;
+        SDL_SemPost(worker->free_slots);
+    }
+    return 0;
+}
+
+// the same calls as replay_play, plus what the play screen keeps to
+// interpolate the piece
+static void advance(Game *game, const Replay *replay, uint32_t tick,
+                    int *next) {
+    GameState *state = &game->state;
+    int input = INPUT_NONE;
+    if (*next < replay->event_count && replay->events[*next].tick == tick)
+        input = replay->events[(*next)++].input;
+
+    game->prev_piece = state->piece;
+    game_state_apply_input(state, input);
+    if (game_state_step(state) & STEP_LOCKED)
+        game->prev_piece = state->piece;
+}
+
+// the first frame shows the start of the game and the last one its end
+static uint32_t video_frames(const Replay *replay, int fps) {
+    return ((uint64_t)replay->ticks * fps + TICK_RATE - 1) / TICK_RATE + 1;
+}
+
+static void segment_name(const ExportSegment *segment, char *name,
+                         size_t size) {
+    const char *base = strrchr(segment->path, '/');
+    base = base != NULL ? base + 1 : segment->path;
+    const char *dot = strrchr(base, '.');
+    int length = dot != NULL && dot != base ? dot - base : (int)strlen(base);
+
+    const char *directory = segment->exporter->options.directory;
+    if (segment->part < 0) {
+        snprintf(name, size, "%s/%.*s.y4m", directory, length, base);
+    } else {
+        snprintf(name, size, "%s/%.*s-%03d.y4m", directory, length, base,
+                 segment->part);
+    }
+}
+
+static void export_segment(void *arg, int index) {
+    ExportSegment *segment = arg;
+    Exporter *exporter = segment->exporter;
+    ExportWorker *worker = &exporter->workers[index];
+    Game *game = &worker->game;
+    const Replay *replay = segment->replay;
+    int fps = exporter->options.fps;
+
+    char name[1024];
+    segment_name(segment, name, sizeof(name));
+    if (!game_resize(game, replay->width, replay->height, replay->seed)) {
+        fprintf(stderr, "ERROR: failed to set up %s: %s\n", name,
+                strerror(errno));
+        return;
+    }
+    game->state.clear_ticks = replay->clear_ticks;
+
+    worker->file = fopen(name, "wb");
+    if (worker->file == NULL) {
+        fprintf(stderr, "ERROR: failed to open %s: %s\n", name,
+                strerror(errno));
+        return;
+    }
+    fprintf(worker->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+            WINDOW_WIDTH, WINDOW_HEIGHT, fps);
+
+    worker->frame_count = segment->frame_count;
+    worker->write_failed = false;
+    SDL_Thread *writer =
+        SDL_CreateThread(write_frames, "export writer", worker);
+    if (writer == NULL) {
+        fprintf(stderr, "ERROR: failed to create writer thread: %s\n",
+                SDL_GetError());
+        fclose(worker->file);
+        return;
+    }
+
+    // the ticks before the first frame are only simulated
+    uint32_t tick = 0;
+    int next = 0;
+    uint32_t last = segment->first_frame + segment->frame_count;
+    for (uint32_t frame = segment->first_frame; frame < last; frame++) {
+        uint64_t time = (uint64_t)frame * TICK_RATE;
+        uint32_t target = SDL_min(time / fps, replay->ticks);
+        for (; tick < target; tick++)
+            advance(game, replay, tick, &next);
+
+        // the frames between two ticks show the piece on its way
+        float alpha = tick < replay->ticks ? (float)(time % fps) / fps : 0;
+        game_draw_play(game, alpha);
+
+        SDL_SemWait(worker->free_slots);
+        convert_frame(&game->raster.frame,
+                      worker->frames[(frame - segment->first_frame) %
+                                     EXPORT_RING_FRAMES]);
+        SDL_SemPost(worker->full_slots);
+    }
+
+    SDL_WaitThread(writer, NULL);
+    bool closed = fclose(worker->file) == 0;
+    if (worker->write_failed || !closed) {
+        fprintf(stderr, "ERROR: failed to write %s: %s\n", name,
+                strerror(errno));
+        return;
+    }
+
+    // the segment with the end of the game checks it against the recording
+    if (tick == replay->ticks &&
+        (game->state.score != replay->score ||
+         game->state.lines_cleared != replay->lines_cleared ||
+         game_state_hash(&game->state) != replay->hash)) {
+        fprintf(stderr, "ERROR: %s doesn't end the way it was recorded\n",
+                segment->path);
+        return;
+    }
+    segment->ok = true;
+}
+
+// exporter has to be zeroed, exporter_free cleans up after a failure
+static bool exporter_init(Exporter *exporter, const ExportOptions *options) {
+    exporter->options = *options;
+
+    int sizes[PIECE_WIDTH - 2 * PIECE_PADDING];
+    for (int i = 0; i < (int)SDL_arraysize(sizes); i++)
+        sizes[i] = i + 1;
+    bool ok = svg_rasterize(&exporter->atlas, "img/pallete.svg",
+                            ATLAS_COLUMNS, sizes, SDL_arraysize(sizes)) &&
+              raster_image_from_surface(&exporter->atlas_image,
+                                        exporter->atlas.surface);
+    SDL_RWops *rw = asset_open("font/SuperFunky.ttf");
+    exporter->font = rw != NULL ? TTF_OpenFontRW(rw, 1, 80) : NULL;
+    if (!ok || exporter->font == NULL) {
+        fprintf(stderr, "ERROR: failed to load assets: %s\n", SDL_GetError());
+        return false;
+    }
+
+    if (!pool_init(&exporter->pool, options->threads)) {
+        fprintf(stderr, "ERROR: failed to start threads: %s\n",
+                SDL_GetError());
+        return false;
+    }
+
+    // the workers are set up here since the glyphs they draw come from the
+    // font, which only this thread uses
+    int count = exporter->pool.thread_count;
+    exporter->workers = calloc(count, sizeof(ExportWorker));
+    if (exporter->workers == NULL)
+        return false;
+    for (int i = 0; i < count; i++) {
+        ExportWorker *worker = &exporter->workers[i];
+        if (!game_init_offscreen(&worker->game, &exporter->atlas,
+                                 &exporter->atlas_image, exporter->font,
+                                 BOARD_WIDTH, BOARD_HEIGHT, 0)) {
+            fprintf(stderr, "ERROR: failed to set up worker %d: %s\n", i,
+                    SDL_GetError());
+            return false;
+        }
+        for (int j = 0; j < EXPORT_RING_FRAMES; j++) {
+            worker->frames[j] = malloc(FRAME_SIZE);
+            if (worker->frames[j] == NULL)
+                return false;
+        }
+        worker->free_slots = SDL_CreateSemaphore(EXPORT_RING_FRAMES);
+        worker->full_slots = SDL_CreateSemaphore(0);
+        if (worker->free_slots == NULL || worker->full_slots == NULL)
+            return false;
+    }
+    return true;
+}
+
+static void exporter_free(Exporter *exporter) {
+    for (int i = 0; exporter->workers != NULL &&
+                    i < exporter->pool.thread_count;
+         i++) {
+        ExportWorker *worker = &exporter->workers[i];
+        game_free(&worker->game);
+        for (int j = 0; j < EXPORT_RING_FRAMES; j++)
+            free(worker->frames[j]);
+        if (worker->free_slots != NULL)
+            SDL_DestroySemaphore(worker->free_slots);
+        if (worker->full_slots != NULL)
+            SDL_DestroySemaphore(worker->full_slots);
+    }
+    free(exporter->workers);
+    pool_free(&exporter->pool);
+    if (exporter->font != NULL)
+        TTF_CloseFont(exporter->font);
+    svg_free(&exporter->atlas);
+    raster_image_free(&exporter->atlas_image);
+}
+
+bool export_videos(const char *const *paths, int count,
+                   const ExportOptions *options) {
+    if (mkdir(options->directory, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: failed to create %s: %s\n",
+                options->directory, strerror(errno));
+        return false;
+    }
+
+    Replay *replays = calloc(count, sizeof(Replay));
+    if (replays == NULL)
+        return false;
+    bool ok = true;
+    uint32_t segment_frames = options->segment_seconds * options->fps;
+    uint32_t segment_count = 0;
+    for (int i = 0; ok && i < count; i++) {
+        if (!replay_load(&replays[i], paths[i])) {
+            fprintf(stderr, "ERROR: failed to load replay %s\n", paths[i]);
+            ok = false;
+        }
+        uint32_t frames = video_frames(&replays[i], options->fps);
+        segment_count += segment_frames > 0
+                             ? (frames + segment_frames - 1) / segment_frames
+                             : 1;
+    }
+
+    Exporter exporter = {0};
+    ExportSegment *segments =
+        ok ? calloc(segment_count, sizeof(ExportSegment)) : NULL;
+    if (segments == NULL || !exporter_init(&exporter, options)) {
+        exporter_free(&exporter);
+        free(segments);
+        for (int i = 0; i < count; i++)
+            replay_free(&replays[i]);
+        free(replays);
+        return false;
+    }
+
+    uint32_t n = 0;
+    uint64_t total_frames = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t frames = video_frames(&replays[i], options->fps);
+        uint32_t length = segment_frames > 0 ? segment_frames : frames;
+        for (uint32_t first = 0; first < frames; first += length) {
+            segments[n++] = (ExportSegment){
+                .exporter = &exporter,
+                .replay = &replays[i],
+                .path = paths[i],
+                .part = frames > length ? (int)(first / length) : -1,
+                .first_frame = first,
+                .frame_count = SDL_min(length, frames - first)};
+        }
+        total_frames += frames;
+    }
+    for (uint32_t i = 0; i < n; i++)
+        pool_push(&exporter.pool, 0, export_segment, &segments[i]);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    pool_run(&exporter.pool);
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) /
+                     SDL_GetPerformanceFrequency();
+
+    for (uint32_t i = 0; i < n; i++)
+        ok = ok && segments[i].ok;
+    double video = (double)total_frames / options->fps;
+    printf("exported %d games in %u segments on %d threads: %llu frames, "
+           "%.1fs of video in %.2fs (%.0f fps, %.1fx real time)\n",
+           count, n, exporter.pool.thread_count,
+           (unsigned long long)total_frames, video, seconds,
+           seconds > 0 ? total_frames / seconds : 0.0,
+           seconds > 0 ? video / seconds : 0.0);
+
+    exporter_free(&exporter);
+    free(segments);
+    for (int i = 0; i < count; i++)
+        replay_free(&replays[i]);
+    free(replays);
+    return ok;
+}
@@ -0,0 +1,37 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+// renders recorded games to uncompressed video without a window. every game
+// is simulated again from its replay and drawn offscreen by the raster at a
+// fixed frame rate, so the video shows the game as it was played no matter
+// how long a frame takes to render
+//
+// games, and segments of long games, are rendered in parallel on a task
+// pool. a worker converts its frames to YUV 4:2:0 into a ring of
+// EXPORT_RING_FRAMES buffers, and a writer thread drains the ring into a
+// YUV4MPEG2 file, which players and encoders read as it is
+
+#include <stdbool.h>
+
+#define EXPORT_DEFAULT_FPS 60
+#define EXPORT_RING_FRAMES 8
+
+typedef struct {
+    // where the .y4m files go, created when missing
+    const char *directory;
+    int fps;
+    // games longer than this many seconds are cut into segments of that
+    // length, each rendered on its own and written to a file of its own. 0
+    // keeps every game in one piece
+    int segment_seconds;
+    // threads <= 0 uses one thread per core
+    int threads;
+} ExportOptions;
+
+// writes a video of every replay in paths and reports the speed. returns
+// false when one couldn't be loaded or written, or didn't end the way it
+// was recorded
+bool export_videos(const char *const *paths, int count,
+                   const ExportOptions *options);
+
+#endif
@@ -0,0 +1,1178 @@
+#include "game.h"
+#include "assets.h"
+#include "profile.h"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_events.h>
+#include <SDL2/SDL_keycode.h>
+#include <SDL2/SDL_mouse.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_surface.h>
+#include <SDL2/SDL_timer.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a length of the WINDOW_WIDTH, WINDOW_HEIGHT layout in the window as it
+// is now
+static int scaled(const Game *game, float length) {
+    return (int)floorf(length * game->scale + 0.5f);
+}
+
+// padding around the tiles of cells that size
+static int cell_padding(const Game *game, int cell) {
+    if (cell < MIN_PADDED_CELL)
+        return 0;
+    return SDL_max(scaled(game, PIECE_PADDING), 1);
+}
+
+static int tile_size(const Game *game, int cell) {
+    return cell - 2 * cell_padding(game, cell);
+}
+
+// sizes everything to the window. the layout of WINDOW_WIDTH,
+// WINDOW_HEIGHT is scaled by as much as fits both ways, and the cells of
+// boards that don't fit shrink further
+static void layout(Game *game) {
+    const Board *board = &game->state.board;
+    int w = game->window_w;
+    int h = game->window_h;
+    game->scale = SDL_min((float)w / WINDOW_WIDTH, (float)h / WINDOW_HEIGHT);
+
+    int cell = SDL_min(scaled(game, PIECE_WIDTH),
+                       SDL_min(w / board->width, h / board->height));
+    game->cell_size = SDL_max(cell, 1);
+    game->board_xoff = SDL_max(0, (w - board->width * game->cell_size) / 2);
+    game->board_yoff = SDL_max(0, (h - board->height * game->cell_size) / 2);
+    game->preview_cell = scaled(game, PIECE_WIDTH);
+
+    // the boards of a match are as large as the one of the game, side by
+    // side under the names
+    cell = SDL_min(scaled(game, PIECE_WIDTH),
+                   SDL_min((w / 2 - scaled(game, 20)) / board->width,
+                           (h - scaled(game, 60)) / board->height));
+    game->versus_cell = SDL_max(cell, 1);
+
+    if (game->spectator != NULL) {
+        const Spectator *spectator = game->spectator;
+        spectate_layout(spectator->count, spectator->width, spectator->height,
+                        w, h, &game->spectate_layout);
+    }
+}
+
+// rasterizes the SVG name at sizes unless strips has them already, and
+// makes a texture and a raster image of it. exits when that fails
+static void update_image(Game *game, const char *name, SvgStrips *strips,
+                         int columns, const int *sizes, int count,
+                         SDL_Texture **texture, RasterImage *image) {
+    if (*texture != NULL && svg_has_sizes(strips, sizes, count))
+        return;
+
+    if (*texture != NULL)
+        SDL_DestroyTexture(*texture);
+    raster_image_free(image);
+    *texture = NULL;
+    if (svg_rasterize(strips, name, columns, sizes, count))
+        *texture = SDL_CreateTextureFromSurface(game->renderer,
+                                                strips->surface);
+    if (*texture == NULL ||
+        !raster_image_from_surface(image, strips->surface)) {
+        fprintf(stderr, "ERROR: failed to rasterize %s: %s\n", name,
+                SDL_GetError());
+        exit(1);
+    }
+}
+
+// the tiles and the play button at exactly the sizes the layout draws
+// them at, so drawing them is a 1:1 copy. sizes seen before come from the
+// cache of svg.c, a resize back and forth never rasterizes anything
+static void update_images(Game *game) {
+    if (game->renderer == NULL)
+        return;
+
+    int tiles[] = {
+        tile_size(game, game->cell_size),
+        tile_size(game, game->preview_cell),
+        tile_size(game, game->versus_cell),
+        game->spectator != NULL ? tile_size(game, game->spectate_layout.cell)
+                                : 0};
+    int button = scaled(game, PLAY_BTN_SIZE);
+    int buttons[] = {button, 2 * button};
+    update_image(game, "img/pallete.svg", &game->atlas, ATLAS_COLUMNS, tiles,
+                 SDL_arraysize(tiles), &game->pieces_texture,
+                 &game->atlas_image);
+    update_image(game, "img/play_btn.svg", &game->play_btn, 1, buttons,
+                 SDL_arraysize(buttons), &game->play_btn_texture,
+                 &game->play_btn_image);
+
+    // flat quads sample the white tile of the largest strip
+    SDL_Rect solid =
+        ATLAS_TILE_RECT(svg_cell(&game->atlas, 0), ATLAS_SOLID_TILE);
+    sprite_batch_set_atlas(&game->sprites, game->pieces_texture, &solid);
+}
+
+// the play layer and the raster, when it is in use, as large as the
+// window. false with the SDL error set when they can't be created
+static bool size_targets(Game *game) {
+    int w = game->window_w;
+    int h = game->window_h;
+    if (game->play_layer != NULL)
+        SDL_DestroyTexture(game->play_layer);
+    game->play_layer =
+        SDL_CreateTexture(game->renderer, SDL_PIXELFORMAT_ARGB8888,
+                          SDL_TEXTUREACCESS_TARGET, w, h);
+    game->play_layer_valid = false;
+    if (game->play_layer == NULL)
+        return false;
+    if (game->raster.frame.pixels == NULL)
+        return true;
+
+    raster_free(&game->raster);
+    raster_image_free(&game->play_layer_image);
+    return raster_init(&game->raster, game->renderer, w, h) &&
+           raster_image_init(&game->play_layer_image, w, h);
+}
+
+// picks up the size of the window, the first time or after it changed.
+// with high DPI the renderer has more pixels than the window coordinates
+// of the mouse count
+static void window_resized(Game *game) {
+    int w, h, window_w;
+    SDL_GetRendererOutputSize(game->renderer, &w, &h);
+    SDL_GetWindowSize(game->window, &window_w, NULL);
+    game->pixel_density = window_w > 0 ? (float)w / window_w : 1;
+    if (w == game->window_w && h == game->window_h)
+        return;
+
+    game->window_w = w;
+    game->window_h = h;
+    if (!size_targets(game)) {
+        fprintf(stderr, "ERROR: failed to resize to %dx%d: %s\n", w, h,
+                SDL_GetError());
+        exit(1);
+    }
+    layout(game);
+    update_images(game);
+    game->idle.valid = false;
+}
+
+static void window_event(Game *game, const SDL_Event *e) {
+    if (e->type == SDL_WINDOWEVENT &&
+        e->window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+        window_resized(game);
+}
+
+void game_init(Game *game, SDL_Window *window, SDL_Renderer *renderer,
+               int board_width, int board_height, int clear_ticks,
+               uint32_t seed) {
+    *game = (Game){.renderer = renderer, .window = window};
+    game->idle.last_input = SDL_GetTicks();
+    game->mouse_x = -1;
+    game->mouse_y = -1;
+    input_init(&game->controls, DEFAULT_DAS_MS, DEFAULT_ARR_MS);
+    if (!game_state_init(&game->state, board_width, board_height, seed)) {
+        fprintf(stderr, "ERROR: failed to initialize board: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    // before new_game, the recording takes it from the state
+    game->state.clear_ticks = clear_ticks;
+    new_game(game, seed);
+
+    // load font
+    SDL_RWops *font_rw = asset_open("font/SuperFunky.ttf");
+    game->font = font_rw != NULL ? TTF_OpenFontRW(font_rw, 1, 80) : NULL;
+    if (game->font == NULL) {
+        fprintf(stderr, "ERROR: failed to load font: %s\n", SDL_GetError());
+        exit(1);
+    }
+    text_cache_init(&game->text, renderer, game->font);
+    sprite_batch_init(&game->sprites, renderer, NULL, NULL);
+
+    // lays out the game and rasterizes its images for the window
+    window_resized(game);
+}
+
+bool game_init_offscreen(Game *game, const SvgStrips *atlas,
+                         const RasterImage *atlas_image, TTF_Font *font,
+                         int board_width, int board_height, uint32_t seed) {
+    memset(game, 0, sizeof(*game));
+    game->window_w = WINDOW_WIDTH;
+    game->window_h = WINDOW_HEIGHT;
+    game->pixel_density = 1;
+    game->software = true;
+    if (!raster_init(&game->raster, NULL, WINDOW_WIDTH, WINDOW_HEIGHT) ||
+        !raster_image_init(&game->play_layer_image, WINDOW_WIDTH,
+                           WINDOW_HEIGHT) ||
+        !game_state_init(&game->state, board_width, board_height, seed)) {
+        raster_free(&game->raster);
+        raster_image_free(&game->play_layer_image);
+        return false;
+    }
+    game->prev_piece = game->state.piece;
+    layout(game);
+
+    // the font and the atlas stay with the caller, game_free doesn't free
+    // them
+    game->atlas = *atlas;
+    game->atlas.surface = NULL;
+    text_cache_init(&game->text, NULL, font);
+    text_cache_use_raster(&game->text, &game->raster);
+    sprite_batch_init(&game->sprites, NULL, NULL, NULL);
+    sprite_batch_use_raster(&game->sprites, &game->raster, atlas_image);
+
+    // every glyph the hud can show, so drawing never needs the font
+    for (const char *c = HUD_GLYPHS; *c != '\0'; c++) {
+        if (text_cache_get(&game->text, (char[]){*c, '\0'}, HUD_TEXT_SIZE,
+                           WHITE) == NULL) {
+            game_free(game);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool game_resize(Game *game, int board_width, int board_height,
+                 uint32_t seed) {
+    GameState state;
+    if (!game_state_init(&state, board_width, board_height, seed))
+        return false;
+
+    game_state_free(&game->state);
+    game->state = state;
+    game->prev_piece = state.piece;
+    game->accumulator = 0;
+    game->play_layer_valid = false;
+    layout(game);
+    update_images(game);
+    return true;
+}
+
+bool game_use_raster(Game *game, bool enabled) {
+    if (enabled && game->raster.frame.pixels == NULL) {
+        if (!raster_init(&game->raster, game->renderer, game->window_w,
+                         game->window_h) ||
+            !raster_image_init(&game->play_layer_image, game->window_w,
+                               game->window_h)) {
+            raster_free(&game->raster);
+            return false;
+        }
+    }
+
+    Raster *raster = enabled ? &game->raster : NULL;
+    sprite_batch_use_raster(&game->sprites, raster, &game->atlas_image);
+    text_cache_use_raster(&game->text, raster);
+    game->software = enabled;
+    game->play_layer_valid = false;
+    return true;
+}
+
+// the two render paths, the renderer or the raster
+
+static void clear_screen(Game *game) {
+    if (game->software) {
+        raster_fill(&game->raster,
+                    &(SDL_FRect){0, 0, game->window_w, game->window_h},
+                    BACKGROUND);
+        return;
+    }
+    SDL_SetRenderDrawColor(game->renderer, BACKGROUND.r, BACKGROUND.g,
+                           BACKGROUND.b, BACKGROUND.a);
+    SDL_RenderClear(game->renderer);
+}
+
+static void present(Game *game) {
+    sprite_batch_flush(&game->sprites);
+    game->presented++;
+    if (game->software)
+        raster_present(&game->raster);
+    SDL_RenderPresent(game->renderer);
+}
+
+void game_free(Game *game) {
+    raster_free(&game->raster);
+    raster_image_free(&game->play_layer_image);
+    raster_image_free(&game->atlas_image);
+    raster_image_free(&game->play_btn_image);
+    svg_free(&game->atlas);
+    svg_free(&game->play_btn);
+    game_state_free(&game->state);
+    replay_free(&game->replay);
+    snapshot_arena_free(&game->undo.arena);
+    text_cache_free(&game->text);
+    sprite_batch_free(&game->sprites);
+    // none of these exist offscreen
+    if (game->renderer == NULL)
+        return;
+    SDL_DestroyTexture(game->play_layer);
+    TTF_CloseFont(game->font);
+    SDL_DestroyTexture(game->pieces_texture);
+    SDL_DestroyTexture(game->play_btn_texture);
+}
+
+float get_delta() {
+    static Uint64 last_time = 0;
+    Uint64 curr_time = SDL_GetPerformanceCounter();
+    float dt = (float)(curr_time - last_time) / SDL_GetPerformanceFrequency();
+    last_time = curr_time;
+    return dt;
+}
+
+// how long until the title bobbing from phase counter moves by a pixel,
+// IDLE_WAIT_MS at most
+static Uint32 bob_wait_ms(double counter) {
+    int y = BOB_HEIGHT * sin(counter);
+    for (Uint32 ms = 1; ms < IDLE_WAIT_MS; ms++) {
+        if ((int)(BOB_HEIGHT * sin(counter + BOB_SPEED * ms / 1000.0)) != y)
+            return ms;
+    }
+    return IDLE_WAIT_MS;
+}
+
+// the last frame presented is still the one screen drew
+static bool idle_current(const Game *game, int screen) {
+    const IdleScreen *idle = &game->idle;
+    return idle->valid && idle->screen == screen &&
+           idle->frame == game->presented;
+}
+
+// sleeps until an event arrives or the title is due to move, unless the
+// screen has to be drawn anyway
+static void idle_wait(Game *game, int screen) {
+    if (!idle_current(game, screen))
+        return;
+    PROFILE_BEGIN(ZONE_IDLE);
+    SDL_WaitEventTimeout(NULL, game->idle.wait_ms);
+    PROFILE_END(ZONE_IDLE);
+}
+
+// mouse motion only matters through the hover state, anything else may
+// change what the screen shows
+static void idle_event(Game *game, const SDL_Event *e) {
+    if (e->type == SDL_MOUSEMOTION || e->type == SDL_MOUSEBUTTONDOWN ||
+        e->type == SDL_MOUSEBUTTONUP || e->type == SDL_KEYDOWN)
+        game->idle.last_input = SDL_GetTicks();
+    if (e->type != SDL_MOUSEMOTION)
+        game->idle.valid = false;
+}
+
+static void track_mouse(Game *game, const SDL_Event *e) {
+    // in window coordinates, which the pixels drawn may outnumber
+    if (e->type == SDL_MOUSEMOTION) {
+        game->mouse_x = e->motion.x * game->pixel_density;
+        game->mouse_y = e->motion.y * game->pixel_density;
+    } else if (e->type == SDL_MOUSEBUTTONDOWN ||
+               e->type == SDL_MOUSEBUTTONUP) {
+        game->mouse_x = e->button.x * game->pixel_density;
+        game->mouse_y = e->button.y * game->pixel_density;
+    }
+}
+
+// advances the title bob by the time since the last frame and returns its
+// offset. once nobody touched anything for IDLE_AFTER_MS it holds still
+// and the screen only wakes every IDLE_WAIT_MS
+static int idle_bob(Game *game, double *counter) {
+    float dt = get_delta();
+    if (SDL_GetTicks() - game->idle.last_input < IDLE_AFTER_MS) {
+        *counter += BOB_SPEED * dt;
+        if (*counter > INT_MAX)
+            *counter = 0;
+        game->idle.wait_ms = bob_wait_ms(*counter);
+    } else {
+        game->idle.wait_ms = IDLE_WAIT_MS;
+    }
+    return BOB_HEIGHT * sin(*counter);
+}
+
+// false when screen would look the same as the last frame drawn
+static bool idle_changed(Game *game, int screen, int y, bool hover) {
+    IdleScreen *idle = &game->idle;
+    if (idle_current(game, screen) && idle->y == y && idle->hover == hover)
+        return false;
+
+    // the frame about to be presented
+    idle->frame = game->presented + 1;
+    idle->valid = true;
+    idle->screen = screen;
+    idle->y = y;
+    idle->hover = hover;
+    return true;
+}
+
+int home_screen(Game *game) {
+    static double counter = 0;
+
+    bool clicked = false;
+
+    idle_wait(game, SCREEN_HOME);
+    PROFILE_BEGIN(ZONE_EVENTS);
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_QUIT) {
+            return SCREEN_EXIT;
+        }
+
+        // detect mouse click
+        if (e.type == SDL_MOUSEBUTTONUP) {
+            clicked = true;
+        }
+        idle_event(game, &e);
+        window_event(game, &e);
+        track_mouse(game, &e);
+        PROFILE_EVENT(&e);
+    }
+    PROFILE_END(ZONE_EVENTS);
+
+    // after the events, a resize moves the button
+    int w = game->window_w;
+    int h = game->window_h;
+    int size = scaled(game, PLAY_BTN_SIZE);
+    int px = w / 2 - size / 2;
+    int py = h / 2 + scaled(game, 100) - size / 2;
+    int mx = game->mouse_x;
+    int my = game->mouse_y;
+
+    bool hover = mx >= px && mx <= px + size && my >= py && my <= py + size;
+    if (hover) {
+        if (clicked)
+            return SCREEN_PLAY;
+        size *= 2;
+        px = w / 2 - size / 2;
+        py = h / 2 + scaled(game, 100) - size / 2;
+    }
+
+    int y = idle_bob(game, &counter);
+    if (!idle_changed(game, SCREEN_HOME, y, hover))
+        return SCREEN_HOME;
+
+    clear_screen(game);
+
+    PROFILE_BEGIN(ZONE_TEXT);
+    text_draw(&game->text, "The Tetris", scaled(game, 80), WHITE,
+              &(SDL_Rect){w / 2 - scaled(game, 150),
+                          h / 2 - scaled(game, 75 + 100 - y),
+                          scaled(game, 300), scaled(game, 150)});
+    PROFILE_END(ZONE_TEXT);
+
+    SDL_Rect src = svg_cell(&game->play_btn, size);
+    if (game->software) {
+        raster_blit(&game->raster, &game->play_btn_image, &src,
+                    &(SDL_FRect){px, py, size, size});
+    } else {
+        SDL_RenderCopy(game->renderer, game->play_btn_texture, &src,
+                       &(SDL_Rect){px, py, size, size});
+    }
+
+    PROFILE_OVERLAY(&game->sprites, &game->text);
+    PROFILE_BEGIN(ZONE_PRESENT);
+    present(game);
+    PROFILE_END(ZONE_PRESENT);
+    return SCREEN_HOME;
+}
+
+// position of the next piece box, false when it doesn't fit next to the
+// board
+static bool next_piece_box(const Game *game, int *x, int *y, int *w) {
+    int xoff = game->board_xoff + game->cell_size * game->state.board.width;
+    int section_width = game->window_w - xoff;
+    int box = 4 * game->preview_cell + 2 * scaled(game, NEXT_PIECE_PADDING);
+
+    // make sure we have enough space to draw the next piece
+    if (section_width <= box)
+        return false;
+
+    *w = box;
+    *x = xoff + (section_width - *w) / 2;
+    *y = scaled(game, 50);
+    return true;
+}
+
+// queues the locked cells of rows top to bottom of a board drawn at xoff,
+// yoff
+static void draw_board_rows(Game *game, const Board *board, int xoff,
+                            int yoff, int cell, int top, int bottom) {
+    SpriteBatch *batch = &game->sprites;
+    int padding = cell_padding(game, cell);
+    int tile = cell - 2 * padding;
+    SDL_Rect first = svg_cell(&game->atlas, tile);
+
+    // the background shows through the padding around the tiles
+    sprite_batch_fill(batch,
+                      &(SDL_FRect){xoff, yoff + top * cell,
+                                   board->width * cell,
+                                   (bottom - top + 1) * cell},
+                      BACKGROUND);
+
+    for (int y = top; y <= bottom; y++) {
+        for (int x = 0; x < board->width; x++) {
+            int val = board->cells[y * board->width + x];
+            SDL_FRect dst = {xoff + x * cell, yoff + y * cell, cell, cell};
+            if (val == 0) {
+                sprite_batch_fill(batch, &dst, EMPTY_CELL);
+            } else if (val == CELL_LINE) {
+                sprite_batch_fill(batch, &dst, WHITE);
+            } else if (val == CELL_GARBAGE) {
+                dst = (SDL_FRect){dst.x + padding, dst.y + padding, tile,
+                                  tile};
+                sprite_batch_fill(batch, &dst, GARBAGE_CELL);
+            } else {
+                dst = (SDL_FRect){dst.x + padding, dst.y + padding, tile,
+                                  tile};
+                sprite_batch_add(batch, &ATLAS_TILE_RECT(first, val - 1), &dst,
+                                 WHITE);
+            }
+        }
+    }
+}
+
+// brings the play layer up to date. the whole layer is only drawn when it
+// was lost, after that just the rows marked dirty by the engine
+static void update_play_layer(Game *game) {
+    Board *board = &game->state.board;
+    if (game->play_layer_valid && board->dirty_top > board->dirty_bottom)
+        return;
+
+    SpriteBatch *batch = &game->sprites;
+    sprite_batch_flush(batch);
+    if (game->software)
+        raster_set_target(&game->raster, &game->play_layer_image);
+    else
+        SDL_SetRenderTarget(game->renderer, game->play_layer);
+
+    if (!game->play_layer_valid) {
+        clear_screen(game);
+
+        int x, y, w;
+        if (next_piece_box(game, &x, &y, &w)) {
+            int pad = scaled(game, NEXT_PIECE_PADDING);
+            int line = SDL_max(scaled(game, 2), 1);
+            int h = w + pad;
+            sprite_batch_fill(batch, &(SDL_FRect){x, y, h, line}, WHITE);
+            sprite_batch_fill(batch, &(SDL_FRect){x, y, line, h}, WHITE);
+            sprite_batch_fill(batch, &(SDL_FRect){x + pad + w, y, line, h},
+                              WHITE);
+            sprite_batch_fill(batch, &(SDL_FRect){x, y + pad + w, h, line},
+                              WHITE);
+        }
+
+        board->dirty_top = 0;
+        board->dirty_bottom = board->height - 1;
+        game->play_layer_valid = true;
+    }
+
+    draw_board_rows(game, board, game->board_xoff, game->board_yoff,
+                    game->cell_size, board->dirty_top, board->dirty_bottom);
+    sprite_batch_flush(batch);
+    board_clean(board);
+
+    if (game->software)
+        raster_set_target(&game->raster, NULL);
+    else
+        SDL_SetRenderTarget(game->renderer, NULL);
+}
+
+// the board with the falling piece alpha of the way from its position
+// before the last tick to the current one, and the next piece
+static void draw_play_board(Game *game, float alpha) {
+    const GameState *state = &game->state;
+    SpriteBatch *batch = &game->sprites;
+    int cell = game->cell_size;
+    int padding = cell_padding(game, cell);
+    int tile = cell - 2 * padding;
+    update_play_layer(game);
+    if (game->software)
+        raster_copy(&game->raster, &game->play_layer_image);
+    else
+        SDL_RenderCopy(game->renderer, game->play_layer, NULL, NULL);
+
+    // draw current piece
+    const Piece *piece = &state->piece;
+    float piece_x =
+        game->prev_piece.x + (piece->x - game->prev_piece.x) * alpha;
+    float piece_y =
+        game->prev_piece.y + (piece->y - game->prev_piece.y) * alpha;
+    for (int px = 0; px < 4; px++) {
+        for (int py = 0; py < 4; py++) {
+            int idx = rotate(px, py, piece->rotation);
+            if (tetriminos[piece->type][idx] == 'x') {
+                sprite_batch_add(
+                    batch,
+                    &ATLAS_TILE_RECT(svg_cell(&game->atlas, tile),
+                                     piece->type),
+                    &(SDL_FRect){game->board_xoff + (piece_x + px) * cell +
+                                     padding,
+                                 game->board_yoff + (piece_y + py) * cell,
+                                 tile, tile},
+                    WHITE);
+            }
+        }
+    }
+
+    // draw next piece
+    int x, y, w;
+    if (next_piece_box(game, &x, &y, &w)) {
+        cell = game->preview_cell;
+        padding = cell_padding(game, cell);
+        tile = cell - 2 * padding;
+        SDL_Rect src = ATLAS_TILE_RECT(svg_cell(&game->atlas, tile),
+                                       state->next_piece.type);
+        int pad = scaled(game, NEXT_PIECE_PADDING);
+        for (int px = 0; px < 4; px++) {
+            for (int py = 0; py < 4; py++) {
+                int idx = rotate(px, py, state->next_piece.rotation);
+                if (tetriminos[state->next_piece.type][idx] == 'x') {
+                    sprite_batch_add(
+                        batch, &src,
+                        &(SDL_FRect){x + pad + px * cell + padding,
+                                     y + pad + py * cell, tile, tile},
+                        WHITE);
+                }
+            }
+        }
+    }
+    sprite_batch_flush(batch);
+}
+
+// score and lines under the next piece box
+static void draw_play_hud(Game *game) {
+    int x, y, w;
+    if (!next_piece_box(game, &x, &y, &w))
+        return;
+
+    char value[16];
+    int size = scaled(game, HUD_TEXT_SIZE);
+    int hud_y = y + w + scaled(game, NEXT_PIECE_PADDING + 30);
+
+    text_draw_glyphs(&game->text, "Score", size, WHITE, x, hud_y);
+    snprintf(value, sizeof(value), "%u", game->state.score);
+    text_draw_glyphs(&game->text, value, size, WHITE, x,
+                     hud_y + scaled(game, 35));
+
+    text_draw_glyphs(&game->text, "Lines", size, WHITE, x,
+                     hud_y + scaled(game, 90));
+    snprintf(value, sizeof(value), "%u", game->state.lines_cleared);
+    text_draw_glyphs(&game->text, value, size, WHITE, x,
+                     hud_y + scaled(game, 125));
+}
+
+void game_draw_play(Game *game, float alpha) {
+    draw_play_board(game, alpha);
+    draw_play_hud(game);
+}
+
+// snapshots the game at the spawn of the current piece, dropping the
+// oldest snapshot when the history is full
+static void undo_push(Game *game) {
+    UndoHistory *undo = &game->undo;
+    if (undo->count == UNDO_DEPTH) {
+        snapshot_release(&undo->arena, undo->snapshots[0]);
+        memmove(undo->snapshots, undo->snapshots + 1,
+                (UNDO_DEPTH - 1) * sizeof(Snapshot *));
+        memmove(undo->ticks, undo->ticks + 1,
+                (UNDO_DEPTH - 1) * sizeof(uint32_t));
+        undo->count--;
+    }
+
+    const Snapshot *base =
+        undo->count > 0 ? undo->snapshots[undo->count - 1] : NULL;
+    Snapshot *snapshot = snapshot_take(&undo->arena, &game->state, base);
+    if (snapshot == NULL) {
+        fprintf(stderr, "WARNING: undo history is out of memory\n");
+        return;
+    }
+    undo->snapshots[undo->count] = snapshot;
+    undo->ticks[undo->count] = game->replay.ticks;
+    undo->count++;
+}
+
+// forgets the history and starts it with the game as it is, false when
+// the arena can't be set up for the board
+static bool undo_reset(Game *game) {
+    UndoHistory *undo = &game->undo;
+    const Board *board = &game->state.board;
+    for (int i = 0; i < undo->count; i++)
+        snapshot_release(&undo->arena, undo->snapshots[i]);
+    undo->count = 0;
+
+    // most locks change the 4 rows of the piece and nothing else
+    if (undo->arena.width != board->width ||
+        undo->arena.height != board->height) {
+        snapshot_arena_free(&undo->arena);
+        if (!snapshot_arena_init(&undo->arena, board->width,
+                                 board->height) ||
+            !snapshot_arena_reserve(&undo->arena, UNDO_DEPTH,
+                                    board->height + UNDO_DEPTH * 4))
+            return false;
+    }
+    undo_push(game);
+    return undo->count == 1;
+}
+
+// takes the game back to where the previous piece spawned, or the current
+// one when it is the first
+static void undo_piece(Game *game) {
+    UndoHistory *undo = &game->undo;
+    if (undo->count == 0)
+        return;
+
+    int target = SDL_max(undo->count - 2, 0);
+    snapshot_restore(&undo->arena, &game->state, undo->snapshots[target],
+                     undo->snapshots[undo->count - 1]);
+    replay_truncate(&game->replay, undo->ticks[target]);
+    for (int i = target + 1; i < undo->count; i++)
+        snapshot_release(&undo->arena, undo->snapshots[i]);
+    undo->count = target + 1;
+
+    game->prev_piece = game->state.piece;
+    game->input = INPUT_NONE;
+    input_reset(&game->controls);
+    game->bot_ready = false;
+}
+
+bool game_enable_practice(Game *game) {
+    game->practice = undo_reset(game);
+    return game->practice;
+}
+
+void new_game(Game *game, uint32_t seed) {
+    game_state_reset(&game->state, seed);
+    replay_record_init(&game->replay, &game->state, seed);
+    game->prev_piece = game->state.piece;
+    game->accumulator = 0;
+    game->input = INPUT_NONE;
+    input_reset(&game->controls);
+    game->bot_ready = false;
+    if (game->practice && !undo_reset(game)) {
+        fprintf(stderr, "WARNING: undo history is out of memory, practice "
+                        "mode is off\n");
+        game->practice = false;
+    }
+}
+
+void save_replay(Game *game) {
+    replay_record_finish(&game->replay, &game->state);
+    if (game->record_path != NULL &&
+        !replay_save(&game->replay, game->record_path)) {
+        fprintf(stderr, "WARNING: failed to save replay to %s: %s\n",
+                game->record_path, strerror(errno));
+    }
+}
+
+int play_screen(Game *game) {
+    GameState *state = &game->state;
+    float dt = get_delta();
+    PROFILE_BEGIN(ZONE_EVENTS);
+    // everything that arrived since the last frame, keys go to the input
+    // queue with their timestamps
+    Uint32 now = SDL_GetTicks();
+    bool undo = false;
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_QUIT) {
+            return SCREEN_EXIT;
+        }
+
+        // the contents of target textures are gone
+        if (e.type == SDL_RENDER_TARGETS_RESET ||
+            e.type == SDL_RENDER_DEVICE_RESET) {
+            game->play_layer_valid = false;
+        }
+
+        if (game->practice && e.type == SDL_KEYDOWN && !e.key.repeat &&
+            (e.key.keysym.sym == SDLK_u ||
+             e.key.keysym.sym == SDLK_BACKSPACE))
+            undo = true;
+
+        input_event(&game->controls, &e);
+        window_event(game, &e);
+        track_mouse(game, &e);
+        PROFILE_EVENT(&e);
+    }
+    PROFILE_END(ZONE_EVENTS);
+
+    if (undo)
+        undo_piece(game);
+    if (state->over)
+        return SCREEN_GAME_OVER;
+
+    // update in fixed ticks, the frame time only decides how many run
+    PROFILE_BEGIN(ZONE_SIMULATION);
+    game->accumulator += SDL_min(dt, MAX_FRAME_TIME);
+    while (game->accumulator >= 1.0f / TICK_RATE) {
+        game->accumulator -= 1.0f / TICK_RATE;
+        game->prev_piece = state->piece;
+
+        // the ticks of a frame catch up on the time since the last one,
+        // each takes the keys of the moment it stands for
+        Uint32 tick_time = now - (Uint32)(game->accumulator * 1000);
+        int input = game->input | input_tick(&game->controls, tick_time);
+        int rotation = state->piece.rotation;
+        game_state_apply_input(state, input);
+        if (state->piece.rotation != rotation)
+            sfx_play(&game->sfx, SFX_ROTATE);
+        replay_record_tick(&game->replay, input);
+        game->input = INPUT_NONE;
+
+        int events = game_state_step(state);
+        if (events & STEP_OVER) {
+            sfx_play(&game->sfx, SFX_GAME_OVER);
+            save_replay(game);
+            return SCREEN_PLAY;
+        }
+
+        if (events & STEP_LINES)
+            sfx_play(&game->sfx, SFX_LINE);
+        else if (events & STEP_LOCKED)
+            sfx_play(&game->sfx, SFX_LOCK);
+
+        if (events & STEP_LOCKED) {
+            // a new piece, nothing to interpolate from
+            game->prev_piece = state->piece;
+            game->bot_ready = false;
+            if (game->practice)
+                undo_push(game);
+        }
+    }
+    PROFILE_END(ZONE_SIMULATION);
+
+    // how far we are between the last tick and the next one
+    float alpha = game->accumulator * TICK_RATE;
+
+    PROFILE_BEGIN(ZONE_BOARD);
+    draw_play_board(game, alpha);
+    PROFILE_END(ZONE_BOARD);
+    PROFILE_BEGIN(ZONE_TEXT);
+    draw_play_hud(game);
+    PROFILE_END(ZONE_TEXT);
+
+    PROFILE_OVERLAY(&game->sprites, &game->text);
+    PROFILE_BEGIN(ZONE_PRESENT);
+    present(game);
+    input_presented(&game->controls);
+    PROFILE_END(ZONE_PRESENT);
+    return SCREEN_PLAY;
+}
+
+int autoplay_screen(Game *game) {
+    // decide once per piece, the input then steers it one step per frame
+    if (!game->state.over && !game->bot_ready) {
+        game->bot_move = bot_decide(game->bot, &game->state);
+        game->bot_ready = true;
+    }
+    game->input |= bot_input(&game->state.piece, game->bot_move);
+    return play_screen(game);
+}
+
+// the match as this side sees it, the local board on the left. the bar
+// next to a board shows the garbage about to rise into it
+static void draw_versus(Game *game) {
+    const Versus *versus = game->versus;
+    SpriteBatch *batch = &game->sprites;
+    int half = game->window_w / 2;
+    int cell = game->versus_cell;
+    int padding = cell_padding(game, cell);
+    int tile = cell - 2 * padding;
+    SDL_Rect first = svg_cell(&game->atlas, tile);
+
+    clear_screen(game);
+
+    for (int side = 0; side < VERSUS_PLAYERS; side++) {
+        int p = side == 0 ? versus->local : versus->remote;
+        const GameState *state = &versus->match.players[p];
+        const Board *board = &state->board;
+        int xoff = side * half + (half - board->width * cell) / 2;
+        int yoff = scaled(game, 50);
+
+        draw_board_rows(game, board, xoff, yoff, cell, 0, board->height - 1);
+        const Piece *piece = &state->piece;
+        for (int px = 0; px < 4; px++) {
+            for (int py = 0; py < 4; py++) {
+                int idx = rotate(px, py, piece->rotation);
+                if (tetriminos[piece->type][idx] != 'x' || state->over)
+                    continue;
+                sprite_batch_add(
+                    batch, &ATLAS_TILE_RECT(first, piece->type),
+                    &(SDL_FRect){xoff + (piece->x + px) * cell + padding,
+                                 yoff + (piece->y + py) * cell + padding,
+                                 tile, tile},
+                    WHITE);
+            }
+        }
+
+        int pending = SDL_min(versus->match.pending[p], board->height);
+        sprite_batch_fill(batch,
+                          &(SDL_FRect){xoff - scaled(game, 8),
+                                       yoff + (board->height - pending) * cell,
+                                       scaled(game, 6), pending * cell},
+                          GARBAGE_METER);
+    }
+    sprite_batch_flush(batch);
+
+    PROFILE_BEGIN(ZONE_TEXT);
+    int size = scaled(game, 30);
+    text_draw_glyphs(&game->text, "You", size, WHITE, scaled(game, 20),
+                     scaled(game, 10));
+    text_draw_glyphs(&game->text,
+                     versus->connected ? "Opponent" : "Waiting for opponent",
+                     size, WHITE, half + scaled(game, 20), scaled(game, 10));
+    PROFILE_END(ZONE_TEXT);
+}
+
+int versus_screen(Game *game) {
+    Versus *versus = game->versus;
+    GameState *local = &versus->match.players[versus->local];
+    float dt = get_delta();
+    PROFILE_BEGIN(ZONE_EVENTS);
+    Uint32 now = SDL_GetTicks();
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_QUIT)
+            return SCREEN_EXIT;
+        input_event(&game->controls, &e);
+        window_event(game, &e);
+        track_mouse(game, &e);
+        PROFILE_EVENT(&e);
+    }
+    PROFILE_END(ZONE_EVENTS);
+
+    if (versus_finished(versus))
+        return SCREEN_GAME_OVER;
+
+    // the same fixed ticks as a single game, the peer runs at the same rate
+    PROFILE_BEGIN(ZONE_SIMULATION);
+    game->accumulator += SDL_min(dt, MAX_FRAME_TIME);
+    while (game->accumulator >= 1.0f / TICK_RATE) {
+        game->accumulator -= 1.0f / TICK_RATE;
+
+        if (game->bot != NULL && !local->over && !game->bot_ready) {
+            game->bot_move = bot_decide(game->bot, local);
+            game->bot_ready = true;
+        }
+        if (game->bot != NULL)
+            game->input |= bot_input(&local->piece, game->bot_move);
+
+        Uint32 tick_time = now - (Uint32)(game->accumulator * 1000);
+        int input = game->input | input_tick(&game->controls, tick_time);
+        int events[VERSUS_PLAYERS];
+        if (!versus_tick(versus, input, events)) {
+            // waiting for the peer, the keys go into the next tick
+            game->input = input;
+            continue;
+        }
+        game->input = INPUT_NONE;
+
+        // a rollback may have changed the board under the plan
+        if ((events[versus->local] & STEP_LOCKED) || versus->rolled_back)
+            game->bot_ready = false;
+    }
+    PROFILE_END(ZONE_SIMULATION);
+
+    PROFILE_BEGIN(ZONE_BOARD);
+    draw_versus(game);
+    PROFILE_END(ZONE_BOARD);
+    PROFILE_OVERLAY(&game->sprites, &game->text);
+    PROFILE_BEGIN(ZONE_PRESENT);
+    present(game);
+    input_presented(&game->controls);
+    PROFILE_END(ZONE_PRESENT);
+    return SCREEN_PLAY;
+}
+
+bool spectate_layout(int count, int width, int height, int window_w,
+                     int window_h, SpectateLayout *layout) {
+    *layout = (SpectateLayout){0};
+    for (int columns = 1; columns <= count; columns++) {
+        int rows = (count + columns - 1) / columns;
+        int cell = SDL_min(
+            (window_w - (columns + 1) * SPECTATE_GAP) / (columns * width),
+            (window_h - (rows + 1) * SPECTATE_GAP) / (rows * height));
+        if (cell <= layout->cell)
+            continue;
+        layout->columns = columns;
+        layout->cell = cell;
+        int used_w = columns * (width * cell + SPECTATE_GAP) - SPECTATE_GAP;
+        int used_h = rows * (height * cell + SPECTATE_GAP) - SPECTATE_GAP;
+        layout->xoff = (window_w - used_w) / 2;
+        layout->yoff = (window_h - used_h) / 2;
+    }
+    return layout->cell >= 1;
+}
+
+void game_spectate(Game *game, Spectator *spectator) {
+    game->spectator = spectator;
+    layout(game);
+    update_images(game);
+}
+
+// every board of the frame as one batch. a board is a single quad of the
+// empty color with its filled cells on top, boards of games that ended are
+// grayed out
+static void draw_spectate(Game *game, const SpectatorFrame *frame) {
+    const Spectator *spectator = game->spectator;
+    const SpectateLayout *layout = &game->spectate_layout;
+    SpriteBatch *batch = &game->sprites;
+    int w = spectator->width;
+    int h = spectator->height;
+    int cell = layout->cell;
+    int padding = cell_padding(game, cell);
+    int tile = cell - 2 * padding;
+    SDL_Rect first = svg_cell(&game->atlas, tile);
+
+    clear_screen(game);
+    if (cell == 0)
+        return;
+    for (int i = 0; i < spectator->count; i++) {
+        int xoff = layout->xoff +
+                   i % layout->columns * (w * cell + SPECTATE_GAP);
+        int yoff = layout->yoff +
+                   i / layout->columns * (h * cell + SPECTATE_GAP);
+        const unsigned char *cells = frame->cells + (size_t)i * w * h;
+        bool over = frame->over[i];
+
+        sprite_batch_fill(batch, &(SDL_FRect){xoff, yoff, w * cell, h * cell},
+                          EMPTY_CELL);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int val = cells[y * w + x];
+                if (val == 0)
+                    continue;
+                SDL_FRect dst = {xoff + x * cell + padding,
+                                 yoff + y * cell + padding, tile, tile};
+                if (val == CELL_LINE)
+                    sprite_batch_fill(batch, &dst, WHITE);
+                else if (val == CELL_GARBAGE || over)
+                    sprite_batch_fill(batch, &dst, GARBAGE_CELL);
+                else
+                    sprite_batch_add(batch, &ATLAS_TILE_RECT(first, val - 1),
+                                     &dst, WHITE);
+            }
+        }
+        if (over)
+            continue;
+
+        const Piece *piece = &frame->pieces[i];
+        for (int px = 0; px < 4; px++) {
+            for (int py = 0; py < 4; py++) {
+                int idx = rotate(px, py, piece->rotation);
+                if (tetriminos[piece->type][idx] != 'x')
+                    continue;
+                sprite_batch_add(
+                    batch, &ATLAS_TILE_RECT(first, piece->type),
+                    &(SDL_FRect){xoff + (piece->x + px) * cell + padding,
+                                 yoff + (piece->y + py) * cell + padding,
+                                 tile, tile},
+                    WHITE);
+            }
+        }
+    }
+    sprite_batch_flush(batch);
+}
+
+int spectate_screen(Game *game) {
+    PROFILE_BEGIN(ZONE_EVENTS);
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_QUIT)
+            return SCREEN_EXIT;
+        window_event(game, &e);
+        track_mouse(game, &e);
+        PROFILE_EVENT(&e);
+    }
+    PROFILE_END(ZONE_EVENTS);
+
+    // the games run on their own, all this screen does is draw them
+    PROFILE_BEGIN(ZONE_BOARD);
+    const SpectatorFrame *frame = spectator_acquire(game->spectator);
+    draw_spectate(game, frame);
+    spectator_release(game->spectator);
+    PROFILE_END(ZONE_BOARD);
+    PROFILE_OVERLAY(&game->sprites, &game->text);
+    PROFILE_BEGIN(ZONE_PRESENT);
+    present(game);
+    PROFILE_END(ZONE_PRESENT);
+    return SCREEN_PLAY;
+}
+
+int game_over_screen(Game *game) {
+    static double counter = 0;
+    static char score[100];
+
+    bool clicked = false;
+
+    idle_wait(game, SCREEN_GAME_OVER);
+    PROFILE_BEGIN(ZONE_EVENTS);
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            return SCREEN_EXIT;
+        }
+
+        if (event.type == SDL_MOUSEBUTTONUP) {
+            clicked = true;
+        }
+        idle_event(game, &event);
+        window_event(game, &event);
+        track_mouse(game, &event);
+        PROFILE_EVENT(&event);
+    }
+    PROFILE_END(ZONE_EVENTS);
+
+    int w = game->window_w;
+    int h = game->window_h;
+    int back_h = scaled(game, 80);
+    int back_w = scaled(game, 150);
+    int back_x = w / 2 - back_w / 2;
+    int back_y = h / 2 + scaled(game, 150) - back_h / 2;
+    int mx = game->mouse_x;
+    int my = game->mouse_y;
+
+    bool hover = mx >= back_x && mx <= back_x + back_w && my >= back_y &&
+                 my <= back_y + back_w;
+    if (hover) {
+        back_w = scaled(game, 200);
+        back_x = w / 2 - back_w / 2;
+        // a versus match is played once per connection
+        if (clicked)
+            return game->versus != NULL ? SCREEN_EXIT : SCREEN_HOME;
+    }
+
+    int y = idle_bob(game, &counter);
+    if (!idle_changed(game, SCREEN_GAME_OVER, y, hover))
+        return SCREEN_GAME_OVER;
+
+    clear_screen(game);
+
+    PROFILE_BEGIN(ZONE_TEXT);
+    const char *title = "Game Over";
+    uint32_t points = game->state.score;
+    if (game->versus != NULL) {
+        const Match *match = &game->versus->match;
+        title = match->winner == game->versus->local ? "You Win"
+                : match->winner == VERSUS_PLAYERS    ? "Draw"
+                                                     : "You Lose";
+        points = match->players[game->versus->local].score;
+    }
+    text_draw(&game->text, title, scaled(game, 80), WHITE,
+              &(SDL_Rect){w / 2 - scaled(game, 150),
+                          h / 2 - scaled(game, 75 + 100 - y),
+                          scaled(game, 300), scaled(game, 150)});
+
+    sprintf(score, "Score: %d", points);
+    text_draw(&game->text, score, scaled(game, 50), WHITE,
+              &(SDL_Rect){w / 2 - scaled(game, 75), h / 2 + scaled(game, 10),
+                          scaled(game, 150), scaled(game, 80)});
+
+    text_draw(&game->text, "Go Back", scaled(game, 50), WHITE,
+              &(SDL_Rect){back_x, back_y, back_w, back_h});
+    PROFILE_END(ZONE_TEXT);
+
+    PROFILE_OVERLAY(&game->sprites, &game->text);
+    PROFILE_BEGIN(ZONE_PRESENT);
+    present(game);
+    PROFILE_END(ZONE_PRESENT);
+
+    return SCREEN_GAME_OVER;
+}
@@ -0,0 +1,245 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_ttf.h>
+#include <SDL2/SDL_video.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bot.h"
+#include "engine.h"
+#include "input.h"
+#include "raster.h"
+#include "replay.h"
+#include "sfx.h"
+#include "snapshot.h"
+#include "spectate.h"
+#include "sprite_batch.h"
+#include "svg.h"
+#include "text.h"
+#include "versus.h"
+
+// the window opens at this size, which everything below is measured at.
+// a larger or smaller window scales the whole layout
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+#define PIECE_WIDTH 30
+#define PIECE_HEIGHT 30
+#define PIECE_PADDING 1
+// cells smaller than this are drawn without padding
+#define MIN_PADDED_CELL 8
+#define PLAY_BTN_SIZE 40
+
+#define WHITE ((SDL_Color){255, 255, 255, 255})
+#define EMPTY_CELL ((SDL_Color){28, 28, 28, 255})
+#define BACKGROUND ((SDL_Color){51, 51, 51, 255})
+#define GARBAGE_CELL ((SDL_Color){120, 120, 120, 255})
+#define GARBAGE_METER ((SDL_Color){230, 60, 60, 255})
+
+#define NEXT_PIECE_PADDING 10
+// font size of the score and lines, and every character they are made of
+#define HUD_TEXT_SIZE 30
+#define HUD_GLYPHS "ScoreLines0123456789"
+
+// atlas region of the tile for a piece type, in the strip whose first
+// tile is first
+#define ATLAS_TILE_RECT(first, type)                                           \
+    ((SDL_Rect){(first).x + (type) * (first).w, (first).y, (first).w,          \
+                (first).h})
+
+// longest frame the simulation catches up on, anything beyond is dropped
+// so a stall doesn't turn into a burst of ticks
+#define MAX_FRAME_TIME 0.25f
+// frame cap used when the renderer has no vsync
+#define DEFAULT_FPS 120
+// games run by --env
+#define DEFAULT_ENVS 64
+// samples per mixer buffer, also what the sound effect latency is
+// measured against
+#define AUDIO_FREQUENCY 44100
+#define AUDIO_BUFFER 512
+
+// the title of the home and game over screens bobs BOB_HEIGHT pixels up
+// and down at BOB_SPEED radians per second
+#define BOB_HEIGHT 10
+#define BOB_SPEED 5
+// without input for IDLE_AFTER_MS the title holds still, and those
+// screens never sleep longer than IDLE_WAIT_MS
+#define IDLE_AFTER_MS 30000
+#define IDLE_WAIT_MS 1000
+
+// pixels between the boards of the spectator screen
+#define SPECTATE_GAP 4
+
+// pieces practice mode can take back
+#define UNDO_DEPTH 256
+
+#define SCREEN_EXIT -1
+#define SCREEN_HOME 0
+#define SCREEN_PLAY 1
+#define SCREEN_GAME_OVER 2
+
+// the home and game over screens show a bobbing title and a button and
+// nothing else. they sleep in SDL_WaitEventTimeout until an event comes in
+// or the title is due to move by a pixel, and only draw a frame when it
+// would look different from the last one
+typedef struct {
+    // what the frame numbered frame showed, valid is cleared by events
+    // that may change the screen in other ways
+    bool valid;
+    int screen;
+    int y;
+    bool hover;
+    uint32_t frame;
+    // how long the screen may sleep before its next frame
+    Uint32 wait_ms;
+    Uint32 last_input;
+} IdleScreen;
+
+// practice mode snapshots the game every time a piece spawns, each one
+// taken from the one before so they share the rows that didn't change.
+// ticks holds the length of the recording at each
+typedef struct {
+    SnapshotArena arena;
+    Snapshot *snapshots[UNDO_DEPTH];
+    uint32_t ticks[UNDO_DEPTH];
+    int count;
+} UndoHistory;
+
+// where the spectator screen puts its boards, columns of them from xoff,
+// yoff on with cells of cell pixels
+typedef struct {
+    int columns;
+    int cell;
+    int xoff;
+    int yoff;
+} SpectateLayout;
+
+typedef struct {
+    GameState state;
+    uint32_t board_xoff;
+    uint32_t board_yoff;
+    int cell_size;
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    // size of what is drawn in pixels, output pixels per window coordinate
+    // and how much the layout is scaled up from WINDOW_WIDTH, WINDOW_HEIGHT
+    int window_w;
+    int window_h;
+    float pixel_density;
+    float scale;
+    // cells of the next piece and of the boards of a versus match
+    int preview_cell;
+    int versus_cell;
+    // the tiles and the play button at the sizes the layout draws them
+    SvgStrips atlas;
+    SvgStrips play_btn;
+    SDL_Texture *pieces_texture;
+    SDL_Texture *play_btn_texture;
+    Mix_Music *bg_music;
+    SoundEffects sfx;
+    TTF_Font *font;
+    TextCache text;
+    SpriteBatch sprites;
+    // background, locked board and next piece frame of the play screen,
+    // redrawn only where something changed
+    SDL_Texture *play_layer;
+    bool play_layer_valid;
+    // everything is drawn by the raster instead of the renderer when
+    // software is set, with the images below in place of the textures
+    Raster raster;
+    bool software;
+    RasterImage atlas_image;
+    RasterImage play_btn_image;
+    RasterImage play_layer_image;
+    // simulation time not yet consumed by ticks
+    float accumulator;
+    // keyboard input, and inputs from elsewhere for the next tick
+    InputState controls;
+    int input;
+    // piece as it was before the last tick, used to interpolate
+    Piece prev_piece;
+    // every game is recorded, and saved to record_path when it is set
+    Replay replay;
+    const char *record_path;
+    // drives the play screen when set, bot_move is where the current piece
+    // goes once bot_ready
+    Bot *bot;
+    BotMove bot_move;
+    bool bot_ready;
+    // a match against another instance instead of a single game when set
+    Versus *versus;
+    // the spectator screen instead of a game when set
+    Spectator *spectator;
+    SpectateLayout spectate_layout;
+    IdleScreen idle;
+    // U or backspace takes the last piece back when practice is set
+    bool practice;
+    UndoHistory undo;
+    // pointer position of the last mouse event, -1 before the first one.
+    // unlike SDL_GetMouseState it follows the events of --script too
+    int mouse_x;
+    int mouse_y;
+    // frames presented so far
+    uint32_t presented;
+} Game;
+
+// loads the textures and font the screens need and starts the first game
+// with clear_ticks long line clears, exits when something is missing
+void game_init(Game *game, SDL_Window *window, SDL_Renderer *renderer,
+               int board_width, int board_height, int clear_ticks,
+               uint32_t seed);
+void game_free(Game *game);
+// a game that only draws into game->raster.frame of WINDOW_WIDTH,
+// WINDOW_HEIGHT, for rendering without a window. atlas must have a strip of
+// every tile size the board can be drawn at, atlas_image is its surface.
+// they and font are shared with the caller and only read as long as every
+// string drawn is already in game->text
+bool game_init_offscreen(Game *game, const SvgStrips *atlas,
+                         const RasterImage *atlas_image, TTF_Font *font,
+                         int board_width, int board_height, uint32_t seed);
+// starts a game on a board of another size, returns false with errno set
+// when it can't be allocated
+bool game_resize(Game *game, int board_width, int board_height,
+                 uint32_t seed);
+// switches between the renderer and the raster, which is set up the first
+// time. returns false with the SDL error set when that fails
+bool game_use_raster(Game *game, bool enabled);
+
+// tiles count boards of that size over a window of window_w, window_h as
+// large as they fit, false when they don't even fit with cells of a pixel
+bool spectate_layout(int count, int width, int height, int window_w,
+                     int window_h, SpectateLayout *layout);
+// shows the games of spectator instead of playing, which must fit the
+// window as it opens. a window shrunk below that shows no boards
+void game_spectate(Game *game, Spectator *spectator);
+
+// turns on practice mode, returns false when the snapshots can't be
+// allocated
+bool game_enable_practice(Game *game);
+
+// get time elapsed since last frame
+float get_delta();
+
+// starts a new game and its recording
+void new_game(Game *game, uint32_t seed);
+void save_replay(Game *game);
+
+// draws the play screen as it is alpha of the way from the last tick to
+// the next one, without presenting it
+void game_draw_play(Game *game, float alpha);
+
+// every screen handles one frame and returns the screen of the next one
+int home_screen(Game *game);
+int play_screen(Game *game);
+// the play screen with game->bot at the controls
+int autoplay_screen(Game *game);
+// both boards of game->versus, played with the keyboard or the bot
+int versus_screen(Game *game);
+// every game of game->spectator at once
+int spectate_screen(Game *game);
+int game_over_screen(Game *game);
+
+#endif
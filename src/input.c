@@ -0,0 +1,161 @@
+#include "input.h"
+
+#include <SDL2/SDL_keycode.h>
+#include <SDL2/SDL_timer.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "stats.h"
+
+// index of the INPUT_* bit of a key, -1 for keys the game doesn't use
+static int key_action(SDL_Keycode key) {
+    switch (key) {
+    case SDLK_a:
+    case SDLK_LEFT:
+        return 0;
+    case SDLK_d:
+    case SDLK_RIGHT:
+        return 1;
+    case SDLK_w:
+    case SDLK_UP:
+        return 2;
+    case SDLK_s:
+    case SDLK_DOWN:
+        return 3;
+    }
+    return -1;
+}
+
+static int ms_to_ticks(int ms) {
+    // rounded up, a repeat never comes sooner than asked
+    int ticks = (ms * TICK_RATE + 999) / 1000;
+    return ticks > 0 ? ticks : 1;
+}
+
+void input_init(InputState *input, int das_ms, int arr_ms) {
+    memset(input, 0, sizeof(*input));
+    input->das_ticks = ms_to_ticks(das_ms);
+    input->arr_ticks = ms_to_ticks(arr_ms);
+}
+
+void input_reset(InputState *input) {
+    input->head = 0;
+    input->count = 0;
+    input->unshown_count = 0;
+    memset(input->held, 0, sizeof(input->held));
+    memset(input->held_ticks, 0, sizeof(input->held_ticks));
+}
+
+// whether the action is down once the queued events are simulated
+static bool action_down(const InputState *input, int action) {
+    for (int i = input->count - 1; i >= 0; i--) {
+        const InputEvent *event =
+            &input->events[(input->head + i) % INPUT_QUEUE_SIZE];
+        if (event->action == action)
+            return event->down;
+    }
+    return input->held[action];
+}
+
+bool input_event(InputState *input, const SDL_Event *event) {
+    if (event->type != SDL_KEYDOWN && event->type != SDL_KEYUP)
+        return false;
+
+    int action = key_action(event->key.keysym.sym);
+    if (action < 0)
+        return false;
+
+    // held keys repeat on the simulation clock
+    bool down = event->type == SDL_KEYDOWN;
+    if (down && event->key.repeat)
+        return true;
+
+    if (down) {
+        // the last INPUT_ACTIONS slots are kept for releases
+        input->presses++;
+        if (input->count >= INPUT_QUEUE_SIZE - INPUT_ACTIONS) {
+            input->dropped++;
+            return true;
+        }
+    } else if (!action_down(input, action)) {
+        // the press was dropped or the key is already up, nothing to undo.
+        // so past the press limit each action adds at most one release
+        // and the queue never overflows
+        return true;
+    }
+
+    int tail = (input->head + input->count) % INPUT_QUEUE_SIZE;
+    input->events[tail] = (InputEvent){
+        .action = action, .down = down, .time = event->key.timestamp};
+    input->count++;
+    return true;
+}
+
+int input_tick(InputState *input, Uint32 tick_time) {
+    int mask = INPUT_NONE;
+    int pressed = INPUT_NONE;
+
+    while (input->count > 0) {
+        const InputEvent *event = &input->events[input->head];
+        // newer than the tick, or a second press of an action that already
+        // fired, both wait for the next tick
+        if ((Sint32)(event->time - tick_time) > 0)
+            break;
+        int bit = 1 << event->action;
+        if (event->down && (pressed & bit))
+            break;
+
+        if (event->down) {
+            pressed |= bit;
+            input->held[event->action] = true;
+            input->held_ticks[event->action] = 0;
+            input->applied++;
+            if (input->unshown_count < INPUT_QUEUE_SIZE)
+                input->unshown[input->unshown_count++] = event->time;
+        } else {
+            input->held[event->action] = false;
+        }
+        input->head = (input->head + 1) % INPUT_QUEUE_SIZE;
+        input->count--;
+    }
+    mask |= pressed;
+
+    for (int action = 0; action < INPUT_ACTIONS; action++) {
+        int bit = 1 << action;
+        if (!input->held[action] || (pressed & bit))
+            continue;
+
+        int ticks = ++input->held_ticks[action];
+        if (bit == INPUT_SOFT_DROP) {
+            mask |= bit;
+        } else if ((bit == INPUT_LEFT || bit == INPUT_RIGHT) &&
+                   ticks >= input->das_ticks &&
+                   (ticks - input->das_ticks) % input->arr_ticks == 0) {
+            mask |= bit;
+        }
+    }
+
+    return mask;
+}
+
+void input_presented(InputState *input) {
+    Uint32 now = SDL_GetTicks();
+    for (int i = 0; i < input->unshown_count; i++) {
+        input->latency[input->latency_next] = now - input->unshown[i];
+        input->latency_next = (input->latency_next + 1) % INPUT_LATENCY_WINDOW;
+        if (input->latency_count < INPUT_LATENCY_WINDOW)
+            input->latency_count++;
+    }
+    input->unshown_count = 0;
+}
+
+bool input_latency(const InputState *input, float *p50, float *p99,
+                   float *max) {
+    int count = input->latency_count;
+    if (count == 0)
+        return false;
+
+    percentiles(input->latency, count, p50, p99, max);
+    return true;
+}
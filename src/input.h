@@ -0,0 +1,76 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+// keyboard input of the play screen. key events are queued with the time
+// SDL saw them and handed to the simulation at the tick that time falls
+// in, so a long frame neither loses nor bunches up key presses. an action
+// fires at most once per tick, a second press of the same key waits for
+// the next one
+//
+// held keys repeat on the simulation clock instead of the OS key repeat:
+// left and right after the delayed auto shift (das), then every auto
+// repeat rate (arr) ticks, soft drop every tick
+
+#include <SDL2/SDL_events.h>
+#include <SDL2/SDL_stdinc.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define INPUT_QUEUE_SIZE 256
+// one per INPUT_* bit
+#define INPUT_ACTIONS 4
+#define DEFAULT_DAS_MS 167
+#define DEFAULT_ARR_MS 33
+// latency samples the statistics cover
+#define INPUT_LATENCY_WINDOW 256
+
+typedef struct {
+    // index of the INPUT_* bit
+    uint8_t action;
+    bool down;
+    // SDL_GetTicks time of the event
+    Uint32 time;
+} InputEvent;
+
+typedef struct {
+    // ring of events not handed to the simulation yet
+    InputEvent events[INPUT_QUEUE_SIZE];
+    int head;
+    int count;
+    int das_ticks;
+    int arr_ticks;
+    bool held[INPUT_ACTIONS];
+    int held_ticks[INPUT_ACTIONS];
+    // event times of the presses simulated since the last present
+    Uint32 unshown[INPUT_QUEUE_SIZE];
+    int unshown_count;
+    // ring of press to present times in ms
+    float latency[INPUT_LATENCY_WINDOW];
+    int latency_next;
+    int latency_count;
+    uint32_t presses;
+    uint32_t applied;
+    // presses lost to a full queue, which should never happen. releases
+    // always get in
+    uint32_t dropped;
+} InputState;
+
+void input_init(InputState *input, int das_ms, int arr_ms);
+// forgets queued and held keys, the statistics stay
+void input_reset(InputState *input);
+
+// queues key events of the game keys, returns false for other events
+bool input_event(InputState *input, const SDL_Event *event);
+
+// the INPUT_* mask of the tick that simulates the moment tick_time
+int input_tick(InputState *input, Uint32 tick_time);
+
+// call right after presenting a frame, the presses simulated before it
+// count as shown
+void input_presented(InputState *input);
+
+// percentiles of the press to present latency in ms, false without samples
+bool input_latency(const InputState *input, float *p50, float *p99,
+                   float *max);
+
+#endif
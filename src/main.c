@@ -2,7 +2,6 @@
 #include <SDL2/SDL_audio.h>
 #include <SDL2/SDL_error.h>
 #include <SDL2/SDL_events.h>
-#include <SDL2/SDL_image.h>
 #include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_mixer.h>
 #include <SDL2/SDL_mouse.h>
@@ -22,524 +21,829 @@
 #include <string.h>
 #include <time.h>
 
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 600
-#define PIECE_WIDTH 30
-#define PIECE_HEIGHT 30
-#define PIECE_PADDING 1
-#define BOARD_WIDTH 10
-#define BOARD_HEIGHT 20
-
-#define SCREEN_EXIT -1
-#define SCREEN_HOME 0
-#define SCREEN_PLAY 1
-#define SCREEN_GAME_OVER 2
-
-const char tetriminos[7][16] = {"..x...x...x...x.", ".xx..xx.........",
-                                ".....xx.xx......", "....xx...xx.....",
-                                ".....x...x...xx.", "......x...x..xx.",
-                                "....xxx..x......"};
-
-unsigned char *board = NULL;
-int lines[BOARD_HEIGHT];
-int line_ptr = 0;
-
+#include "analyze.h"
+#include "assets.h"
+#include "env.h"
+#include "export.h"
+#include "game.h"
+#include "profile.h"
+#include "svg.h"
+
+// play screen frames drawn by each backend to pick one with --renderer auto
+#define RENDERER_WARMUP_FRAMES 5
+#define RENDERER_TEST_FRAMES 30
+
+// opening the music decodes the start of a 3.7MB mp3, that happens on this
+// thread while the home screen is already showing, together with building
+// the sound effects. done is set once game->bg_music holds the result
 typedef struct {
-    const char *shape;
-    int color;
-    int x;
-    int y;
-    int rotation;
-} Piece;
-
-typedef struct {
-    Piece piece;
-    Piece next_piece;
-    bool over;
-    float y;
-    int yspeed;
-    uint32_t board_xoff;
-    uint32_t board_yoff;
-    SDL_Window *window;
-    SDL_Renderer *renderer;
-    SDL_Texture *pieces_texture;
-    SDL_Texture *play_btn_texture;
-    Mix_Music *bg_music;
-    TTF_Font *font;
-    uint32_t score;
-} Game;
-
-// returns the index of (x, y) corresponding to the rotated shape
-int rotate(int x, int y, int rotation) {
-    switch (rotation) {
-    // 0 deg
-    case 0:
-        return y * 4 + x;
-    // 90 deg
-    case 1:
-        return 12 + y - 4 * x;
-    // 180 deg
-    case 2:
-        return 15 - x - 4 * y;
-    // 270 deg
-    case 3:
-        return 3 - y + 4 * x;
+    Game *game;
+    SDL_atomic_t done;
+} MusicLoader;
+
+int load_music(void *data) {
+    MusicLoader *loader = data;
+    sfx_load(&loader->game->sfx);
+    SDL_RWops *rw = asset_open("music/bg.mp3");
+    loader->game->bg_music = rw != NULL ? Mix_LoadMUS_RW(rw, 1) : NULL;
+    if (loader->game->bg_music == NULL) {
+        fprintf(stderr, "WARNING: failed to load music: %s\n",
+                SDL_GetError());
     }
 
+    SDL_AtomicSet(&loader->done, 1);
     return 0;
 }
 
-// checks if the piece fits into the board
-bool does_piece_fit(const char *shape, int x, int y, int rotation) {
-    for (int px = 0; px < 4; px++) {
-        for (int py = 0; py < 4; py++) {
-            // get index into piece
-            int pi = rotate(px, py, rotation);
+enum { RENDERER_AUTO, RENDERER_SDL, RENDERER_CPU };
 
-            // get index into board
-            int bi = (py + y) * BOARD_WIDTH + (px + x);
+// cpu time of every thread of the process, audio and loaders included
+double process_cpu_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
 
-            if (shape[pi] == 'x') {
-                if (px + x < 0 || px + x >= BOARD_WIDTH || py + y < 0 ||
-                    py + y >= BOARD_HEIGHT) {
-                    return false;
-                }
-            }
+// average time of a play screen frame in ms, after a few to warm up the
+// caches. the game starts over afterwards
+float time_frames(Game *game, uint32_t seed) {
+    for (int i = 0; i < RENDERER_WARMUP_FRAMES; i++)
+        play_screen(game);
 
-            if (px + x >= 0 && px + x < BOARD_WIDTH && py + y >= 0 &&
-                py + y < BOARD_HEIGHT) {
-                if (shape[pi] == 'x' && board[bi] != 0) {
-                    return false;
-                }
-            }
-        }
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < RENDERER_TEST_FRAMES; i++) {
+        if (play_screen(game) != SCREEN_PLAY)
+            new_game(game, seed);
     }
-    return true;
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    new_game(game, seed);
+    return (float)elapsed * 1000 / SDL_GetPerformanceFrequency() /
+           RENDERER_TEST_FRAMES;
 }
 
-// get time elapsed since last frame
-float get_delta() {
-    static Uint32 last_time = 0;
-    Uint32 curr_time = SDL_GetTicks();
-    float dt = (curr_time - last_time) / 1000.0f;
-    last_time = curr_time;
-    return dt;
-}
-
-int home_screen(Game *game) {
-    static int y = 0;
-    static double counter = 0;
-
-    int play_btn_width = 40;
-    int play_btn_height = 40;
-    int px = WINDOW_WIDTH / 2 - play_btn_width / 2;
-    int py = WINDOW_HEIGHT / 2 + 100 - play_btn_height / 2;
-    bool clicked = false;
+// events of --script, each pushed once the main loop has run for at ms
+typedef struct {
+    Uint32 at;
+    SDL_Event event;
+} ScriptEvent;
 
-    SDL_Event e;
-    if (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT) {
-            return SCREEN_EXIT;
+typedef struct {
+    ScriptEvent *events;
+    int count;
+    int capacity;
+    int next;
+    Uint32 start;
+} Script;
+
+void script_add(Script *script, Uint32 at, SDL_Event event) {
+    if (script->count == script->capacity) {
+        int capacity = script->capacity ? script->capacity * 2 : 64;
+        ScriptEvent *events =
+            realloc(script->events, capacity * sizeof(ScriptEvent));
+        if (events == NULL) {
+            fprintf(stderr, "ERROR: script is out of memory\n");
+            exit(1);
         }
+        script->events = events;
+        script->capacity = capacity;
+    }
+    script->events[script->count++] = (ScriptEvent){at, event};
+}
 
-        // detect mouse click
-        if (e.type == SDL_MOUSEBUTTONUP) {
-            clicked = true;
+// adds the events of one line of a script, false when it isn't valid
+bool script_parse(Script *script, Uint32 at, const char *action,
+                  const char *args) {
+    SDL_Event e = {0};
+    int x, y;
+    char name[64];
+    if (strcmp(action, "quit") == 0) {
+        e.type = SDL_QUIT;
+        script_add(script, at, e);
+    } else if (strcmp(action, "move") == 0) {
+        if (sscanf(args, "%d %d", &x, &y) != 2)
+            return false;
+        e.type = SDL_MOUSEMOTION;
+        e.motion.x = x;
+        e.motion.y = y;
+        script_add(script, at, e);
+    } else if (strcmp(action, "click") == 0) {
+        if (sscanf(args, "%d %d", &x, &y) != 2)
+            return false;
+        e.type = SDL_MOUSEBUTTONDOWN;
+        e.button.button = SDL_BUTTON_LEFT;
+        e.button.state = SDL_PRESSED;
+        e.button.clicks = 1;
+        e.button.x = x;
+        e.button.y = y;
+        script_add(script, at, e);
+        e.type = SDL_MOUSEBUTTONUP;
+        e.button.state = SDL_RELEASED;
+        script_add(script, at, e);
+    } else if (strcmp(action, "press") == 0 ||
+               strcmp(action, "release") == 0 ||
+               strcmp(action, "key") == 0) {
+        if (sscanf(args, "%63s", name) != 1)
+            return false;
+        e.key.keysym.sym = SDL_GetKeyFromName(name);
+        if (e.key.keysym.sym == SDLK_UNKNOWN)
+            return false;
+        if (action[0] != 'r') {
+            e.type = SDL_KEYDOWN;
+            e.key.state = SDL_PRESSED;
+            script_add(script, at, e);
+        }
+        if (action[0] != 'p') {
+            e.type = SDL_KEYUP;
+            e.key.state = SDL_RELEASED;
+            script_add(script, at, e);
         }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// reads a script of one action per line, "MS move X Y", "MS click X Y",
+// "MS press KEY", "MS release KEY", "MS key KEY" or "MS quit", in the order
+// they happen. MS counts from the first frame, KEY is an SDL key name like
+// Down or Space and # starts a comment. exits when the file isn't a script
+void load_script(Script *script, const char *path) {
+    memset(script, 0, sizeof(*script));
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: failed to open script %s: %s\n", path,
+                strerror(errno));
+        exit(1);
     }
 
-    int mx;
-    int my;
-    SDL_GetMouseState(&mx, &my);
+    char line[256];
+    unsigned last = 0;
+    for (int number = 1; fgets(line, sizeof(line), file) != NULL;
+         number++) {
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+        unsigned at;
+        char action[16];
+        int args = 0;
+        int fields = sscanf(line, "%u %15s %n", &at, action, &args);
+        if (fields == EOF)
+            continue;
+        if (fields != 2 || at < last ||
+            !script_parse(script, at, action, line + args)) {
+            fprintf(stderr, "ERROR: %s:%d: invalid script line\n", path,
+                    number);
+            exit(1);
+        }
+        last = at;
+    }
+    fclose(file);
+}
 
-    if (mx >= px && mx <= px + play_btn_width && my >= py &&
-        my <= py + play_btn_height) {
-        if (clicked)
-            return SCREEN_PLAY;
-        play_btn_width *= 2;
-        play_btn_height *= 2;
-        px = WINDOW_WIDTH / 2 - play_btn_width / 2;
-        py = WINDOW_HEIGHT / 2 + 100 - play_btn_height / 2;
+// pushes every event that is due, the screens read them like any other
+void script_run(Script *script) {
+    Uint32 elapsed = SDL_GetTicks() - script->start;
+    while (script->next < script->count &&
+           script->events[script->next].at <= elapsed) {
+        SDL_PushEvent(&script->events[script->next].event);
+        script->next++;
     }
+}
 
-    SDL_SetRenderDrawColor(game->renderer, 51, 51, 51, 255);
-    SDL_RenderClear(game->renderer);
+// re-simulates a recorded game at full speed, exits with 1 when it doesn't
+// end the way it was recorded
+int play_replay(const char *path) {
+    Replay replay;
+    if (!replay_load(&replay, path)) {
+        fprintf(stderr, "ERROR: failed to load replay %s\n", path);
+        exit(1);
+    }
 
-    float dt = get_delta();
-    counter = (counter + 5 * dt);
-    if (counter > INT_MAX)
-        counter = 0;
-    y = 10 * sin(counter);
-    TTF_SetFontSize(game->font, 80);
-    SDL_Surface *surface = TTF_RenderText_Solid(
-        game->font, "The Tetris", (SDL_Color){255, 255, 255, 255});
-    SDL_Texture *texture =
-        SDL_CreateTextureFromSurface(game->renderer, surface);
+    GameState state;
+    Uint64 start = SDL_GetPerformanceCounter();
+    bool ok = replay_play(&replay, &state);
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) /
+                     SDL_GetPerformanceFrequency();
+
+    printf("%s: %u ticks in %.3fs (%.0f ticks/s), score %u, lines %u, hash "
+           "%016llx: %s\n",
+           path, replay.ticks, seconds,
+           seconds > 0 ? replay.ticks / seconds : 0.0, state.score,
+           state.lines_cleared, (unsigned long long)game_state_hash(&state),
+           ok ? "ok" : "MISMATCH");
+    if (!ok) {
+        printf("expected score %u, lines %u, hash %016llx\n", replay.score,
+               replay.lines_cleared, (unsigned long long)replay.hash);
+    }
 
-    SDL_RenderCopy(game->renderer, texture, NULL,
-                   &(SDL_Rect){WINDOW_WIDTH / 2 - 150,
-                               WINDOW_HEIGHT / 2 - 75 - 100 + y, 300, 150});
+    game_state_free(&state);
+    replay_free(&replay);
+    return ok ? 0 : 1;
+}
 
-    SDL_RenderCopy(game->renderer, game->play_btn_texture, NULL,
-                   &(SDL_Rect){px, py, play_btn_width, play_btn_height});
+// lets the bot play up to pieces pieces without a window and reports how
+// well and how fast it played
+int play_bot(Bot *bot, int width, int height, int clear_ticks, uint32_t seed,
+             int pieces) {
+    GameState state;
+    if (!game_state_init(&state, width, height, seed)) {
+        fprintf(stderr, "ERROR: failed to initialize board: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    state.clear_ticks = clear_ticks;
+
+    int placed = 0;
+    int late = 0;
+    int depths = 0;
+    BotMove move = bot_decide(bot, &state);
+    while (placed < pieces) {
+        game_state_apply_input(&state, bot_input(&state.piece, move));
+        int events = game_state_step(&state);
+        if (events & STEP_OVER)
+            break;
 
-    SDL_RenderPresent(game->renderer);
+        if (events & STEP_LOCKED) {
+            placed++;
+            move = bot_decide(bot, &state);
+            depths += bot->last_depth;
+            if (bot->last_ms > 1000.0 / TICK_RATE)
+                late++;
+        }
+    }
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
-    return SCREEN_HOME;
+    printf("bot: %d pieces, score %u, lines %u%s\n", placed, state.score,
+           state.lines_cleared, state.over ? ", game over" : "");
+    printf("%d decisions on %d threads, mean depth %.2f, mean %.3fms, max "
+           "%.3fms, %d over a tick\n",
+           bot->decisions, bot->pool.thread_count,
+           placed > 0 ? (double)depths / placed : 0.0,
+           bot->total_ms / bot->decisions, bot->max_ms, late);
+    printf("%llu nodes, %.0f nodes/s\n",
+           (unsigned long long)bot->total_nodes, bot_nodes_per_second(bot));
+
+    game_state_free(&state);
+    return 0;
 }
 
-int play_screen(Game *game) {
-    float dt = get_delta();
-    SDL_Event e;
-    if (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT) {
-            return SCREEN_EXIT;
+// plays a match between two bots on this machine, each side running the
+// netcode on a port of its own as if it were another instance, and
+// reports what the rollbacks cost. exits with 1 when the sides disagree
+int play_versus_test(Bot bots[VERSUS_PLAYERS], int width, int height,
+                     int clear_ticks, uint32_t seed, int ticks, int port,
+                     LinkConditions link) {
+    Versus sides[VERSUS_PLAYERS];
+    for (int i = 0; i < VERSUS_PLAYERS; i++) {
+        if (!versus_init(&sides[i], width, height, clear_ticks, seed,
+                         port + i, "127.0.0.1", port + 1 - i, link)) {
+            fprintf(stderr, "ERROR: failed to open port %d: %s\n", port + i,
+                    strerror(errno));
+            exit(1);
         }
+    }
 
-        if (e.type == SDL_KEYDOWN) {
-            switch (e.key.keysym.sym) {
-            case SDLK_w:
-            case SDLK_UP: {
-                int nextRot = (game->piece.rotation + 1) % 4;
-                if (does_piece_fit(game->piece.shape, game->piece.x,
-                                   game->piece.y, nextRot)) {
-                    game->piece.rotation = nextRot;
-                }
-                break;
-            }
-            case SDLK_d:
-            case SDLK_RIGHT:
-                if (does_piece_fit(game->piece.shape, game->piece.x + 1,
-                                   game->piece.y, game->piece.rotation))
-                    game->piece.x += 1;
-                break;
-            case SDLK_a:
-            case SDLK_LEFT:
-                if (does_piece_fit(game->piece.shape, game->piece.x - 1,
-                                   game->piece.y, game->piece.rotation))
-                    game->piece.x -= 1;
-                break;
-            case SDLK_s:
-            case SDLK_DOWN:
-                game->y += 1;
-                break;
+    BotMove moves[VERSUS_PLAYERS];
+    bool ready[VERSUS_PLAYERS] = {false, false};
+    Uint64 tick_length = SDL_GetPerformanceFrequency() / TICK_RATE;
+    Uint64 next = SDL_GetPerformanceCounter();
+    int tick = 0;
+    for (; tick < ticks; tick++) {
+        if (versus_finished(&sides[0]) && versus_finished(&sides[1]))
+            break;
+
+        for (int i = 0; i < VERSUS_PLAYERS; i++) {
+            Versus *side = &sides[i];
+            const GameState *local = &side->match.players[side->local];
+            if (!ready[i] && !local->over) {
+                moves[i] = bot_decide(&bots[i], local);
+                ready[i] = true;
             }
+
+            int events[VERSUS_PLAYERS];
+            bool simulated = versus_tick(
+                side, bot_input(&local->piece, moves[i]), events);
+            if (side->rolled_back ||
+                (simulated && (events[side->local] & STEP_LOCKED)))
+                ready[i] = false;
         }
-    }
 
-    if (game->over)
-        return SCREEN_GAME_OVER;
+        // the link emulation runs on the wall clock, so do the ticks
+        next += tick_length;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < next) {
+            SDL_Delay((next - now) * 1000 / SDL_GetPerformanceFrequency());
+        }
+    }
 
-    SDL_SetRenderDrawColor(game->renderer, 51, 51, 51, 255);
-    SDL_RenderClear(game->renderer);
+    bool ok = true;
+    for (int i = 0; i < VERSUS_PLAYERS; i++) {
+        Versus *side = &sides[i];
+        float p50 = 0, p99 = 0, max = 0;
+        versus_tick_times(side, &p50, &p99, &max);
+        printf("player %d: tick %u, %u rollbacks of %.1f ticks on average, "
+               "max %u, %.3fms each\n",
+               side->local, side->match.tick, side->rollbacks,
+               side->rollbacks > 0 ? (double)side->resimulated / side->rollbacks
+                                   : 0.0,
+               side->max_rollback,
+               side->rollbacks > 0 ? side->rollback_ms / side->rollbacks
+                                   : 0.0);
+        printf("  tick time p50 %.3fms, p99 %.3fms, max %.3fms, %u stalls, "
+               "%u sync waits\n",
+               p50, p99, max, side->stalls, side->sync_waits);
+        printf("  %u packets sent, %u lost, %u received, %u hash checks, "
+               "%u desyncs\n",
+               side->net.sent, side->net.lost, side->net.received,
+               side->hash_checks, side->desyncs);
+        ok = ok && side->desyncs == 0;
+    }
 
-    // update
-    if (does_piece_fit(game->piece.shape, game->piece.x, game->piece.y + 1,
-                       game->piece.rotation)) {
-        game->y += dt * game->yspeed;
-        game->piece.y = game->y;
+    // once both know the outcome they have to agree on all of it
+    if (versus_finished(&sides[0]) && versus_finished(&sides[1])) {
+        ok = ok && sides[0].match.winner == sides[1].match.winner &&
+             match_hash(&sides[0].match) == match_hash(&sides[1].match);
+        int winner = sides[0].match.winner;
+        printf("match over after %d ticks, %s: %s\n", tick,
+               winner == VERSUS_PLAYERS ? "draw"
+               : winner == 0            ? "player 0 won"
+                                        : "player 1 won",
+               ok ? "ok" : "MISMATCH");
     } else {
-        // piece can't fit, so copy it onto the board
-        for (int px = 0; px < 4; px++) {
-            for (int py = 0; py < 4; py++) {
-                if (game->piece.shape[rotate(px, py, game->piece.rotation)] ==
-                    'x') {
-                    board[(game->piece.y + py) * BOARD_WIDTH +
-                          (game->piece.x + px)] = game->piece.color + 1;
-                }
-            }
-        }
+        printf("match still running after %d ticks: %s\n", tick,
+               ok ? "ok" : "MISMATCH");
+    }
 
-        // check if line is formed
-        for (int py = 0; py < 4; py++) {
-            if (game->piece.y + py >= BOARD_HEIGHT)
-                break;
-            bool line = true;
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+        versus_free(&sides[i]);
+    return ok ? 0 : 1;
+}
 
-            for (int px = 0; px < BOARD_WIDTH; px++) {
-                line &= board[(game->piece.y + py) * BOARD_WIDTH + px] != 0;
-            }
+// the images rasterized for a window size are kept with the other files
+// of the user, a size seen before loads without rasterizing anything
+void set_svg_cache() {
+    char *path = SDL_GetPrefPath("tetris", "cache");
+    if (path == NULL) {
+        fprintf(stderr, "WARNING: no cache directory, images are "
+                        "rasterized every time: %s\n",
+                SDL_GetError());
+        return;
+    }
+    svg_set_cache_dir(path);
+    SDL_free(path);
+}
 
-            if (line) {
-                for (int px = 0; px < BOARD_WIDTH; px++) {
-                    board[(game->piece.y + py) * BOARD_WIDTH + px] = 127;
-                }
+void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [--board WxH] [--clear-ms N] [--fps N] [--no-vsync]\n"
+            "          [--stats] [--seed N] [--record FILE] [--replay FILE]\n"
+            "          [--env NAME] [--envs N] [--bot] [--bot-headless N]\n"
+            "          [--bot-depth N] [--bot-threads N] [--bot-budget MS]\n"
+            "          [--bot-weights H,L,O,B] [--analyze N]\n"
+            "          [--analyze-depth N] [--das MS] [--arr MS]\n"
+            "          [--versus HOST:PORT] [--port N] [--link MS,MS,P]\n"
+            "          [--versus-test TICKS] [--renderer sdl|cpu|auto]\n"
+            "          [--export-fps N] [--export-segment S]\n"
+            "          [--export-threads N] [--export DIR REPLAY...]\n"
+            "          [--script FILE] [--practice] [--spectate N]\n"
+            "  --board WxH  board size, default %dx%d\n"
+            "  --clear-ms N how long completed lines flash before they\n"
+            "               collapse, default %d\n"
+            "  --fps N      frame cap, 0 disables it. defaults to %d when\n"
+            "               the renderer has no vsync\n"
+            "  --no-vsync   don't wait for vsync when presenting\n"
+            "  --stats      print frame rate, draw calls, wakeups, cpu time,\n"
+            "               input and sound latency every second\n"
+            "  --seed N     seed of the first game instead of a random one\n"
+            "  --record FILE\n"
+            "               save the replay of the last game to FILE\n"
+            "  --replay FILE\n"
+            "               play FILE back without a window and check that\n"
+            "               it ends the way it was recorded\n"
+            "  --env NAME   run a training environment without a window in\n"
+            "               the shared memory object NAME, see src/env.h\n"
+            "  --envs N     number of games in the environment, default %d\n"
+            "  --bot        let the computer play\n"
+            "  --bot-headless N\n"
+            "               let the computer play N pieces without a window\n"
+            "               and report its speed\n"
+            "  --bot-depth N\n"
+            "               pieces to look ahead, 1-%d, default %d. past the\n"
+            "               next piece it averages over every piece\n"
+            "  --bot-threads N\n"
+            "               search threads, default one per core\n"
+            "  --bot-budget MS\n"
+            "               time per decision, 0 for no limit, default a\n"
+            "               tick (%.1f)\n"
+            "  --bot-weights H,L,O,B\n"
+            "               weights of aggregate height, lines, holes and\n"
+            "               bumpiness\n"
+            "  --analyze N  place the first N pieces of the seed with every\n"
+            "               reachable placement in view and report how hard\n"
+            "               the sequence is\n"
+            "  --analyze-depth N\n"
+            "               pieces the analysis looks at at once, 1-%d,\n"
+            "               default %d\n"
+            "  --das MS     how long left or right is held before it\n"
+            "               repeats, default %d\n"
+            "  --arr MS     time between repeats, default %d\n"
+            "  --versus HOST:PORT\n"
+            "               play against the instance at HOST:PORT, both\n"
+            "               sides name each other\n"
+            "  --port N     local port of --versus, default %d\n"
+            "  --link MS,MS,P\n"
+            "               emulate a link with that delay, jitter and\n"
+            "               percentage of loss for what this side sends\n"
+            "  --versus-test TICKS\n"
+            "               let two bots play a match of up to TICKS ticks\n"
+            "               over the loopback link without a window and\n"
+            "               report the cost of the rollbacks\n"
+            "  --renderer sdl|cpu|auto\n"
+            "               draw with the SDL renderer or into a pixel\n"
+            "               buffer on the cpu. auto takes sdl on a GPU and\n"
+            "               times both otherwise, the default\n"
+            "  --export DIR REPLAY...\n"
+            "               render every REPLAY to DIR as a .y4m video\n"
+            "               without a window, as fast as the cores allow.\n"
+            "               takes the rest of the arguments\n"
+            "  --export-fps N\n"
+            "               frame rate of the videos, default %d\n"
+            "  --export-segment S\n"
+            "               cut games into videos of S seconds that render\n"
+            "               in parallel, 0 for one video per game, the\n"
+            "               default\n"
+            "  --export-threads N\n"
+            "               render threads, default one per core\n"
+            "  --script FILE\n"
+            "               feed the mouse moves, clicks and keys of FILE\n"
+            "               to the game as if they were typed, see\n"
+            "               bench/menu_walk.txt\n"
+            "  --practice   U or backspace takes the last piece back\n"
+            "  --spectate N watch N bot games at once, %d-%d. the --bot\n"
+            "               options set up their bots\n"
+#ifdef PROFILE
+            "  --trace FILE where to write the Chrome trace, default %s\n"
+#endif
+            ,
+            program, BOARD_WIDTH, BOARD_HEIGHT,
+            LINE_CLEAR_TICKS * 1000 / TICK_RATE, DEFAULT_FPS, DEFAULT_ENVS,
+            BOT_MAX_DEPTH, BOT_DEFAULT_DEPTH, BOT_DEFAULT_BUDGET_MS,
+            ANALYZE_MAX_DEPTH, ANALYZE_DEFAULT_DEPTH, DEFAULT_DAS_MS,
+            DEFAULT_ARR_MS, VERSUS_DEFAULT_PORT, EXPORT_DEFAULT_FPS,
+            SPECTATE_MIN_GAMES, SPECTATE_MAX_GAMES
+#ifdef PROFILE
+            ,
+            DEFAULT_TRACE_PATH
+#endif
+    );
+    exit(1);
+}
 
-                lines[line_ptr++] = game->piece.y + py;
+int main(int argc, char **argv) {
+    int board_width = BOARD_WIDTH;
+    int board_height = BOARD_HEIGHT;
+    int clear_ticks = LINE_CLEAR_TICKS;
+    int fps = -1;
+    bool vsync = true;
+    bool stats = false;
+    bool seeded = false;
+    uint32_t seed = 0;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *env_name = NULL;
+    int env_count = DEFAULT_ENVS;
+    bool bot_enabled = false;
+    int bot_pieces = 0;
+    int bot_depth = BOT_DEFAULT_DEPTH;
+    int bot_threads = 0;
+    float bot_budget = BOT_DEFAULT_BUDGET_MS;
+    BotWeights bot_weights = BOT_DEFAULT_WEIGHTS;
+    int analyze_pieces = 0;
+    int analyze_depth = ANALYZE_DEFAULT_DEPTH;
+    int das_ms = DEFAULT_DAS_MS;
+    int arr_ms = DEFAULT_ARR_MS;
+    char versus_host[256] = "";
+    int versus_port = 0;
+    int local_port = VERSUS_DEFAULT_PORT;
+    LinkConditions link = {0};
+    int versus_ticks = 0;
+    int backend = RENDERER_AUTO;
+    ExportOptions export_options = {.fps = EXPORT_DEFAULT_FPS};
+    const char *const *export_paths = NULL;
+    int export_count = 0;
+    const char *script_path = NULL;
+    bool practice = false;
+    int spectate_count = 0;
+#ifdef PROFILE
+    const char *trace_path = DEFAULT_TRACE_PATH;
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &board_width, &board_height) !=
+                    2 ||
+                !board_size_valid(board_width, board_height)) {
+                fprintf(stderr,
+                        "ERROR: invalid board size %s, expected WxH with "
+                        "4 <= W <= %d and 4 <= H <= %d\n",
+                        argv[i], BOARD_MAX_WIDTH, BOARD_MAX_HEIGHT);
+                exit(1);
             }
+        } else if (strcmp(argv[i], "--clear-ms") == 0 && i + 1 < argc) {
+            int ms = atoi(argv[++i]);
+            if (ms < 0 || ms > 60000)
+                usage(argv[0]);
+            // rounded up so any non zero duration shows for a tick
+            clear_ticks = (ms * TICK_RATE + 999) / 1000;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            fps = atoi(argv[++i]);
+            if (fps < 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--no-vsync") == 0) {
+            vsync = false;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 0);
+            seeded = true;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--env") == 0 && i + 1 < argc) {
+            env_name = argv[++i];
+        } else if (strcmp(argv[i], "--envs") == 0 && i + 1 < argc) {
+            env_count = atoi(argv[++i]);
+            if (env_count <= 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--bot") == 0) {
+            bot_enabled = true;
+        } else if (strcmp(argv[i], "--bot-headless") == 0 && i + 1 < argc) {
+            bot_pieces = atoi(argv[++i]);
+            if (bot_pieces <= 0)
+                usage(argv[0]);
+            bot_enabled = true;
+        } else if (strcmp(argv[i], "--bot-depth") == 0 && i + 1 < argc) {
+            bot_depth = atoi(argv[++i]);
+            if (bot_depth < 1 || bot_depth > BOT_MAX_DEPTH)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--bot-threads") == 0 && i + 1 < argc) {
+            bot_threads = atoi(argv[++i]);
+            if (bot_threads <= 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--bot-budget") == 0 && i + 1 < argc) {
+            bot_budget = atof(argv[++i]);
+            if (bot_budget < 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--bot-weights") == 0 && i + 1 < argc) {
+            BotWeights *w = &bot_weights;
+            if (sscanf(argv[++i], "%f,%f,%f,%f", &w->height, &w->lines,
+                       &w->holes, &w->bumpiness) != 4)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--analyze") == 0 && i + 1 < argc) {
+            analyze_pieces = atoi(argv[++i]);
+            if (analyze_pieces <= 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--analyze-depth") == 0 && i + 1 < argc) {
+            analyze_depth = atoi(argv[++i]);
+            if (analyze_depth < 1 || analyze_depth > ANALYZE_MAX_DEPTH)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--das") == 0 && i + 1 < argc) {
+            das_ms = atoi(argv[++i]);
+            if (das_ms < 0 || das_ms > 60000)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--arr") == 0 && i + 1 < argc) {
+            arr_ms = atoi(argv[++i]);
+            if (arr_ms < 0 || arr_ms > 60000)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--versus") == 0 && i + 1 < argc) {
+            const char *colon = strrchr(argv[++i], ':');
+            int length = colon != NULL ? colon - argv[i] : 0;
+            if (length <= 0 || length >= (int)sizeof(versus_host))
+                usage(argv[0]);
+            memcpy(versus_host, argv[i], length);
+            versus_host[length] = '\0';
+            versus_port = atoi(colon + 1);
+            if (versus_port <= 0 || versus_port > 65535)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            local_port = atoi(argv[++i]);
+            if (local_port <= 0 || local_port > 65534)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--link") == 0 && i + 1 < argc) {
+            float loss;
+            if (sscanf(argv[++i], "%d,%d,%f", &link.delay_ms,
+                       &link.jitter_ms, &loss) != 3 ||
+                link.delay_ms < 0 || link.jitter_ms < 0 || loss < 0 ||
+                loss > 100)
+                usage(argv[0]);
+            link.loss = loss / 100;
+        } else if (strcmp(argv[i], "--versus-test") == 0 && i + 1 < argc) {
+            versus_ticks = atoi(argv[++i]);
+            if (versus_ticks <= 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "sdl") == 0)
+                backend = RENDERER_SDL;
+            else if (strcmp(argv[i], "cpu") == 0)
+                backend = RENDERER_CPU;
+            else if (strcmp(argv[i], "auto") == 0)
+                backend = RENDERER_AUTO;
+            else
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--export-fps") == 0 && i + 1 < argc) {
+            export_options.fps = atoi(argv[++i]);
+            if (export_options.fps <= 0 || export_options.fps > 1000)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--export-segment") == 0 &&
+                   i + 1 < argc) {
+            export_options.segment_seconds = atoi(argv[++i]);
+            if (export_options.segment_seconds < 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--export-threads") == 0 &&
+                   i + 1 < argc) {
+            export_options.threads = atoi(argv[++i]);
+            if (export_options.threads <= 0)
+                usage(argv[0]);
+        } else if (strcmp(argv[i], "--export") == 0 && i + 2 < argc) {
+            export_options.directory = argv[++i];
+            export_paths = (const char *const *)argv + i + 1;
+            export_count = argc - i - 1;
+            break;
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            script_path = argv[++i];
+        } else if (strcmp(argv[i], "--practice") == 0) {
+            practice = true;
+        } else if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc) {
+            spectate_count = atoi(argv[++i]);
+            if (spectate_count < SPECTATE_MIN_GAMES ||
+                spectate_count > SPECTATE_MAX_GAMES)
+                usage(argv[0]);
+#ifdef PROFILE
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+#endif
+        } else {
+            usage(argv[0]);
         }
+    }
 
-        int shape = rand() % 7;
-        game->piece = game->next_piece;
-        game->next_piece.shape = tetriminos[shape];
-        game->y = 0;
-        game->next_piece.y = 0;
-        game->next_piece.color = shape;
-        game->next_piece.x = BOARD_WIDTH / 2;
-        game->next_piece.rotation = 0;
-
-        game->over = !does_piece_fit(game->piece.shape, game->piece.x,
-                                     game->piece.y, game->piece.rotation);
+    if (replay_path != NULL)
+        return play_replay(replay_path);
 
-        if (game->over) {
-            return SCREEN_PLAY;
+    set_svg_cache();
+    if (export_count > 0) {
+        if (TTF_Init() < 0) {
+            fprintf(stderr, "ERROR: failed to initialize SDL: %s\n",
+                    SDL_GetError());
+            exit(1);
         }
+        bool ok = export_videos(export_paths, export_count, &export_options);
+        TTF_Quit();
+        return ok ? 0 : 1;
     }
 
-    // draw board
-    for (int x = 0; x < BOARD_WIDTH; x++) {
-        for (int y = 0; y < BOARD_HEIGHT; y++) {
-            int val = board[y * BOARD_WIDTH + x];
-            if (val == 0) {
-                SDL_SetRenderDrawColor(game->renderer, 28, 28, 28, 255);
-                SDL_RenderFillRect(
-                    game->renderer,
-                    &(SDL_Rect){game->board_xoff + x * PIECE_WIDTH,
-                                game->board_yoff + y * PIECE_HEIGHT,
-                                PIECE_WIDTH, PIECE_HEIGHT});
-            } else if (val == 127) {
-                SDL_SetRenderDrawColor(game->renderer, 255, 255, 255, 255);
-                SDL_RenderFillRect(
-                    game->renderer,
-                    &(SDL_Rect){game->board_xoff + x * PIECE_WIDTH,
-                                game->board_yoff + y * PIECE_HEIGHT,
-                                PIECE_WIDTH, PIECE_HEIGHT});
-            } else {
-                SDL_RenderCopy(
-                    game->renderer, game->pieces_texture,
-                    &(SDL_Rect){(val - 1) * 30, 0, 30, 30},
-                    &(SDL_Rect){
-                        game->board_xoff + x * PIECE_WIDTH + PIECE_PADDING,
-                        game->board_yoff + y * PIECE_HEIGHT + PIECE_PADDING,
-                        PIECE_WIDTH - 2 * PIECE_PADDING,
-                        PIECE_HEIGHT - 2 * PIECE_PADDING});
-            }
+    srand(time(NULL));
+    if (!seeded)
+        seed = rand();
+
+    if (analyze_pieces > 0) {
+        if (!analyze_sequence(board_width, board_height, seed, analyze_pieces,
+                              analyze_depth)) {
+            fprintf(stderr, "ERROR: failed to set up the analysis: %s\n",
+                    strerror(errno));
+            exit(1);
         }
+        return 0;
     }
 
-    // draw current piece
-    for (int px = 0; px < 4; px++) {
-        for (int py = 0; py < 4; py++) {
-            int idx = rotate(px, py, game->piece.rotation);
-            if (game->piece.shape[idx] == 'x') {
-                SDL_RenderCopy(
-                    game->renderer, game->pieces_texture,
-                    &(SDL_Rect){game->piece.color * 30, 0, 30, 30},
-                    &(SDL_Rect){
-                        game->board_xoff + (game->piece.x + px) * PIECE_WIDTH +
-                            PIECE_PADDING,
-                        game->board_yoff + (game->piece.y + py) * PIECE_HEIGHT,
-                        PIECE_WIDTH - 2 * PIECE_PADDING,
-                        PIECE_HEIGHT - 2 * PIECE_PADDING});
-            }
+    if (env_name != NULL) {
+        printf("environment %s: %d games on %dx%d boards\n", env_name,
+               env_count, board_width, board_height);
+        fflush(stdout);
+        if (!env_run(env_name, env_count, board_width, board_height, seed)) {
+            fprintf(stderr, "ERROR: failed to set up environment %s: %s\n",
+                    env_name, strerror(errno));
+            exit(1);
         }
+        return 0;
     }
 
-    // animate line completion
-    if (line_ptr > 0) {
-        SDL_RenderPresent(game->renderer);
-        SDL_Delay(100);
-        for (int i = 0; i < line_ptr; i++) {
-            for (int px = 0; px < BOARD_WIDTH; px++) {
-                for (int py = lines[i]; py > 0; py--)
-                    board[py * BOARD_WIDTH + px] =
-                        board[(py - 1) * BOARD_WIDTH + px];
-                board[px] = 0;
+    if (versus_ticks > 0) {
+        Bot bots[VERSUS_PLAYERS];
+        for (int i = 0; i < VERSUS_PLAYERS; i++) {
+            // both share the one thread of the test. the same bot would
+            // mirror the other one move for move, so the second one looks
+            // a piece less ahead
+            int depth = i == 0 ? bot_depth : SDL_max(1, bot_depth - 1);
+            if (!bot_init(&bots[i], board_width, board_height, depth, 1)) {
+                fprintf(stderr, "ERROR: failed to set up the bot: %s\n",
+                        SDL_GetError());
+                exit(1);
             }
-            game->score += 100;
+            bots[i].weights = bot_weights;
+            bots[i].budget_ms = bot_budget;
         }
-        line_ptr = 0;
-        get_delta();
-    }
-
-    // draw score and next piece
-
-    int xoff = game->board_xoff + PIECE_WIDTH * BOARD_WIDTH;
-    int section_width = WINDOW_WIDTH - xoff;
-    int next_piece_padding = 10;
-
-    // make sure we have enough space to draw the next piece
-    if (section_width > 4 * PIECE_WIDTH + 2 * next_piece_padding) {
-
-        int w = 4 * PIECE_WIDTH + 2 * next_piece_padding;
-        int x = xoff + (section_width - w) / 2;
-        int y = 50;
-
-        // draw next piece
-        SDL_SetRenderDrawColor(game->renderer, 255, 255, 255, 255);
-        SDL_RenderFillRect(game->renderer,
-                           &(SDL_Rect){x, y, w + next_piece_padding, 2});
-
-        SDL_RenderFillRect(game->renderer,
-                           &(SDL_Rect){x, y, 2, w + next_piece_padding});
-
-        SDL_RenderFillRect(game->renderer,
-                           &(SDL_Rect){x + next_piece_padding + w, y, 2,
-                                       w + next_piece_padding});
-
-        SDL_RenderFillRect(game->renderer,
-                           &(SDL_Rect){x, y + next_piece_padding + w,
-                                       w + next_piece_padding, 2});
-        for (int px = 0; px < 4; px++) {
-            for (int py = 0; py < 4; py++) {
-                int idx = rotate(px, py, game->next_piece.rotation);
-                if (game->next_piece.shape[idx] == 'x') {
-                    SDL_RenderCopy(
-                        game->renderer, game->pieces_texture,
-                        &(SDL_Rect){game->next_piece.color * 30, 0, 30, 30},
-                        &(SDL_Rect){x + next_piece_padding + px * PIECE_WIDTH +
-                                        PIECE_PADDING,
-                                    y + next_piece_padding + py * PIECE_HEIGHT,
-                                    PIECE_WIDTH - 2 * PIECE_PADDING,
-                                    PIECE_HEIGHT - 2 * PIECE_PADDING});
-                }
-            }
-        }
-
-        // draw score
+        int status =
+            play_versus_test(bots, board_width, board_height, clear_ticks,
+                             seed, versus_ticks, local_port, link);
+        for (int i = 0; i < VERSUS_PLAYERS; i++)
+            bot_free(&bots[i]);
+        return status;
     }
 
-    SDL_RenderPresent(game->renderer);
-    return SCREEN_PLAY;
-}
-
-int game_over_screen(Game *game) {
-    static int y = 0;
-    static double counter = 0;
-    static char score[100];
-
-    int back_h = 80;
-    int back_w = 150;
-    int back_x = WINDOW_WIDTH / 2 - back_w / 2;
-    int back_y = WINDOW_HEIGHT / 2 + 150 - back_h / 2;
-    bool clicked = false;
-
-    SDL_Event event;
-    if (SDL_PollEvent(&event)) {
-        if (event.type == SDL_QUIT) {
-            return SCREEN_EXIT;
+    Bot bot;
+    if (bot_enabled) {
+        if (!bot_init(&bot, board_width, board_height, bot_depth,
+                      bot_threads)) {
+            fprintf(stderr, "ERROR: failed to set up the bot: %s\n",
+                    SDL_GetError());
+            exit(1);
         }
-
-        if (event.type == SDL_MOUSEBUTTONUP) {
-            clicked = true;
+        bot.weights = bot_weights;
+        bot.budget_ms = bot_budget;
+
+        if (bot_pieces > 0) {
+            int status = play_bot(&bot, board_width, board_height,
+                                  clear_ticks, seed, bot_pieces);
+            bot_free(&bot);
+            return status;
         }
     }
 
-    int mx, my;
-    SDL_GetMouseState(&mx, &my);
-
-    if (mx >= back_x && mx <= back_x + back_w && my >= back_y &&
-        my <= back_y + back_w) {
-        back_w = 200;
-        back_x = WINDOW_WIDTH / 2 - back_w / 2;
-        if (clicked)
-            return SCREEN_HOME;
+    SpectateLayout layout;
+    if (spectate_count > 0 &&
+        !spectate_layout(spectate_count, board_width, board_height,
+                         WINDOW_WIDTH, WINDOW_HEIGHT, &layout)) {
+        fprintf(stderr, "ERROR: %d boards of %dx%d don't fit the window\n",
+                spectate_count, board_width, board_height);
+        exit(1);
     }
 
-    float dt = get_delta();
-    counter = (counter + 5 * dt);
-    if (counter > INT_MAX)
-        counter = 0;
-    y = 10 * sin(counter);
-
-    SDL_SetRenderDrawColor(game->renderer, 51, 51, 51, 255);
-    SDL_RenderClear(game->renderer);
-
-    TTF_SetFontSize(game->font, 80);
-    SDL_Surface *surface = TTF_RenderText_Solid(
-        game->font, "Game Over", (SDL_Color){255, 255, 255, 255});
-    SDL_Texture *texture =
-        SDL_CreateTextureFromSurface(game->renderer, surface);
-
-    SDL_RenderCopy(game->renderer, texture, NULL,
-                   &(SDL_Rect){WINDOW_WIDTH / 2 - 150,
-                               WINDOW_HEIGHT / 2 - 75 - 100 + y, 300, 150});
-
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
-
-    sprintf(score, "Score: %d", game->score);
-
-    TTF_SetFontSize(game->font, 50);
-    surface = TTF_RenderText_Solid(game->font, score,
-                                   (SDL_Color){255, 255, 255, 255});
-    texture = SDL_CreateTextureFromSurface(game->renderer, surface);
-
-    SDL_RenderCopy(game->renderer, texture, NULL,
-                   &(SDL_Rect){WINDOW_WIDTH / 2 - 75,
-                               WINDOW_HEIGHT / 2 + 50 - 40, 150, 80});
-
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
-
-    TTF_SetFontSize(game->font, 50);
-    surface = TTF_RenderText_Solid(game->font, "Go Back",
-                                   (SDL_Color){255, 255, 255, 255});
-    texture = SDL_CreateTextureFromSurface(game->renderer, surface);
-
-    SDL_RenderCopy(game->renderer, texture, NULL,
-                   &(SDL_Rect){back_x, back_y, back_w, back_h});
-
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
-
-    SDL_RenderPresent(game->renderer);
-
-    return SCREEN_GAME_OVER;
-}
-
-int main() {
-    srand(time(NULL));
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_AUDIO) < 0) {
         fprintf(stderr, "ERROR: failed to initialize SDL: %s\n",
                 SDL_GetError());
         exit(1);
     }
 
-    if (IMG_Init(IMG_INIT_PNG) == 0) {
-        fprintf(stderr, "ERROR: failed to initialize SDL Image: %s\n",
-                SDL_GetError());
-        exit(1);
-    }
-
     if (TTF_Init() < 0) {
         fprintf(stderr, "ERROR: failed to initialize ttf library: %s\n",
                 SDL_GetError());
         exit(1);
     }
 
-    SDL_Window *window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_CENTERED,
-                                          SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH,
-                                          WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
+    // the layout follows the window, at half the size it stops being
+    // readable
+    SDL_Window *window = SDL_CreateWindow(
+        "Tetris", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        WINDOW_WIDTH, WINDOW_HEIGHT,
+        SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
     if (window == NULL) {
         fprintf(stderr, "ERROR: failed to create window: %s\n", SDL_GetError());
         exit(1);
     }
+    SDL_SetWindowMinimumSize(window, WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
+
+    Uint32 renderer_flags =
+        SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE;
+    if (vsync)
+        renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
 
-    SDL_Renderer *renderer =
-        SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, renderer_flags);
+    if (renderer == NULL) {
+        // machines without a GPU still get a window
+        fprintf(stderr,
+                "WARNING: no accelerated renderer, using the software one: "
+                "%s\n",
+                SDL_GetError());
+        renderer_flags &= ~SDL_RENDERER_ACCELERATED;
+        renderer = SDL_CreateRenderer(window, -1,
+                                      renderer_flags | SDL_RENDERER_SOFTWARE);
+    }
     if (renderer == NULL) {
         fprintf(stderr, "ERROR: failed to create renderer: %s\n",
                 SDL_GetError());
         exit(1);
     }
-
-    board = calloc(BOARD_HEIGHT * BOARD_WIDTH, sizeof(unsigned char));
-    if (board == NULL) {
-        fprintf(stderr, "ERROR: failed to initialize board: %s\n",
-                strerror(errno));
-        exit(1);
+    SDL_RendererInfo renderer_info;
+    bool accelerated = SDL_GetRendererInfo(renderer, &renderer_info) == 0 &&
+                       (renderer_info.flags & SDL_RENDERER_ACCELERATED);
+
+    // vsync paces the loop on its own, otherwise cap the frame rate so we
+    // don't spin a core at 100%
+    if (fps < 0) {
+        bool has_vsync = SDL_GetRendererInfo(renderer, &renderer_info) == 0 &&
+                         (renderer_info.flags & SDL_RENDERER_PRESENTVSYNC);
+        fps = has_vsync ? 0 : DEFAULT_FPS;
     }
 
-    if (Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 512) < 0) {
+    if (Mix_OpenAudio(AUDIO_FREQUENCY, AUDIO_S16SYS, 2, AUDIO_BUFFER) < 0) {
         fprintf(stderr, "ERROR: failed to open audio stream: %s\n",
                 SDL_GetError());
         exit(1);
     }
 
-    if (Mix_AllocateChannels(4) < 0) {
+    if (Mix_AllocateChannels(SFX_VOICES) < 0) {
         fprintf(stderr, "ERROR: failed to allocate channels: %s\n",
                 SDL_GetError());
         exit(1);
@@ -547,59 +851,114 @@ int main() {
 
     Mix_VolumeMusic(10);
 
-    SDL_Surface *color_pieces_surface = IMG_Load("./assets/img/pallete.png");
-    SDL_Texture *color_pieces_texture =
-        SDL_CreateTextureFromSurface(renderer, color_pieces_surface);
-
-    SDL_Surface *play_btn_surface = IMG_Load("./assets/img/play_btn.png");
-    SDL_Texture *play_btn_texture =
-        SDL_CreateTextureFromSurface(renderer, play_btn_surface);
-    SDL_FreeSurface(play_btn_surface);
-
-    int p1 = rand() % 7;
-    int p2 = rand() % 7;
-
-    Game game = {.piece = {.shape = tetriminos[1],
-                           .color = p1,
-                           .x = BOARD_WIDTH / 2,
-                           .y = 0},
-                 .next_piece = {.shape = tetriminos[2],
-                                .color = p2,
-                                .x = BOARD_WIDTH / 2,
-                                .y = 0},
-                 .board_xoff = (WINDOW_WIDTH - BOARD_WIDTH * PIECE_WIDTH) / 2,
-                 .board_yoff =
-                     (WINDOW_HEIGHT - BOARD_HEIGHT * PIECE_HEIGHT) / 2,
-                 .over = false,
-                 .pieces_texture = color_pieces_texture,
-                 .play_btn_texture = play_btn_texture,
-                 .renderer = renderer,
-                 .window = window,
-                 .y = 0,
-                 .yspeed = 3,
-                 .score = 0};
-
-    game.bg_music = Mix_LoadMUS("./assets/music/bg.mp3");
-
-    Mix_FadeInMusic(game.bg_music, -1, 100);
-
-    // load font
-    game.font = TTF_OpenFont("./assets/font/SuperFunky.ttf", 80);
-    if (game.font == NULL) {
-        fprintf(stderr, "ERROR: failed to load font: %s\n", SDL_GetError());
+    Game game;
+    game_init(&game, window, renderer, board_width, board_height,
+              clear_ticks, seed);
+    game.record_path = record_path;
+    sfx_init(&game.sfx, AUDIO_BUFFER);
+    input_init(&game.controls, das_ms, arr_ms);
+
+    // the raster wins over the software renderer of SDL when it isn't
+    // slowed down by the window upload, which only timing it can tell
+    if (backend == RENDERER_AUTO && !accelerated) {
+        float sdl_ms = time_frames(&game, seed);
+        float cpu_ms = -1;
+        if (game_use_raster(&game, true))
+            cpu_ms = time_frames(&game, seed);
+        backend = cpu_ms >= 0 && cpu_ms < sdl_ms ? RENDERER_CPU : RENDERER_SDL;
+        printf("renderer: sdl %.2fms, cpu %.2fms per frame, using %s\n",
+               sdl_ms, cpu_ms, backend == RENDERER_CPU ? "cpu" : "sdl");
+    }
+    if (!game_use_raster(&game, backend == RENDERER_CPU)) {
+        fprintf(stderr, "ERROR: failed to set up the cpu renderer: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+
+    if (practice && !game_enable_practice(&game)) {
+        fprintf(stderr, "ERROR: failed to set up practice mode: %s\n",
+                strerror(errno));
         exit(1);
     }
 
-    int screen = SCREEN_HOME;
-    int prev_screen = SCREEN_HOME;
+    if (bot_enabled)
+        game.bot = &bot;
+    Spectator spectator;
+    if (spectate_count > 0) {
+        if (!spectator_init(&spectator, spectate_count, board_width,
+                            board_height, clear_ticks, seed, bot_depth,
+                            bot_budget, &bot_weights, bot_threads)) {
+            fprintf(stderr, "ERROR: failed to set up the spectator: %s\n",
+                    SDL_GetError());
+            exit(1);
+        }
+        game_spectate(&game, &spectator);
+    }
+    Versus versus;
+    if (versus_port > 0) {
+        if (!versus_init(&versus, board_width, board_height, clear_ticks,
+                         seed, local_port, versus_host, versus_port, link)) {
+            fprintf(stderr, "ERROR: failed to connect port %d to %s:%d: %s\n",
+                    local_port, versus_host, versus_port, strerror(errno));
+            exit(1);
+        }
+        game.versus = &versus;
+    }
+
+    MusicLoader music_loader = {.game = &game};
+    SDL_Thread *music_thread =
+        SDL_CreateThread(load_music, "music loader", &music_loader);
+    if (music_thread == NULL) {
+        fprintf(stderr, "WARNING: failed to create music thread: %s\n",
+                SDL_GetError());
+    }
+
+    Script script = {0};
+    if (script_path != NULL)
+        load_script(&script, script_path);
+
+    PROFILE_INIT(trace_path);
+
+    // the spectator has no menus, it starts watching right away
+    int screen = game.spectator != NULL ? SCREEN_PLAY : SCREEN_HOME;
+    int prev_screen = screen;
+
+    Uint64 frame_length =
+        fps > 0 ? SDL_GetPerformanceFrequency() / fps : 0;
+    Uint64 frame_start = SDL_GetPerformanceCounter();
+    Uint64 stats_start = frame_start;
+    // every pass of the loop is a wakeup, not all of them present a frame
+    int stats_wakeups = 0;
+    uint32_t stats_presented = game.presented;
+    double stats_cpu_ms = process_cpu_ms();
+    int stats_ticks = 0;
+    int stats_pieces = 0;
+    script.start = SDL_GetTicks();
 
     while (true) {
+        PROFILE_BEGIN(ZONE_FRAME);
+        script_run(&script);
+        // start the music as soon as it is ready
+        if (music_thread != NULL && SDL_AtomicGet(&music_loader.done)) {
+            SDL_WaitThread(music_thread, NULL);
+            music_thread = NULL;
+            if (game.bg_music != NULL)
+                Mix_FadeInMusic(game.bg_music, -1, 100);
+        }
+
         switch (screen) {
         case SCREEN_HOME:
             screen = home_screen(&game);
             break;
         case SCREEN_PLAY:
-            screen = play_screen(&game);
+            if (game.spectator != NULL)
+                screen = spectate_screen(&game);
+            else if (game.versus != NULL)
+                screen = versus_screen(&game);
+            else if (game.bot != NULL)
+                screen = autoplay_screen(&game);
+            else
+                screen = play_screen(&game);
             break;
         case SCREEN_GAME_OVER:
             screen = game_over_screen(&game);
@@ -607,6 +966,10 @@ int main() {
         }
 
         if (screen == SCREEN_EXIT) {
+            // keep what was played so far
+            if (prev_screen == SCREEN_PLAY && game.versus == NULL &&
+                game.spectator == NULL)
+                save_replay(&game);
             break;
         }
 
@@ -620,26 +983,108 @@ int main() {
 
         if (prev_screen == SCREEN_GAME_OVER && screen == SCREEN_HOME) {
             // reset game state
-            game.over = false;
-            game.piece = (Piece){.shape = tetriminos[1],
-                                 .color = p1,
-                                 .x = BOARD_WIDTH / 2,
-                                 .y = 0};
-            game.next_piece = (Piece){.shape = tetriminos[2],
-                                      .color = p2,
-                                      .x = BOARD_WIDTH / 2,
-                                      .y = 0};
-            game.y = 0;
-            game.yspeed = 3;
-            game.score = 0;
-            memset(board, 0,
-                   BOARD_WIDTH * BOARD_HEIGHT * sizeof(unsigned char));
+            new_game(&game, rand());
         }
 
         prev_screen = screen;
+
+        if (stats) {
+            stats_wakeups++;
+            Uint64 now = SDL_GetPerformanceCounter();
+            if (now - stats_start >= SDL_GetPerformanceFrequency()) {
+                double seconds = (double)(now - stats_start) /
+                                 SDL_GetPerformanceFrequency();
+                int frames = game.presented - stats_presented;
+                int draw_calls = game.sprites.draw_calls +
+                                 game.text.draw_calls + game.raster.draw_calls;
+                printf("fps: %d, draw calls per frame: %.1f\n", frames,
+                       frames > 0 ? (float)draw_calls / frames : 0.0f);
+                double cpu_ms = process_cpu_ms();
+                printf("power: %.0f wakeups/s, cpu %.0fms/s (%.1f%% of a "
+                       "core)\n",
+                       stats_wakeups / seconds,
+                       (cpu_ms - stats_cpu_ms) / seconds,
+                       (cpu_ms - stats_cpu_ms) / seconds / 10);
+                float p50, p99, max;
+                if (input_latency(&game.controls, &p50, &p99, &max)) {
+                    printf("input: %u presses, %u simulated, %u dropped, "
+                           "press to present p50 %.0fms, p99 %.0fms, max "
+                           "%.0fms\n",
+                           game.controls.presses, game.controls.applied,
+                           game.controls.dropped, p50, p99, max);
+                }
+                if (sfx_latency(&game.sfx, &p50, &max)) {
+                    printf("sfx: %u played, %u stolen, %u skipped, trigger "
+                           "to output p50 %.1fms, max %.1fms\n",
+                           game.sfx.played, game.sfx.stolen,
+                           game.sfx.skipped, p50, max);
+                }
+                float max_tick;
+                if (game.versus != NULL &&
+                    versus_tick_times(&versus, &p50, &p99, &max_tick)) {
+                    printf("versus: tick %u, %u rollbacks, %u ticks "
+                           "resimulated, max %u, tick p99 %.3fms, max "
+                           "%.3fms, %u stalls, %u/%u packets lost\n",
+                           versus.match.tick, versus.rollbacks,
+                           versus.resimulated, versus.max_rollback, p99,
+                           max_tick, versus.stalls, versus.net.lost,
+                           versus.net.sent);
+                }
+                if (game.bot != NULL && bot.decisions > 0) {
+                    printf("bot: depth %d, %.3fms per decision, %.0f "
+                           "nodes/s\n",
+                           bot.last_depth, bot.total_ms / bot.decisions,
+                           bot_nodes_per_second(&bot));
+                }
+                if (game.spectator != NULL) {
+                    int ticks = SDL_AtomicGet(&spectator.ticks);
+                    int pieces = SDL_AtomicGet(&spectator.pieces);
+                    printf("spectate: %d games, %.0f ticks/s, %.0f pieces/s, "
+                           "%d ticks dropped, %d frames skipped\n",
+                           spectator.count, (ticks - stats_ticks) / seconds,
+                           (pieces - stats_pieces) / seconds,
+                           SDL_AtomicGet(&spectator.dropped_ticks),
+                           SDL_AtomicGet(&spectator.skipped_frames));
+                    stats_ticks = ticks;
+                    stats_pieces = pieces;
+                }
+                fflush(stdout);
+                game.sprites.draw_calls = 0;
+                game.text.draw_calls = 0;
+                game.raster.draw_calls = 0;
+                stats_wakeups = 0;
+                stats_presented = game.presented;
+                stats_cpu_ms = cpu_ms;
+                stats_start = now;
+            }
+        }
+
+        PROFILE_END(ZONE_FRAME);
+        PROFILE_FRAME_END();
+
+        // sleep off whatever is left of the frame
+        if (frame_length > 0) {
+            Uint64 elapsed = SDL_GetPerformanceCounter() - frame_start;
+            if (elapsed < frame_length) {
+                SDL_Delay((frame_length - elapsed) * 1000 /
+                          SDL_GetPerformanceFrequency());
+            }
+        }
+        frame_start = SDL_GetPerformanceCounter();
     }
-    TTF_CloseFont(game.font);
-    SDL_DestroyTexture(color_pieces_texture);
+    PROFILE_SHUTDOWN();
+    free(script.events);
+    if (music_thread != NULL)
+        SDL_WaitThread(music_thread, NULL);
+    Mix_FreeMusic(game.bg_music);
+    sfx_free(&game.sfx);
+    if (game.spectator != NULL)
+        spectator_free(&spectator);
+    if (game.versus != NULL)
+        versus_free(&versus);
+    game_free(&game);
+    if (bot_enabled)
+        bot_free(&bot);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,323 @@
+#include "movegen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the inputs the search tries, one per step
+static const uint8_t moves[] = {INPUT_LEFT, INPUT_RIGHT, INPUT_ROTATE,
+                                INPUT_SOFT_DROP};
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15u);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+static int state_index(const MoveGen *gen, int x, int y, int rotation) {
+    return (rotation * gen->height + y) * (gen->width + 3) + x + 3;
+}
+
+bool movegen_init(MoveGen *gen, int width, int height, uint64_t seed) {
+    memset(gen, 0, sizeof(*gen));
+    gen->width = width;
+    gen->height = height;
+
+    size_t states = (size_t)4 * height * (width + 3);
+    gen->cell_keys = malloc((size_t)width * height * sizeof(uint64_t));
+    gen->visited = calloc(states, sizeof(uint32_t));
+    gen->placed = calloc(states, sizeof(uint32_t));
+    gen->tested = calloc(states, sizeof(uint32_t));
+    gen->fits = malloc(states);
+    gen->queue = malloc(states * sizeof(int));
+    gen->parent = malloc(states * sizeof(int));
+    gen->move = malloc(states);
+    if (gen->cell_keys == NULL || gen->visited == NULL ||
+        gen->placed == NULL || gen->tested == NULL || gen->fits == NULL ||
+        gen->queue == NULL || gen->parent == NULL || gen->move == NULL) {
+        movegen_free(gen);
+        return false;
+    }
+
+    for (int i = 0; i < width * height; i++)
+        gen->cell_keys[i] = splitmix64(&seed);
+    for (int i = 0; i < PIECE_COUNT; i++)
+        gen->piece_keys[i] = splitmix64(&seed);
+    return true;
+}
+
+void movegen_free(MoveGen *gen) {
+    free(gen->cell_keys);
+    free(gen->visited);
+    free(gen->placed);
+    free(gen->tested);
+    free(gen->fits);
+    free(gen->queue);
+    free(gen->parent);
+    free(gen->move);
+    memset(gen, 0, sizeof(*gen));
+}
+
+static uint64_t row_key(const MoveGen *gen, const Board *board, int y) {
+    uint64_t key = 0;
+    for (uint64_t bits = board->rows[y]; bits != 0; bits &= bits - 1)
+        key ^= gen->cell_keys[y * gen->width + __builtin_ctzll(bits)];
+    return key;
+}
+
+uint64_t movegen_board_key(const MoveGen *gen, const Board *board) {
+    uint64_t key = 0;
+    for (int y = 0; y < board->height; y++)
+        key ^= row_key(gen, board, y);
+    return key;
+}
+
+static bool reserve(void **items, int *capacity, int needed, size_t size) {
+    if (needed <= *capacity)
+        return true;
+
+    int new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    void *new_items = realloc(*items, new_capacity * size);
+    if (new_items == NULL)
+        return false;
+    *items = new_items;
+    *capacity = new_capacity;
+    return true;
+}
+
+// rotations with the same shape as a lower one end up on the same cells
+static int canonical_rotation(int type, int rotation) {
+    for (int r = 0; r < rotation; r++) {
+        if (memcmp(piece_masks[type][r], piece_masks[type][rotation], 4) == 0)
+            return r;
+    }
+    return rotation;
+}
+
+static bool fits(MoveGen *gen, const Board *board, int type, int x, int y,
+                 int rotation) {
+    // no piece reaches past these whatever its shape
+    if (x < -3 || x >= gen->width || y >= gen->height)
+        return false;
+
+    int s = state_index(gen, x, y, rotation);
+    if (gen->tested[s] != gen->stamp) {
+        gen->tested[s] = gen->stamp;
+        gen->fits[s] = does_piece_fit(board, type, x, y, rotation);
+    }
+    return gen->fits[s];
+}
+
+// appends the placement of state to list, walking the parents back to the
+// spawn for its path
+static bool add_placement(MoveGen *gen, MoveList *list, int state, int x,
+                          int y, int rotation) {
+    int length = 0;
+    for (int s = state; gen->parent[s] >= 0; s = gen->parent[s])
+        length++;
+
+    if (!reserve((void **)&list->placements, &list->capacity,
+                 list->count + 1, sizeof(Placement)) ||
+        !reserve((void **)&list->inputs, &list->input_capacity,
+                 list->input_count + length, 1))
+        return false;
+
+    int start = list->input_count;
+    int i = start + length;
+    for (int s = state; gen->parent[s] >= 0; s = gen->parent[s])
+        list->inputs[--i] = gen->move[s];
+    list->input_count += length;
+
+    list->placements[list->count++] = (Placement){.x = x,
+                                                  .y = y,
+                                                  .rotation = rotation,
+                                                  .path_start = start,
+                                                  .path_length = length};
+    return true;
+}
+
+int movegen_generate(MoveGen *gen, const Board *board, int type,
+                     MoveList *list) {
+    list->count = 0;
+    list->input_count = 0;
+
+    Piece spawn = spawn_piece(board, type);
+    if (!does_piece_fit(board, type, spawn.x, spawn.y, spawn.rotation))
+        return 0;
+
+    // a fresh stamp forgets the previous search without clearing anything
+    if (++gen->stamp == 0) {
+        size_t states = (size_t)4 * gen->height * (gen->width + 3);
+        memset(gen->visited, 0, states * sizeof(uint32_t));
+        memset(gen->placed, 0, states * sizeof(uint32_t));
+        memset(gen->tested, 0, states * sizeof(uint32_t));
+        gen->stamp = 1;
+    }
+
+    int head = 0;
+    int tail = 0;
+    int first = state_index(gen, spawn.x, spawn.y, spawn.rotation);
+    gen->visited[first] = gen->stamp;
+    gen->parent[first] = -1;
+    gen->queue[tail++] = first;
+
+    int stride = gen->width + 3;
+    while (head < tail) {
+        int s = gen->queue[head++];
+        int x = s % stride - 3;
+        int y = s / stride % gen->height;
+        int rotation = s / stride / gen->height;
+
+        for (int i = 0; i < (int)sizeof(moves); i++) {
+            int nx = x;
+            int ny = y;
+            int nr = rotation;
+            switch (moves[i]) {
+            case INPUT_LEFT:
+                nx--;
+                break;
+            case INPUT_RIGHT:
+                nx++;
+                break;
+            case INPUT_ROTATE:
+                nr = (rotation + 1) % 4;
+                break;
+            case INPUT_SOFT_DROP:
+                ny++;
+                break;
+            }
+
+            if (!fits(gen, board, type, nx, ny, nr))
+                continue;
+            int next = state_index(gen, nx, ny, nr);
+            if (gen->visited[next] == gen->stamp)
+                continue;
+
+            gen->visited[next] = gen->stamp;
+            gen->parent[next] = s;
+            gen->move[next] = moves[i];
+            gen->queue[tail++] = next;
+        }
+
+        // resting on something, the piece locks here. the search is
+        // breadth first, so the first state to reach a placement has the
+        // shortest path
+        if (!fits(gen, board, type, x, y + 1, rotation)) {
+            int canonical =
+                state_index(gen, x, y, canonical_rotation(type, rotation));
+            if (gen->placed[canonical] != gen->stamp) {
+                gen->placed[canonical] = gen->stamp;
+                if (!add_placement(gen, list, s, x, y, rotation))
+                    return list->count;
+            }
+        }
+    }
+
+    return list->count;
+}
+
+int movegen_apply(const MoveGen *gen, Board *board, uint64_t *key, int type,
+                  const Placement *placement) {
+    int w = board->width;
+    int lowest = -1;
+    int line_count = 0;
+
+    const uint8_t *mask = piece_masks[type][placement->rotation];
+    for (int py = 0; py < 4; py++) {
+        if (mask[py] == 0)
+            continue;
+
+        int by = placement->y + py;
+        for (int px = 0; px < 4; px++) {
+            if (!(mask[py] & (1 << px)))
+                continue;
+            int bx = placement->x + px;
+            board->cells[by * w + bx] = type + 1;
+            board->rows[by] |= UINT64_C(1) << bx;
+            board->fill[by]++;
+            *key ^= gen->cell_keys[by * w + bx];
+        }
+
+        if (board->fill[by] == w) {
+            lowest = by;
+            line_count++;
+        }
+        if (by < board->dirty_top)
+            board->dirty_top = by;
+        if (by > board->dirty_bottom)
+            board->dirty_bottom = by;
+        if (by < board->changed_top)
+            board->changed_top = by;
+        if (by > board->changed_bottom)
+            board->changed_bottom = by;
+    }
+
+    if (line_count == 0)
+        return 0;
+
+    // every row down to the lowest line moves or goes away, so their keys
+    // are taken out and put back where the rows end up
+    for (int y = 0; y <= lowest; y++)
+        *key ^= row_key(gen, board, y);
+
+    int dst = lowest;
+    for (int src = lowest; src >= 0; src--) {
+        if (board->fill[src] == w)
+            continue;
+        if (dst != src) {
+            memcpy(board->cells + dst * w, board->cells + src * w, w);
+            board->rows[dst] = board->rows[src];
+            board->fill[dst] = board->fill[src];
+        }
+        dst--;
+    }
+    memset(board->cells, 0, (size_t)(dst + 1) * w);
+    memset(board->rows, 0, (dst + 1) * sizeof(uint64_t));
+    memset(board->fill, 0, (dst + 1) * sizeof(int));
+
+    for (int y = 0; y <= lowest; y++)
+        *key ^= row_key(gen, board, y);
+    board->dirty_top = 0;
+    board->changed_top = 0;
+    return line_count;
+}
+
+void move_list_free(MoveList *list) {
+    free(list->placements);
+    free(list->inputs);
+    memset(list, 0, sizeof(*list));
+}
+
+bool trans_table_init(TransTable *table, int bits) {
+    memset(table, 0, sizeof(*table));
+    table->entries = calloc((size_t)1 << bits, sizeof(TransEntry));
+    if (table->entries == NULL)
+        return false;
+    table->mask = ((uint64_t)1 << bits) - 1;
+    return true;
+}
+
+bool trans_table_probe(TransTable *table, uint64_t key, int depth,
+                       float *value) {
+    table->probes++;
+    const TransEntry *entry = &table->entries[key & table->mask];
+    if (entry->depth == 0 || entry->key != key || entry->depth != depth)
+        return false;
+
+    table->hits++;
+    *value = entry->value;
+    return true;
+}
+
+void trans_table_store(TransTable *table, uint64_t key, int depth,
+                       float value) {
+    table->entries[key & table->mask] =
+        (TransEntry){.key = key, .value = value, .depth = depth};
+}
+
+void trans_table_free(TransTable *table) {
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
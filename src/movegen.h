@@ -0,0 +1,100 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+// finds every placement a piece can reach from its spawn through left,
+// right, rotate and soft drop inputs, tucks and spins included, together
+// with the shortest input path to each. gravity is left out, so a path
+// assumes the player moves faster than the piece falls
+//
+// boards are identified by 64 bit Zobrist keys that placements update in
+// place, and a fixed size transposition table caches search results by key
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// entries of the default transposition table, 2^20 of them
+#define TRANS_TABLE_BITS 20
+
+typedef struct {
+    int x;
+    int y;
+    int rotation;
+    // the path is inputs[path_start] to inputs[path_start + path_length - 1]
+    // of the move list, one INPUT_* per tick
+    int path_start;
+    int path_length;
+} Placement;
+
+typedef struct {
+    Placement *placements;
+    int count;
+    int capacity;
+    uint8_t *inputs;
+    int input_count;
+    int input_capacity;
+} MoveList;
+
+typedef struct {
+    uint64_t key;
+    float value;
+    // 0 marks an empty entry
+    int depth;
+} TransEntry;
+
+typedef struct {
+    TransEntry *entries;
+    uint64_t mask;
+    uint64_t probes;
+    uint64_t hits;
+} TransTable;
+
+typedef struct {
+    int width;
+    int height;
+    // one key per cell, an occupied cell xors its key into the board key
+    uint64_t *cell_keys;
+    uint64_t piece_keys[PIECE_COUNT];
+    // search state, one entry per (x, y, rotation), x starting at -3.
+    // visited, placed and tested hold the stamp of the search that reached
+    // them. fits caches does_piece_fit for the tested states, most states
+    // are tested from several neighbours
+    uint32_t *visited;
+    uint32_t *placed;
+    uint32_t *tested;
+    uint8_t *fits;
+    uint32_t stamp;
+    int *queue;
+    int *parent;
+    uint8_t *move;
+} MoveGen;
+
+bool movegen_init(MoveGen *gen, int width, int height, uint64_t seed);
+void movegen_free(MoveGen *gen);
+
+// key of the cells of the board
+uint64_t movegen_board_key(const MoveGen *gen, const Board *board);
+
+// fills list with the placements of type reachable on board, in the order
+// they were found. returns the count, 0 when the piece can't spawn
+int movegen_generate(MoveGen *gen, const Board *board, int type,
+                     MoveList *list);
+
+// locks the piece at the placement and collapses the completed lines right
+// away, key follows the change. returns the number of lines
+int movegen_apply(const MoveGen *gen, Board *board, uint64_t *key, int type,
+                  const Placement *placement);
+
+void move_list_free(MoveList *list);
+
+// the table keeps 2^bits entries, a store replaces whatever was in its slot
+bool trans_table_init(TransTable *table, int bits);
+// true and the value when key was stored with the same depth
+bool trans_table_probe(TransTable *table, uint64_t key, int depth,
+                       float *value);
+void trans_table_store(TransTable *table, uint64_t key, int depth,
+                       float value);
+void trans_table_free(TransTable *table);
+
+#endif
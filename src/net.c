@@ -0,0 +1,104 @@
+#include "net.h"
+
+#include <SDL2/SDL_timer.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "engine.h"
+
+bool net_open(NetLink *net, int local_port, const char *host, int port,
+              LinkConditions link) {
+    memset(net, 0, sizeof(*net));
+    net->socket = -1;
+    net->link = link;
+    net->rng = 0x2545f491u ^ (uint32_t)local_port;
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *info;
+    if (getaddrinfo(host, NULL, &hints, &info) != 0) {
+        errno = EHOSTUNREACH;
+        return false;
+    }
+    net->peer = *(struct sockaddr_in *)info->ai_addr;
+    net->peer.sin_port = htons(port);
+    freeaddrinfo(info);
+
+    net->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (net->socket < 0)
+        return false;
+
+    struct sockaddr_in local = {.sin_family = AF_INET,
+                                .sin_port = htons(local_port),
+                                .sin_addr.s_addr = htonl(INADDR_ANY)};
+    if (bind(net->socket, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+        fcntl(net->socket, F_SETFL, O_NONBLOCK) < 0) {
+        int error = errno;
+        close(net->socket);
+        net->socket = -1;
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+static float link_random(NetLink *net) {
+    return (float)engine_rand(&net->rng) / UINT32_MAX;
+}
+
+void net_send(NetLink *net, const void *data, int size) {
+    net->sent++;
+    if (size > NET_MAX_PACKET || net->held_count == NET_LINK_SLOTS ||
+        link_random(net) < net->link.loss) {
+        net->lost++;
+        return;
+    }
+
+    int jitter = 0;
+    if (net->link.jitter_ms > 0) {
+        jitter = (int)(engine_rand(&net->rng) % (2 * net->link.jitter_ms + 1)) -
+                 net->link.jitter_ms;
+    }
+    int delay = SDL_max(0, net->link.delay_ms + jitter);
+
+    HeldPacket *packet = &net->held[net->held_count++];
+    packet->due = SDL_GetTicks() + delay;
+    packet->size = size;
+    memcpy(packet->data, data, size);
+}
+
+int net_receive(NetLink *net, void *data, int capacity) {
+    // the held packets are few, a scan is cheaper than keeping them sorted.
+    // the ones still held keep their order
+    Uint32 now = SDL_GetTicks();
+    int kept = 0;
+    for (int i = 0; i < net->held_count; i++) {
+        HeldPacket *packet = &net->held[i];
+        if ((Sint32)(packet->due - now) > 0) {
+            if (kept != i)
+                net->held[kept] = *packet;
+            kept++;
+            continue;
+        }
+
+        sendto(net->socket, packet->data, packet->size, 0,
+               (struct sockaddr *)&net->peer, sizeof(net->peer));
+    }
+    net->held_count = kept;
+
+    ssize_t size = recv(net->socket, data, capacity, 0);
+    if (size <= 0)
+        return 0;
+    net->received++;
+    return size;
+}
+
+void net_close(NetLink *net) {
+    if (net->socket >= 0)
+        close(net->socket);
+    net->socket = -1;
+}
@@ -0,0 +1,57 @@
+#ifndef NET_H
+#define NET_H
+
+// non-blocking UDP link between two instances of the game. everything sent
+// goes through an emulated link first, which holds packets back for a
+// delay plus jitter and drops a share of them, so the netcode can be
+// measured on localhost under the conditions of a real network
+
+#include <SDL2/SDL_stdinc.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NET_MAX_PACKET 512
+// packets the emulated link can hold back at once, more are dropped
+#define NET_LINK_SLOTS 256
+
+typedef struct {
+    // one way delay, jitter is the most a packet arrives earlier or later
+    // than that, so packets may also arrive out of order
+    int delay_ms;
+    int jitter_ms;
+    // share of packets lost, 0-1
+    float loss;
+} LinkConditions;
+
+typedef struct {
+    // SDL_GetTicks time the packet leaves
+    Uint32 due;
+    int size;
+    uint8_t data[NET_MAX_PACKET];
+} HeldPacket;
+
+typedef struct {
+    int socket;
+    struct sockaddr_in peer;
+    LinkConditions link;
+    uint32_t rng;
+    HeldPacket held[NET_LINK_SLOTS];
+    int held_count;
+    uint32_t sent;
+    uint32_t lost;
+    uint32_t received;
+} NetLink;
+
+// binds local_port on every interface and sends to host:port. returns
+// false with errno set when the socket can't be set up
+bool net_open(NetLink *net, int local_port, const char *host, int port,
+              LinkConditions link);
+// hands size bytes to the emulated link
+void net_send(NetLink *net, const void *data, int size);
+// sends the packets whose time has come and returns the size of the next
+// packet that arrived, 0 when there is none
+int net_receive(NetLink *net, void *data, int capacity);
+void net_close(NetLink *net);
+
+#endif
@@ -0,0 +1,151 @@
+#include "pool.h"
+
+#include <SDL2/SDL_cpuinfo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUEUE_MASK (POOL_QUEUE_SIZE - 1)
+
+// failed steal attempts before a worker with nothing to do goes to sleep
+#define IDLE_ROUNDS 64
+
+// SDL atomics are sequentially consistent, which is what the deque below
+// relies on
+static bool queue_push(TaskQueue *queue, Task task) {
+    int b = SDL_AtomicGet(&queue->bottom);
+    int t = SDL_AtomicGet(&queue->top);
+    if (b - t >= POOL_QUEUE_SIZE)
+        return false;
+
+    queue->tasks[b & QUEUE_MASK] = task;
+    SDL_AtomicSet(&queue->bottom, b + 1);
+    return true;
+}
+
+static bool queue_pop(TaskQueue *queue, Task *task) {
+    int b = SDL_AtomicGet(&queue->bottom) - 1;
+    SDL_AtomicSet(&queue->bottom, b);
+    int t = SDL_AtomicGet(&queue->top);
+
+    if (t > b) {
+        // empty
+        SDL_AtomicSet(&queue->bottom, b + 1);
+        return false;
+    }
+
+    *task = queue->tasks[b & QUEUE_MASK];
+    if (t == b) {
+        // last task, race the thieves for it
+        bool won = SDL_AtomicCAS(&queue->top, t, t + 1);
+        SDL_AtomicSet(&queue->bottom, b + 1);
+        return won;
+    }
+    return true;
+}
+
+static bool queue_steal(TaskQueue *queue, Task *task) {
+    int t = SDL_AtomicGet(&queue->top);
+    int b = SDL_AtomicGet(&queue->bottom);
+    if (t >= b)
+        return false;
+
+    *task = queue->tasks[t & QUEUE_MASK];
+    return SDL_AtomicCAS(&queue->top, t, t + 1);
+}
+
+// runs one task from the own queue or stolen from another, false if there
+// was nothing to do
+static bool run_one(TaskPool *pool, int worker) {
+    Task task;
+    bool found = queue_pop(&pool->queues[worker], &task);
+    for (int i = 1; !found && i < pool->thread_count; i++) {
+        found =
+            queue_steal(&pool->queues[(worker + i) % pool->thread_count],
+                        &task);
+    }
+    if (!found)
+        return false;
+
+    task.run(task.arg, worker);
+    SDL_AtomicAdd(&pool->pending, -1);
+    return true;
+}
+
+static int worker_main(void *data) {
+    TaskPool *pool = data;
+    int worker = SDL_AtomicAdd(&pool->started, 1) + 1;
+
+    while (true) {
+        SDL_SemWait(pool->wake);
+        if (SDL_AtomicGet(&pool->quit))
+            return 0;
+
+        // keep going while tasks are around, running ones may push more
+        int idle = 0;
+        while (SDL_AtomicGet(&pool->pending) > 0 || idle < IDLE_ROUNDS) {
+            if (run_one(pool, worker)) {
+                idle = 0;
+            } else if (++idle >= IDLE_ROUNDS) {
+                if (SDL_AtomicGet(&pool->pending) == 0)
+                    break;
+                SDL_Delay(0);
+            }
+        }
+    }
+}
+
+bool pool_init(TaskPool *pool, int threads) {
+    memset(pool, 0, sizeof(*pool));
+    if (threads <= 0)
+        threads = SDL_GetCPUCount();
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    pool->queues = calloc(threads, sizeof(TaskQueue));
+    pool->wake = SDL_CreateSemaphore(0);
+    if (pool->queues == NULL || pool->wake == NULL) {
+        pool_free(pool);
+        return false;
+    }
+
+    pool->thread_count = 1;
+    for (int i = 1; i < threads; i++) {
+        pool->threads[i] = SDL_CreateThread(worker_main, "pool", pool);
+        if (pool->threads[i] == NULL)
+            break;
+        pool->thread_count++;
+    }
+    return true;
+}
+
+void pool_push(TaskPool *pool, int worker, TaskFunction run, void *arg) {
+    SDL_AtomicAdd(&pool->pending, 1);
+    if (!queue_push(&pool->queues[worker], (Task){run, arg})) {
+        run(arg, worker);
+        SDL_AtomicAdd(&pool->pending, -1);
+    }
+}
+
+void pool_run(TaskPool *pool) {
+    for (int i = 1; i < pool->thread_count; i++)
+        SDL_SemPost(pool->wake);
+
+    while (SDL_AtomicGet(&pool->pending) > 0) {
+        if (!run_one(pool, 0))
+            SDL_Delay(0);
+    }
+}
+
+void pool_free(TaskPool *pool) {
+    SDL_AtomicSet(&pool->quit, 1);
+    for (int i = 1; i < pool->thread_count; i++)
+        SDL_SemPost(pool->wake);
+    for (int i = 1; i < pool->thread_count; i++)
+        SDL_WaitThread(pool->threads[i], NULL);
+
+    if (pool->wake != NULL)
+        SDL_DestroySemaphore(pool->wake);
+    free(pool->queues);
+    memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,58 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#include <stdbool.h>
+
+#define POOL_MAX_THREADS 64
+// tasks a worker can have queued, a power of two. pushing onto a full
+// queue runs the task right away instead
+#define POOL_QUEUE_SIZE 4096
+
+// worker is the index of the thread running the task, tasks pushed from a
+// task should go to that worker's queue
+typedef void (*TaskFunction)(void *arg, int worker);
+
+typedef struct {
+    TaskFunction run;
+    void *arg;
+} Task;
+
+// work stealing deque, the owner pushes and pops at the bottom and the
+// other workers steal from the top
+typedef struct {
+    Task tasks[POOL_QUEUE_SIZE];
+    SDL_atomic_t top;
+    SDL_atomic_t bottom;
+} TaskQueue;
+
+// worker 0 is whoever calls pool_run, the others are threads sleeping
+// until there is work. the pool must not move after pool_init
+typedef struct {
+    int thread_count;
+    SDL_Thread *threads[POOL_MAX_THREADS];
+    TaskQueue *queues;
+    // tasks pushed but not finished yet
+    SDL_atomic_t pending;
+    SDL_atomic_t quit;
+    // hands out the worker indices to the threads
+    SDL_atomic_t started;
+    SDL_sem *wake;
+} TaskPool;
+
+// threads <= 0 uses one thread per core
+bool pool_init(TaskPool *pool, int threads);
+
+// queues a task for worker, call it with worker 0 before pool_run or from
+// a running task with its own worker index
+void pool_push(TaskPool *pool, int worker, TaskFunction run, void *arg);
+
+// wakes the workers and helps out until every task, including the ones
+// pushed by tasks, has finished
+void pool_run(TaskPool *pool);
+
+void pool_free(TaskPool *pool);
+
+#endif
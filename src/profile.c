@@ -0,0 +1,189 @@
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <SDL2/SDL_keycode.h>
+#include <SDL2/SDL_timer.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+// the trace stops growing past this many events
+#define PROFILE_MAX_EVENTS (1 << 20)
+
+#define OVERLAY_X 10
+#define OVERLAY_Y 10
+#define OVERLAY_WIDTH (PROFILE_WINDOW + 20)
+#define OVERLAY_LINE 18
+// vertical scale of the frame time graph
+#define OVERLAY_PX_PER_MS 4
+
+static const char *zone_names[ZONE_COUNT] = {
+    "frame", "events", "sim", "board", "text", "present", "idle"};
+
+typedef struct {
+    uint8_t zone;
+    Uint64 start;
+    Uint64 duration;
+} TraceEvent;
+
+static struct {
+    const char *trace_path;
+    Uint64 origin;
+    Uint64 start[ZONE_COUNT];
+    Uint64 frame_total[ZONE_COUNT];
+    // ring of per frame totals in ms
+    float window[ZONE_COUNT][PROFILE_WINDOW];
+    int window_next;
+    int window_count;
+    TraceEvent *events;
+    int event_count;
+    int event_capacity;
+    bool overlay;
+} profile;
+
+static float ticks_to_ms(Uint64 ticks) {
+    return (float)ticks * 1000.0f / SDL_GetPerformanceFrequency();
+}
+
+void profile_init(const char *trace_path) {
+    memset(&profile, 0, sizeof(profile));
+    profile.trace_path = trace_path;
+    profile.origin = SDL_GetPerformanceCounter();
+}
+
+static void record_event(int zone, Uint64 start, Uint64 duration) {
+    if (profile.event_count == profile.event_capacity) {
+        if (profile.event_capacity == PROFILE_MAX_EVENTS)
+            return;
+
+        int capacity = profile.event_capacity ? profile.event_capacity * 2
+                                              : 4096;
+        TraceEvent *events =
+            realloc(profile.events, capacity * sizeof(TraceEvent));
+        if (events == NULL)
+            return;
+        profile.events = events;
+        profile.event_capacity = capacity;
+    }
+
+    profile.events[profile.event_count++] =
+        (TraceEvent){.zone = zone, .start = start, .duration = duration};
+}
+
+void profile_begin(int zone) {
+    profile.start[zone] = SDL_GetPerformanceCounter();
+}
+
+void profile_end(int zone) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (profile.start[zone] == 0)
+        return;
+
+    Uint64 duration = now - profile.start[zone];
+    profile.frame_total[zone] += duration;
+    record_event(zone, profile.start[zone], duration);
+    profile.start[zone] = 0;
+}
+
+void profile_frame_end() {
+    for (int zone = 0; zone < ZONE_COUNT; zone++) {
+        profile.window[zone][profile.window_next] =
+            ticks_to_ms(profile.frame_total[zone]);
+        profile.frame_total[zone] = 0;
+    }
+
+    profile.window_next = (profile.window_next + 1) % PROFILE_WINDOW;
+    if (profile.window_count < PROFILE_WINDOW)
+        profile.window_count++;
+}
+
+void profile_event(const SDL_Event *event) {
+    if (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_F3)
+        profile.overlay = !profile.overlay;
+}
+
+void profile_draw_overlay(SpriteBatch *batch, TextCache *text) {
+    if (!profile.overlay || profile.window_count == 0)
+        return;
+
+    int count = profile.window_count;
+    int graph_h = 25 * OVERLAY_PX_PER_MS;
+    int height = graph_h + (ZONE_COUNT + 1) * OVERLAY_LINE + 20;
+    sprite_batch_fill(batch,
+                      &(SDL_FRect){OVERLAY_X, OVERLAY_Y, OVERLAY_WIDTH, height},
+                      (SDL_Color){0, 0, 0, 200});
+
+    // one bar per frame, oldest on the left, with a line at 60 fps
+    float gx = OVERLAY_X + 10;
+    float gy = OVERLAY_Y + 10 + graph_h;
+    for (int i = 0; i < count; i++) {
+        int idx = (profile.window_next - count + i + PROFILE_WINDOW) %
+                  PROFILE_WINDOW;
+        float h = profile.window[ZONE_FRAME][idx] * OVERLAY_PX_PER_MS;
+        if (h > graph_h)
+            h = graph_h;
+        SDL_Color color = h > 1000.0f / 60 * OVERLAY_PX_PER_MS
+                              ? (SDL_Color){230, 80, 80, 255}
+                              : (SDL_Color){80, 200, 120, 255};
+        sprite_batch_fill(batch, &(SDL_FRect){gx + i, gy - h, 1, h}, color);
+    }
+    sprite_batch_fill(
+        batch,
+        &(SDL_FRect){gx, gy - 1000.0f / 60 * OVERLAY_PX_PER_MS, PROFILE_WINDOW,
+                     1},
+        (SDL_Color){255, 255, 255, 120});
+    sprite_batch_flush(batch);
+
+    SDL_Color white = {255, 255, 255, 255};
+    int y = gy + 5;
+    text_draw_glyphs(text, "ms    p50    p99", 16, white, gx + 60, y);
+    for (int zone = 0; zone < ZONE_COUNT; zone++) {
+        float p50, p99, max;
+        percentiles(profile.window[zone], count, &p50, &p99, &max);
+
+        char line[64];
+        snprintf(line, sizeof(line), "%6.2f %6.2f", p50, p99);
+        y += OVERLAY_LINE;
+        text_draw_glyphs(text, zone_names[zone], 16, white, gx, y);
+        text_draw_glyphs(text, line, 16, white, gx + 80, y);
+    }
+}
+
+static bool write_trace() {
+    FILE *file = fopen(profile.trace_path, "w");
+    if (file == NULL)
+        return false;
+
+    double us = 1e6 / SDL_GetPerformanceFrequency();
+    fprintf(file, "{\"traceEvents\": [\n");
+    for (int i = 0; i < profile.event_count; i++) {
+        const TraceEvent *event = &profile.events[i];
+        fprintf(file,
+                "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                "\"dur\": %.3f, \"pid\": 1, \"tid\": 1}",
+                i > 0 ? ",\n" : "", zone_names[event->zone],
+                (event->start - profile.origin) * us, event->duration * us);
+    }
+    fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+    return fclose(file) == 0;
+}
+
+void profile_shutdown() {
+    if (profile.trace_path != NULL && !write_trace()) {
+        fprintf(stderr, "WARNING: failed to write trace to %s\n",
+                profile.trace_path);
+    }
+
+    free(profile.events);
+    profile.events = NULL;
+    profile.event_count = 0;
+    profile.event_capacity = 0;
+}
+
+#endif
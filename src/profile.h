@@ -0,0 +1,70 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// timing zones around the phases of a frame. they only exist when built
+// with -DPROFILE (make PROFILE=1), otherwise every macro below expands to
+// nothing
+//
+// F3 toggles an overlay with the p50/p99 of every zone over the last
+// PROFILE_WINDOW frames, and a Chrome trace_event file is written on exit
+
+#include <SDL2/SDL_events.h>
+
+#include "sprite_batch.h"
+#include "text.h"
+
+#define ZONE_FRAME 0
+#define ZONE_EVENTS 1
+#define ZONE_SIMULATION 2
+#define ZONE_BOARD 3
+#define ZONE_TEXT 4
+#define ZONE_PRESENT 5
+// sleeping on the home and game over screens until something changes
+#define ZONE_IDLE 6
+#define ZONE_COUNT 7
+
+// frames the overlay statistics cover
+#define PROFILE_WINDOW 240
+
+#define DEFAULT_TRACE_PATH "tetris_trace.json"
+
+#ifdef PROFILE
+
+#define PROFILE_INIT(trace_path) profile_init(trace_path)
+#define PROFILE_SHUTDOWN() profile_shutdown()
+#define PROFILE_BEGIN(zone) profile_begin(zone)
+#define PROFILE_END(zone) profile_end(zone)
+#define PROFILE_FRAME_END() profile_frame_end()
+#define PROFILE_EVENT(event) profile_event(event)
+#define PROFILE_OVERLAY(batch, text) profile_draw_overlay(batch, text)
+
+void profile_init(const char *trace_path);
+// writes the trace and frees the recorded events
+void profile_shutdown();
+
+// a zone may be entered several times per frame, the times add up. a zone
+// left through an early return just loses that sample
+void profile_begin(int zone);
+void profile_end(int zone);
+
+// moves the totals of the frame into the overlay window
+void profile_frame_end();
+
+// toggles the overlay on F3
+void profile_event(const SDL_Event *event);
+
+void profile_draw_overlay(SpriteBatch *batch, TextCache *text);
+
+#else
+
+#define PROFILE_INIT(trace_path) ((void)0)
+#define PROFILE_SHUTDOWN() ((void)0)
+#define PROFILE_BEGIN(zone) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+#define PROFILE_EVENT(event) ((void)0)
+#define PROFILE_OVERLAY(batch, text) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,271 @@
+#include "raster.h"
+
+#include <SDL2/SDL_cpuinfo.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+// built for AVX2 on its own and only called when the cpu has it
+#define RASTER_AVX2 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static void fill_row(uint32_t *dst, int n, uint32_t value) {
+    int i = 0;
+#ifdef __SSE2__
+    __m128i v = _mm_set1_epi32(value);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+#endif
+    for (; i < n; i++)
+        dst[i] = value;
+}
+
+// dst takes every src pixel whose alpha isn't 0
+static void masked_row(uint32_t *dst, const uint32_t *src, int n) {
+    int i = 0;
+#ifdef __SSE2__
+    __m128i alpha = _mm_set1_epi32(0xff000000);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i clear = _mm_cmpeq_epi32(_mm_and_si128(s, alpha), zero);
+        d = _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, s));
+        _mm_storeu_si128((__m128i *)(dst + i), d);
+    }
+#endif
+    for (; i < n; i++) {
+        if (src[i] >> 24)
+            dst[i] = src[i];
+    }
+}
+
+static void sample_row(uint32_t *dst, const uint32_t *src, const int *columns,
+                       int n) {
+    for (int i = 0; i < n; i++)
+        dst[i] = src[columns[i]];
+}
+
+#ifdef RASTER_AVX2
+TARGET_AVX2 static void fill_row_avx2(uint32_t *dst, int n, uint32_t value) {
+    int i = 0;
+    __m256i v = _mm256_set1_epi32(value);
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    for (; i < n; i++)
+        dst[i] = value;
+}
+
+TARGET_AVX2 static void masked_row_avx2(uint32_t *dst, const uint32_t *src,
+                                        int n) {
+    int i = 0;
+    __m256i alpha = _mm256_set1_epi32(0xff000000);
+    __m256i zero = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i clear = _mm256_cmpeq_epi32(_mm256_and_si256(s, alpha), zero);
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_blendv_epi8(s, d, clear));
+    }
+    for (; i < n; i++) {
+        if (src[i] >> 24)
+            dst[i] = src[i];
+    }
+}
+
+TARGET_AVX2 static void sample_row_avx2(uint32_t *dst, const uint32_t *src,
+                                        const int *columns, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i index = _mm256_loadu_si256((const __m256i *)(columns + i));
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_i32gather_epi32((const int *)src, index, 4));
+    }
+    for (; i < n; i++)
+        dst[i] = src[columns[i]];
+}
+#endif
+
+static void fill(const Raster *raster, uint32_t *dst, int n, uint32_t value) {
+#ifdef RASTER_AVX2
+    if (raster->avx2) {
+        fill_row_avx2(dst, n, value);
+        return;
+    }
+#endif
+    (void)raster;
+    fill_row(dst, n, value);
+}
+
+static void masked(const Raster *raster, uint32_t *dst, const uint32_t *src,
+                   int n) {
+#ifdef RASTER_AVX2
+    if (raster->avx2) {
+        masked_row_avx2(dst, src, n);
+        return;
+    }
+#endif
+    (void)raster;
+    masked_row(dst, src, n);
+}
+
+static void sample(const Raster *raster, const uint32_t *src, int n) {
+#ifdef RASTER_AVX2
+    if (raster->avx2) {
+        sample_row_avx2(raster->row, src, raster->columns, n);
+        return;
+    }
+#endif
+    sample_row(raster->row, src, raster->columns, n);
+}
+
+bool raster_image_init(RasterImage *image, int w, int h) {
+    image->w = w;
+    image->h = h;
+    image->pixels = calloc((size_t)w * h, sizeof(uint32_t));
+    return image->pixels != NULL;
+}
+
+bool raster_image_from_surface(RasterImage *image, SDL_Surface *surface) {
+    memset(image, 0, sizeof(*image));
+    SDL_Surface *argb =
+        SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (argb == NULL)
+        return false;
+
+    bool ok = raster_image_init(image, argb->w, argb->h);
+    for (int y = 0; ok && y < argb->h; y++) {
+        memcpy(image->pixels + y * argb->w,
+               (const uint8_t *)argb->pixels + y * argb->pitch,
+               argb->w * sizeof(uint32_t));
+    }
+    SDL_FreeSurface(argb);
+    return ok;
+}
+
+void raster_image_free(RasterImage *image) {
+    free(image->pixels);
+    memset(image, 0, sizeof(*image));
+}
+
+bool raster_init(Raster *raster, SDL_Renderer *renderer, int w, int h) {
+    memset(raster, 0, sizeof(*raster));
+    raster->renderer = renderer;
+    raster->avx2 = SDL_HasAVX2();
+    if (renderer != NULL) {
+        raster->texture =
+            SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                              SDL_TEXTUREACCESS_STREAMING, w, h);
+    }
+    raster->columns = malloc(w * sizeof(int));
+    raster->row = malloc(w * sizeof(uint32_t));
+    if ((renderer != NULL && raster->texture == NULL) ||
+        raster->columns == NULL ||
+        raster->row == NULL || !raster_image_init(&raster->frame, w, h)) {
+        raster_free(raster);
+        return false;
+    }
+    raster->target = &raster->frame;
+    return true;
+}
+
+void raster_set_target(Raster *raster, RasterImage *image) {
+    raster->target = image != NULL ? image : &raster->frame;
+}
+
+static int round_px(float v) {
+    return (int)floorf(v + 0.5f);
+}
+
+void raster_fill(Raster *raster, const SDL_FRect *dst, SDL_Color color) {
+    RasterImage *target = raster->target;
+    int x0 = SDL_max(round_px(dst->x), 0);
+    int y0 = SDL_max(round_px(dst->y), 0);
+    int x1 = SDL_min(round_px(dst->x + dst->w), target->w);
+    int y1 = SDL_min(round_px(dst->y + dst->h), target->h);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    uint32_t value = (uint32_t)color.a << 24 | color.r << 16 | color.g << 8 |
+                     color.b;
+    for (int y = y0; y < y1; y++)
+        fill(raster, target->pixels + y * target->w + x0, x1 - x0, value);
+}
+
+void raster_blit(Raster *raster, const RasterImage *image, const SDL_Rect *src,
+                 const SDL_FRect *dst) {
+    RasterImage *target = raster->target;
+    SDL_Rect s = src != NULL ? *src : (SDL_Rect){0, 0, image->w, image->h};
+    int dx = round_px(dst->x);
+    int dy = round_px(dst->y);
+    int dw = round_px(dst->x + dst->w) - dx;
+    int dh = round_px(dst->y + dst->h) - dy;
+    if (dw <= 0 || dh <= 0 || s.w <= 0 || s.h <= 0)
+        return;
+
+    int x0 = SDL_max(dx, 0);
+    int y0 = SDL_max(dy, 0);
+    int x1 = SDL_min(dx + dw, target->w);
+    int y1 = SDL_min(dy + dh, target->h);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // nearest neighbour, the columns are the same for every row
+    int n = x1 - x0;
+    bool scaled = dw != s.w;
+    if (scaled) {
+        for (int i = 0; i < n; i++)
+            raster->columns[i] = (int)((int64_t)(x0 + i - dx) * s.w / dw);
+    }
+
+    int sampled = -1;
+    for (int y = y0; y < y1; y++) {
+        int sy = s.y + (int)((int64_t)(y - dy) * s.h / dh);
+        const uint32_t *row = image->pixels + sy * image->w + s.x;
+        uint32_t *out = target->pixels + y * target->w + x0;
+        if (!scaled) {
+            masked(raster, out, row + (x0 - dx), n);
+            continue;
+        }
+
+        // stretched rows repeat, sample each source row once
+        if (sy != sampled) {
+            sample(raster, row, n);
+            sampled = sy;
+        }
+        masked(raster, out, raster->row, n);
+    }
+}
+
+void raster_copy(Raster *raster, const RasterImage *image) {
+    RasterImage *target = raster->target;
+    int w = SDL_min(image->w, target->w);
+    int h = SDL_min(image->h, target->h);
+    for (int y = 0; y < h; y++) {
+        memcpy(target->pixels + y * target->w, image->pixels + y * image->w,
+               w * sizeof(uint32_t));
+    }
+}
+
+void raster_present(Raster *raster) {
+    SDL_UpdateTexture(raster->texture, NULL, raster->frame.pixels,
+                      raster->frame.w * sizeof(uint32_t));
+    SDL_RenderCopy(raster->renderer, raster->texture, NULL, NULL);
+    raster->draw_calls++;
+}
+
+void raster_free(Raster *raster) {
+    if (raster->texture != NULL)
+        SDL_DestroyTexture(raster->texture);
+    free(raster->columns);
+    free(raster->row);
+    raster_image_free(&raster->frame);
+    memset(raster, 0, sizeof(*raster));
+}
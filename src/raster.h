@@ -0,0 +1,68 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+// software render path for machines without a GPU. everything is drawn
+// straight into a pixel buffer with SIMD row fills and blits, and the
+// finished frame goes to the renderer as one streaming texture upload and
+// one copy, instead of the hundreds of small fills and copies the software
+// renderer of SDL would run through
+//
+// pixels are ARGB8888. blits skip source pixels whose alpha is 0 and copy
+// all others as they are, which covers the opaque tiles of the atlas and
+// the solid rendered glyphs of the font
+
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_surface.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t *pixels;
+    int w;
+    int h;
+} RasterImage;
+
+typedef struct {
+    SDL_Renderer *renderer;
+    // window sized, written once per frame
+    SDL_Texture *texture;
+    RasterImage frame;
+    // what draws go to, the frame unless raster_set_target picked another
+    // image
+    RasterImage *target;
+    // source column of every destination pixel of the row being blitted,
+    // and the sampled row
+    int *columns;
+    uint32_t *row;
+    bool avx2;
+    // raster_present calls, each is a draw call of the renderer
+    int draw_calls;
+} Raster;
+
+bool raster_image_init(RasterImage *image, int w, int h);
+// copy of the surface in ARGB8888, a color key turns into alpha 0
+bool raster_image_from_surface(RasterImage *image, SDL_Surface *surface);
+void raster_image_free(RasterImage *image);
+
+// returns false with the SDL error set when the texture can't be created.
+// without a renderer the frame is only drawn, not presented
+bool raster_init(Raster *raster, SDL_Renderer *renderer, int w, int h);
+// draws into image from now on, NULL goes back to the frame. image must not
+// be wider than the frame
+void raster_set_target(Raster *raster, RasterImage *image);
+
+void raster_fill(Raster *raster, const SDL_FRect *dst, SDL_Color color);
+// the src region of image stretched over dst, NULL src is the whole image
+void raster_blit(Raster *raster, const RasterImage *image, const SDL_Rect *src,
+                 const SDL_FRect *dst);
+// image copied to the top left corner of the target, alpha included
+void raster_copy(Raster *raster, const RasterImage *image);
+
+// uploads the frame and copies it to the renderer, SDL_RenderPresent is
+// left to the caller
+void raster_present(Raster *raster);
+void raster_free(Raster *raster);
+
+#endif
@@ -0,0 +1,216 @@
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// file layout, integers are little endian:
+//   "TREP", version u8, width u8, height u16, clear_ticks u16, seed u32,
+//   ticks u32, score u32, lines u32, hash u64, event count u32
+// followed by one record per event, the tick as a LEB128 varint delta from
+// the previous event and the input mask as one byte
+#define REPLAY_MAGIC "TREP"
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 38
+
+void replay_record_init(Replay *replay, const GameState *state, uint32_t seed) {
+    ReplayEvent *events = replay->events;
+    int capacity = replay->event_capacity;
+
+    memset(replay, 0, sizeof(*replay));
+    replay->width = state->board.width;
+    replay->height = state->board.height;
+    replay->clear_ticks = state->clear_ticks;
+    replay->seed = seed;
+    // keep the log of the previous game around to record into
+    replay->events = events;
+    replay->event_capacity = capacity;
+}
+
+void replay_record_tick(Replay *replay, int input) {
+    if (input != INPUT_NONE) {
+        if (replay->event_count == replay->event_capacity) {
+            int capacity =
+                replay->event_capacity ? replay->event_capacity * 2 : 1024;
+            ReplayEvent *events =
+                realloc(replay->events, capacity * sizeof(ReplayEvent));
+            if (events == NULL) {
+                fprintf(stderr, "WARNING: replay is out of memory\n");
+                replay->ticks++;
+                return;
+            }
+            replay->events = events;
+            replay->event_capacity = capacity;
+        }
+
+        replay->events[replay->event_count++] =
+            (ReplayEvent){.tick = replay->ticks, .input = input};
+    }
+
+    replay->ticks++;
+}
+
+void replay_truncate(Replay *replay, uint32_t tick) {
+    while (replay->event_count > 0 &&
+           replay->events[replay->event_count - 1].tick >= tick)
+        replay->event_count--;
+    if (replay->ticks > tick)
+        replay->ticks = tick;
+}
+
+void replay_record_finish(Replay *replay, const GameState *state) {
+    replay->score = state->score;
+    replay->lines_cleared = state->lines_cleared;
+    replay->hash = game_state_hash(state);
+}
+
+static unsigned char *put_le(unsigned char *p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        *p++ = value >> (8 * i);
+    return p;
+}
+
+static uint64_t get_le(const unsigned char *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)p[i] << (8 * i);
+    return value;
+}
+
+bool replay_save(const Replay *replay, const char *path) {
+    // a varint of a 32 bit delta takes 5 bytes at most
+    size_t size = REPLAY_HEADER_SIZE + (size_t)replay->event_count * 6;
+    unsigned char *data = malloc(size);
+    if (data == NULL)
+        return false;
+
+    unsigned char *p = data;
+    memcpy(p, REPLAY_MAGIC, 4);
+    p += 4;
+    p = put_le(p, REPLAY_VERSION, 1);
+    p = put_le(p, replay->width, 1);
+    p = put_le(p, replay->height, 2);
+    p = put_le(p, replay->clear_ticks, 2);
+    p = put_le(p, replay->seed, 4);
+    p = put_le(p, replay->ticks, 4);
+    p = put_le(p, replay->score, 4);
+    p = put_le(p, replay->lines_cleared, 4);
+    p = put_le(p, replay->hash, 8);
+    p = put_le(p, replay->event_count, 4);
+
+    uint32_t prev = 0;
+    for (int i = 0; i < replay->event_count; i++) {
+        uint32_t delta = replay->events[i].tick - prev;
+        prev = replay->events[i].tick;
+        do {
+            *p++ = (delta & 0x7f) | (delta >= 0x80 ? 0x80 : 0);
+            delta >>= 7;
+        } while (delta != 0);
+        *p++ = replay->events[i].input;
+    }
+
+    FILE *file = fopen(path, "wb");
+    size_t length = p - data;
+    bool ok = file != NULL && fwrite(data, 1, length, file) == length;
+    if (file != NULL && fclose(file) != 0)
+        ok = false;
+    free(data);
+    return ok;
+}
+
+bool replay_load(Replay *replay, const char *path) {
+    memset(replay, 0, sizeof(*replay));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    unsigned char header[REPLAY_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, REPLAY_MAGIC, 4) != 0 ||
+        header[4] != REPLAY_VERSION) {
+        fclose(file);
+        return false;
+    }
+
+    replay->width = get_le(header + 5, 1);
+    replay->height = get_le(header + 6, 2);
+    replay->clear_ticks = get_le(header + 8, 2);
+    replay->seed = get_le(header + 10, 4);
+    replay->ticks = get_le(header + 14, 4);
+    replay->score = get_le(header + 18, 4);
+    replay->lines_cleared = get_le(header + 22, 4);
+    replay->hash = get_le(header + 26, 8);
+    uint32_t count = get_le(header + 34, 4);
+
+    // there is at most one event per tick
+    if (!board_size_valid(replay->width, replay->height) ||
+        count > replay->ticks) {
+        fclose(file);
+        return false;
+    }
+
+    if (count > 0) {
+        replay->events = malloc(count * sizeof(ReplayEvent));
+        if (replay->events == NULL) {
+            fclose(file);
+            return false;
+        }
+        replay->event_capacity = count;
+    }
+
+    uint32_t tick = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t delta = 0;
+        int c;
+        for (int shift = 0;; shift += 7) {
+            if ((c = fgetc(file)) == EOF || shift > 28)
+                goto fail;
+            delta |= (uint32_t)(c & 0x7f) << shift;
+            if ((c & 0x80) == 0)
+                break;
+        }
+        if ((c = fgetc(file)) == EOF)
+            goto fail;
+
+        tick += delta;
+        if (tick >= replay->ticks || (i > 0 && delta == 0))
+            goto fail;
+        replay->events[i] = (ReplayEvent){.tick = tick, .input = c};
+        replay->event_count++;
+    }
+
+    fclose(file);
+    return true;
+
+fail:
+    fclose(file);
+    replay_free(replay);
+    return false;
+}
+
+bool replay_play(const Replay *replay, GameState *state) {
+    if (!game_state_init(state, replay->width, replay->height, replay->seed))
+        return false;
+    state->clear_ticks = replay->clear_ticks;
+
+    // same sequence of calls as the play loop
+    int next = 0;
+    for (uint32_t tick = 0; tick < replay->ticks; tick++) {
+        int input = INPUT_NONE;
+        if (next < replay->event_count && replay->events[next].tick == tick)
+            input = replay->events[next++].input;
+
+        game_state_apply_input(state, input);
+        game_state_step(state);
+    }
+
+    return state->score == replay->score &&
+           state->lines_cleared == replay->lines_cleared &&
+           game_state_hash(state) == replay->hash;
+}
+
+void replay_free(Replay *replay) {
+    free(replay->events);
+    memset(replay, 0, sizeof(*replay));
+}
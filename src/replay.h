@@ -0,0 +1,56 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "engine.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// input mask fed to the game on a given tick, ticks without an event get
+// INPUT_NONE
+typedef struct {
+    uint32_t tick;
+    uint8_t input;
+} ReplayEvent;
+
+// everything needed to play a game again tick for tick, plus the outcome
+// the recording ended with so the playback can be checked against it
+typedef struct {
+    int width;
+    int height;
+    int clear_ticks;
+    uint32_t seed;
+    uint32_t ticks;
+    ReplayEvent *events;
+    int event_count;
+    int event_capacity;
+    uint32_t score;
+    uint32_t lines_cleared;
+    uint64_t hash;
+} Replay;
+
+// starts recording the game that was just reset with seed
+void replay_record_init(Replay *replay, const GameState *state, uint32_t seed);
+
+// logs the input applied before the current tick and advances the tick
+// count, called once per game_state_step
+void replay_record_tick(Replay *replay, int input);
+
+// forgets everything recorded from tick on, for a game taken back to that
+// tick
+void replay_truncate(Replay *replay, uint32_t tick);
+
+// stores the outcome of the game
+void replay_record_finish(Replay *replay, const GameState *state);
+
+bool replay_save(const Replay *replay, const char *path);
+bool replay_load(Replay *replay, const char *path);
+
+// plays the replay on a fresh game as fast as possible, state is
+// initialized by the call and holds the final position afterwards. returns
+// false when the outcome differs from the recorded one
+bool replay_play(const Replay *replay, GameState *state);
+
+void replay_free(Replay *replay);
+
+#endif
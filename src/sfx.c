@@ -0,0 +1,221 @@
+#include "sfx.h"
+
+#include <SDL2/SDL_timer.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+#define NOTES_PER_EFFECT 4
+// ramp at the start of a note so it doesn't click
+#define ATTACK_MS 2.0f
+
+typedef struct {
+    float start_hz;
+    // the pitch glides to end_hz over the note
+    float end_hz;
+    float ms;
+    float volume;
+    bool square;
+    // share of white noise mixed in
+    float noise;
+} Note;
+
+// notes play one after the other, a note of 0ms ends the effect
+static const Note effects[SFX_COUNT][NOTES_PER_EFFECT] = {
+    [SFX_ROTATE] = {{1200, 1500, 35, 0.15f, true, 0}},
+    [SFX_LOCK] = {{180, 90, 70, 0.5f, false, 0.3f}},
+    [SFX_LINE] = {{523, 523, 60, 0.25f, true, 0},
+                  {659, 659, 60, 0.25f, true, 0},
+                  {784, 784, 60, 0.25f, true, 0},
+                  {1047, 1047, 120, 0.25f, true, 0}},
+    [SFX_GAME_OVER] = {{440, 330, 200, 0.4f, false, 0},
+                       {330, 220, 200, 0.4f, false, 0},
+                       {220, 110, 400, 0.4f, false, 0}},
+};
+
+// renders the notes of effect as signed 16 bit samples for every channel,
+// returns the number of frames
+static int synthesize(const SoundEffects *sfx, int effect, Sint16 **out) {
+    const Note *notes = effects[effect];
+    int frames = 0;
+    for (int i = 0; i < NOTES_PER_EFFECT && notes[i].ms > 0; i++)
+        frames += notes[i].ms * sfx->frequency / 1000;
+
+    Sint16 *samples = malloc((size_t)frames * sfx->channels * sizeof(Sint16));
+    if (samples == NULL)
+        return 0;
+
+    Sint16 *p = samples;
+    float phase = 0;
+    uint32_t rng = 0x9e3779b9u;
+    for (int i = 0; i < NOTES_PER_EFFECT && notes[i].ms > 0; i++) {
+        const Note *note = &notes[i];
+        int length = note->ms * sfx->frequency / 1000;
+        int attack = ATTACK_MS * sfx->frequency / 1000;
+        for (int f = 0; f < length; f++) {
+            float t = (float)f / length;
+            float hz = note->start_hz + (note->end_hz - note->start_hz) * t;
+            phase += 2 * (float)M_PI * hz / sfx->frequency;
+            if (phase > 2 * (float)M_PI)
+                phase -= 2 * (float)M_PI;
+
+            float wave = sinf(phase);
+            if (note->square)
+                wave = wave >= 0 ? 1.0f : -1.0f;
+
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            float noise = (float)rng / UINT32_MAX * 2 - 1;
+            wave = wave * (1 - note->noise) + noise * note->noise;
+
+            // linear attack, then a linear fade to silence
+            float envelope = (1 - t) * (f < attack ? (float)f / attack : 1);
+            Sint16 value = wave * envelope * note->volume * 32767;
+            for (int c = 0; c < sfx->channels; c++)
+                *p++ = value;
+        }
+    }
+
+    *out = samples;
+    return frames;
+}
+
+// runs on the audio thread once a buffer is mixed. the effects started
+// before it are in that buffer, which plays after the one ahead of it in
+// the device. a trigger racing a mix pass counts one buffer late at worst
+static void measure(void *data, Uint8 *stream, int length) {
+    (void)stream;
+    (void)length;
+    SoundEffects *sfx = data;
+    Uint64 now = SDL_GetPerformanceCounter();
+    double frequency = SDL_GetPerformanceFrequency();
+
+    for (int v = 0; v < SFX_VOICES; v++) {
+        if (!SDL_AtomicGet(&sfx->triggered[v]))
+            continue;
+
+        float ms = (now - sfx->trigger_time[v]) * 1000 / frequency +
+                   sfx->buffer_ms;
+        SDL_AtomicSet(&sfx->triggered[v], 0);
+
+        SDL_AtomicLock(&sfx->lock);
+        sfx->latency[sfx->latency_next] = ms;
+        sfx->latency_next = (sfx->latency_next + 1) % SFX_LATENCY_WINDOW;
+        if (sfx->latency_count < SFX_LATENCY_WINDOW)
+            sfx->latency_count++;
+        SDL_AtomicUnlock(&sfx->lock);
+    }
+}
+
+void sfx_init(SoundEffects *sfx, int buffer_samples) {
+    memset(sfx, 0, sizeof(*sfx));
+    Uint16 format;
+    if (!Mix_QuerySpec(&sfx->frequency, &format, &sfx->channels)) {
+        fprintf(stderr, "WARNING: no audio device for sound effects: %s\n",
+                SDL_GetError());
+        return;
+    }
+
+    sfx->buffer_ms = buffer_samples * 1000.0f / sfx->frequency;
+    for (int v = 0; v < SFX_VOICES; v++)
+        sfx->voice_effect[v] = -1;
+    Mix_SetPostMix(measure, sfx);
+}
+
+void sfx_load(SoundEffects *sfx) {
+    if (sfx->frequency == 0)
+        return;
+
+    for (int i = 0; i < SFX_COUNT; i++) {
+        int frames = synthesize(sfx, i, &sfx->samples[i]);
+        // the chunk plays straight from our buffer, which has the format of
+        // the device since Mix_OpenAudio was asked for AUDIO_S16SYS
+        if (frames > 0) {
+            sfx->chunks[i] = Mix_QuickLoad_RAW(
+                (Uint8 *)sfx->samples[i],
+                frames * sfx->channels * sizeof(Sint16));
+        }
+        if (sfx->chunks[i] == NULL) {
+            fprintf(stderr, "WARNING: failed to create sound effect %d: %s\n",
+                    i, SDL_GetError());
+        }
+    }
+    SDL_AtomicSet(&sfx->ready, 1);
+}
+
+void sfx_play(SoundEffects *sfx, int effect) {
+    if (!SDL_AtomicGet(&sfx->ready) || sfx->chunks[effect] == NULL) {
+        sfx->skipped++;
+        return;
+    }
+
+    int voice = -1;
+    for (int v = 0; v < SFX_VOICES; v++) {
+        if (!Mix_Playing(v)) {
+            voice = v;
+            break;
+        }
+    }
+
+    if (voice < 0) {
+        for (int v = 0; v < SFX_VOICES; v++) {
+            int playing = sfx->voice_effect[v];
+            if (playing > effect)
+                continue;
+            if (voice < 0 || playing < sfx->voice_effect[voice] ||
+                (playing == sfx->voice_effect[voice] &&
+                 sfx->voice_start[v] < sfx->voice_start[voice]))
+                voice = v;
+        }
+        if (voice < 0) {
+            sfx->skipped++;
+            return;
+        }
+        sfx->stolen++;
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    sfx->voice_effect[voice] = effect;
+    sfx->voice_start[voice] = now;
+    // playing on a busy channel cuts off what was there
+    if (Mix_PlayChannel(voice, sfx->chunks[effect], 0) < 0) {
+        sfx->skipped++;
+        return;
+    }
+    sfx->trigger_time[voice] = now;
+    SDL_AtomicSet(&sfx->triggered[voice], 1);
+    sfx->played++;
+}
+
+bool sfx_latency(SoundEffects *sfx, float *p50, float *max) {
+    float samples[SFX_LATENCY_WINDOW];
+    SDL_AtomicLock(&sfx->lock);
+    int count = sfx->latency_count;
+    memcpy(samples, sfx->latency, count * sizeof(float));
+    SDL_AtomicUnlock(&sfx->lock);
+    if (count == 0)
+        return false;
+
+    float p99;
+    percentiles(samples, count, p50, &p99, max);
+    return true;
+}
+
+void sfx_free(SoundEffects *sfx) {
+    if (sfx->frequency != 0) {
+        Mix_SetPostMix(NULL, NULL);
+        // the chunks must not be playing when they are freed
+        for (int v = 0; v < SFX_VOICES; v++)
+            Mix_HaltChannel(v);
+    }
+    for (int i = 0; i < SFX_COUNT; i++) {
+        if (sfx->chunks[i] != NULL)
+            Mix_FreeChunk(sfx->chunks[i]);
+        free(sfx->samples[i]);
+    }
+    memset(sfx, 0, sizeof(*sfx));
+}
@@ -0,0 +1,67 @@
+#ifndef SFX_H
+#define SFX_H
+
+// sound effects, synthesized straight into PCM chunks in the format of the
+// audio device when loaded, so playing one is a Mix_PlayChannel and nothing
+// else: no decoding, no file access and no allocation
+//
+// every mixer channel is a voice. when all are busy a new effect takes
+// over the least important one, the oldest of those, as long as it is not
+// more important than the new effect
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL_stdinc.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// also their priorities, higher steals lower
+#define SFX_ROTATE 0
+#define SFX_LOCK 1
+#define SFX_LINE 2
+#define SFX_GAME_OVER 3
+#define SFX_COUNT 4
+
+// the mixer channels the effects play on
+#define SFX_VOICES 4
+// latency samples the statistics cover
+#define SFX_LATENCY_WINDOW 64
+
+typedef struct {
+    Mix_Chunk *chunks[SFX_COUNT];
+    Sint16 *samples[SFX_COUNT];
+    // set once the chunks are there, effects played before are skipped
+    SDL_atomic_t ready;
+    int frequency;
+    int channels;
+    // time one mixer buffer takes to play
+    float buffer_ms;
+
+    int voice_effect[SFX_VOICES];
+    Uint64 voice_start[SFX_VOICES];
+    // a voice is marked when it starts an effect, and the audio thread
+    // measures the latency of the marked voices once it mixed them
+    Uint64 trigger_time[SFX_VOICES];
+    SDL_atomic_t triggered[SFX_VOICES];
+
+    // trigger to output times in ms, written by the audio thread
+    SDL_SpinLock lock;
+    float latency[SFX_LATENCY_WINDOW];
+    int latency_next;
+    int latency_count;
+
+    uint32_t played;
+    uint32_t stolen;
+    uint32_t skipped;
+} SoundEffects;
+
+// call after Mix_OpenAudio, buffer_samples is the chunk size it was given
+void sfx_init(SoundEffects *sfx, int buffer_samples);
+// builds the chunks, may run on another thread
+void sfx_load(SoundEffects *sfx);
+void sfx_play(SoundEffects *sfx, int effect);
+// percentiles of the trigger to output latency, false without samples
+bool sfx_latency(SoundEffects *sfx, float *p50, float *max);
+void sfx_free(SoundEffects *sfx);
+
+#endif
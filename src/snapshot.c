@@ -0,0 +1,296 @@
+#include "snapshot.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// nibbles of the cells that aren't a piece color
+#define NIBBLE_GARBAGE (PIECE_COUNT + 1)
+#define NIBBLE_LINE (PIECE_COUNT + 2)
+
+static const unsigned char unpacked_cells[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, CELL_GARBAGE, CELL_LINE};
+
+static uint8_t pack_cell(unsigned char cell) {
+    if (cell == CELL_GARBAGE)
+        return NIBBLE_GARBAGE;
+    if (cell == CELL_LINE)
+        return NIBBLE_LINE;
+    assert(cell <= PIECE_COUNT);
+    return cell;
+}
+
+static PackedPiece pack_piece(Piece piece) {
+    return (PackedPiece){.type = piece.type,
+                         .rotation = piece.rotation,
+                         .x = piece.x,
+                         .y = piece.y};
+}
+
+static Piece unpack_piece(PackedPiece piece) {
+    return (Piece){.type = piece.type,
+                   .x = piece.x,
+                   .y = piece.y,
+                   .rotation = piece.rotation};
+}
+
+static size_t align_slot(size_t size) {
+    return (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+}
+
+static void *add_block(SnapshotArena *arena, size_t slot_size) {
+    if (arena->block_count == arena->block_capacity) {
+        int capacity = arena->block_capacity ? arena->block_capacity * 2 : 16;
+        void **blocks = realloc(arena->blocks, capacity * sizeof(void *));
+        if (blocks == NULL)
+            return NULL;
+        arena->blocks = blocks;
+        arena->block_capacity = capacity;
+    }
+
+    void *block = malloc(slot_size * SNAPSHOT_BLOCK_SLOTS);
+    if (block != NULL)
+        arena->blocks[arena->block_count++] = block;
+    return block;
+}
+
+static bool grow_rows(SnapshotArena *arena) {
+    uint8_t *block = add_block(arena, arena->row_size);
+    if (block == NULL)
+        return false;
+    for (int i = SNAPSHOT_BLOCK_SLOTS - 1; i >= 0; i--) {
+        SnapshotRow *row = (SnapshotRow *)(block + i * arena->row_size);
+        row->next_free = arena->free_rows;
+        arena->free_rows = row;
+    }
+    arena->rows_free += SNAPSHOT_BLOCK_SLOTS;
+    return true;
+}
+
+static bool grow_snapshots(SnapshotArena *arena) {
+    uint8_t *block = add_block(arena, arena->snapshot_size);
+    if (block == NULL)
+        return false;
+    for (int i = SNAPSHOT_BLOCK_SLOTS - 1; i >= 0; i--) {
+        Snapshot *snapshot = (Snapshot *)(block + i * arena->snapshot_size);
+        snapshot->next_free = arena->free_snapshots;
+        arena->free_snapshots = snapshot;
+    }
+    arena->snapshots_free += SNAPSHOT_BLOCK_SLOTS;
+    return true;
+}
+
+static SnapshotRow *row_alloc(SnapshotArena *arena) {
+    if (arena->free_rows == NULL && !grow_rows(arena))
+        return NULL;
+    SnapshotRow *row = arena->free_rows;
+    arena->free_rows = row->next_free;
+    arena->rows_free--;
+    arena->rows_used++;
+    row->refs = 1;
+    return row;
+}
+
+static void row_release(SnapshotArena *arena, SnapshotRow *row) {
+    if (row == arena->empty || --row->refs > 0)
+        return;
+    row->next_free = arena->free_rows;
+    arena->free_rows = row;
+    arena->rows_free++;
+    arena->rows_used--;
+}
+
+bool snapshot_arena_init(SnapshotArena *arena, int width, int height) {
+    memset(arena, 0, sizeof(*arena));
+    if (!board_size_valid(width, height))
+        return false;
+    arena->width = width;
+    arena->height = height;
+    arena->row_size = align_slot(sizeof(SnapshotRow) + (width + 1) / 2);
+    arena->snapshot_size =
+        align_slot(sizeof(Snapshot) + height * sizeof(SnapshotRow *));
+
+    arena->empty = row_alloc(arena);
+    if (arena->empty == NULL) {
+        snapshot_arena_free(arena);
+        return false;
+    }
+    memset(arena->empty->cells, 0, (width + 1) / 2);
+    arena->rows_used = 0;
+    return true;
+}
+
+bool snapshot_arena_reserve(SnapshotArena *arena, int snapshots, int rows) {
+    while (arena->snapshots_free < snapshots) {
+        if (!grow_snapshots(arena))
+            return false;
+    }
+    while (arena->rows_free < rows) {
+        if (!grow_rows(arena))
+            return false;
+    }
+    return true;
+}
+
+static SnapshotRow *pack_row(SnapshotArena *arena, const Board *board,
+                             int y) {
+    if (board->rows[y] == 0)
+        return arena->empty;
+
+    SnapshotRow *row = row_alloc(arena);
+    if (row == NULL)
+        return NULL;
+    int w = board->width;
+    const unsigned char *cells = board->cells + y * w;
+    int x = 0;
+    for (; x + 1 < w; x += 2)
+        row->cells[x / 2] = pack_cell(cells[x]) | pack_cell(cells[x + 1]) << 4;
+    if (x < w)
+        row->cells[x / 2] = pack_cell(cells[x]);
+    return row;
+}
+
+static void unpack_row(const SnapshotArena *arena, Board *board, int y,
+                       const SnapshotRow *row) {
+    int w = board->width;
+    unsigned char *cells = board->cells + y * w;
+    if (row == arena->empty) {
+        memset(cells, 0, w);
+        board->rows[y] = 0;
+        board->fill[y] = 0;
+        return;
+    }
+
+    uint64_t bits = 0;
+    for (int x = 0; x < w; x++) {
+        int nibble = row->cells[x / 2] >> (x & 1) * 4 & 0xf;
+        cells[x] = unpacked_cells[nibble];
+        bits |= (uint64_t)(nibble != 0) << x;
+    }
+    board->rows[y] = bits;
+    board->fill[y] = __builtin_popcountll(bits);
+}
+
+static void share_rows(SnapshotArena *arena, Snapshot *snapshot,
+                       const Snapshot *base, int from, int to) {
+    for (int y = from; y < to; y++) {
+        SnapshotRow *row = base->rows[y];
+        if (row != arena->empty)
+            row->refs++;
+        snapshot->rows[y] = row;
+    }
+}
+
+Snapshot *snapshot_take(SnapshotArena *arena, GameState *state,
+                        const Snapshot *base) {
+    Board *board = &state->board;
+    assert(board->width == arena->width && board->height == arena->height);
+    assert(state->line_count <= SNAPSHOT_MAX_LINES);
+    if (arena->free_snapshots == NULL && !grow_snapshots(arena))
+        return NULL;
+    Snapshot *snapshot = arena->free_snapshots;
+
+    // only the changed rows are packed again, the others are shared
+    int top = 0;
+    int bottom = board->height - 1;
+    if (base != NULL) {
+        top = board->changed_top < 0 ? 0 : board->changed_top;
+        if (board->changed_bottom < bottom)
+            bottom = board->changed_bottom;
+    }
+    for (int y = top; y <= bottom; y++) {
+        snapshot->rows[y] = pack_row(arena, board, y);
+        if (snapshot->rows[y] == NULL) {
+            for (int i = top; i < y; i++)
+                row_release(arena, snapshot->rows[i]);
+            return NULL;
+        }
+    }
+    if (base != NULL) {
+        share_rows(arena, snapshot, base, 0, top);
+        share_rows(arena, snapshot, base, bottom < top ? top : bottom + 1,
+                   board->height);
+    }
+
+    arena->free_snapshots = snapshot->next_free;
+    arena->snapshots_free--;
+    arena->snapshots_used++;
+
+    snapshot->piece = pack_piece(state->piece);
+    snapshot->next_piece = pack_piece(state->next_piece);
+    for (int i = 0; i < state->line_count; i++)
+        snapshot->lines[i] = state->lines[i];
+    snapshot->line_count = state->line_count;
+    snapshot->clear_ticks = state->clear_ticks;
+    snapshot->clear_timer = state->clear_timer;
+    snapshot->buffered_input = state->buffered_input;
+    snapshot->fall = state->fall;
+    snapshot->yspeed = state->yspeed;
+    snapshot->over = state->over;
+    snapshot->score = state->score;
+    snapshot->lines_cleared = state->lines_cleared;
+    snapshot->rng = state->rng;
+
+    board->changed_top = board->height;
+    board->changed_bottom = -1;
+    return snapshot;
+}
+
+void snapshot_restore(const SnapshotArena *arena, GameState *state,
+                      const Snapshot *snapshot, const Snapshot *base) {
+    Board *board = &state->board;
+    assert(board->width == arena->width && board->height == arena->height);
+
+    int top = board->height;
+    int bottom = -1;
+    for (int y = 0; y < board->height; y++) {
+        // rows the board didn't change since base and base shares with
+        // snapshot are already right
+        if (base != NULL && base->rows[y] == snapshot->rows[y] &&
+            (y < board->changed_top || y > board->changed_bottom))
+            continue;
+        unpack_row(arena, board, y, snapshot->rows[y]);
+        if (top > y)
+            top = y;
+        bottom = y;
+    }
+    if (top < board->dirty_top)
+        board->dirty_top = top;
+    if (bottom > board->dirty_bottom)
+        board->dirty_bottom = bottom;
+    board->changed_top = board->height;
+    board->changed_bottom = -1;
+
+    state->piece = unpack_piece(snapshot->piece);
+    state->next_piece = unpack_piece(snapshot->next_piece);
+    for (int i = 0; i < snapshot->line_count; i++)
+        state->lines[i] = snapshot->lines[i];
+    state->line_count = snapshot->line_count;
+    state->clear_ticks = snapshot->clear_ticks;
+    state->clear_timer = snapshot->clear_timer;
+    state->buffered_input = snapshot->buffered_input;
+    state->fall = snapshot->fall;
+    state->yspeed = snapshot->yspeed;
+    state->over = snapshot->over;
+    state->score = snapshot->score;
+    state->lines_cleared = snapshot->lines_cleared;
+    state->rng = snapshot->rng;
+}
+
+void snapshot_release(SnapshotArena *arena, Snapshot *snapshot) {
+    if (snapshot == NULL)
+        return;
+    for (int y = 0; y < arena->height; y++)
+        row_release(arena, snapshot->rows[y]);
+    snapshot->next_free = arena->free_snapshots;
+    arena->free_snapshots = snapshot;
+    arena->snapshots_free++;
+    arena->snapshots_used--;
+}
+
+void snapshot_arena_free(SnapshotArena *arena) {
+    for (int i = 0; i < arena->block_count; i++)
+        free(arena->blocks[i]);
+    free(arena->blocks);
+    memset(arena, 0, sizeof(*arena));
+}
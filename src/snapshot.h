@@ -0,0 +1,113 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// positions of a game that can be restored later, for undo, trying out
+// what happens after another move, or walking a search tree. a snapshot
+// packs two cells into a byte and holds the rest of the state in a few
+// narrow fields
+//
+// rows are immutable once packed and shared between snapshots, a snapshot
+// taken from a base only packs the rows the board changed since the base
+// was taken or restored and points at the rows of the base for the rest.
+// every empty row is the same row of the arena. restoring rewrites only
+// the rows that differ from the base, so both cost what the board changed
+// and not its size
+//
+// snapshots and rows come from free lists of the arena, which get more
+// memory in blocks of SNAPSHOT_BLOCK_SLOTS when they run dry. once the
+// arena saw as many snapshots as are kept at once, or after
+// snapshot_arena_reserve, taking and releasing them allocates nothing
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+#define SNAPSHOT_BLOCK_SLOTS 256
+// a piece spans 4 rows, no lock completes more lines
+#define SNAPSHOT_MAX_LINES 4
+
+typedef struct SnapshotRow {
+    // snapshots pointing at the row, or the next free row while it is
+    // unused. the empty row of the arena isn't counted
+    union {
+        int refs;
+        struct SnapshotRow *next_free;
+    };
+    // cell x is in the low nibble of byte x / 2 when x is even, see
+    // pack_cell
+    uint8_t cells[];
+} SnapshotRow;
+
+typedef struct {
+    uint8_t type;
+    uint8_t rotation;
+    int8_t x;
+    int16_t y;
+} PackedPiece;
+
+typedef struct Snapshot {
+    PackedPiece piece;
+    PackedPiece next_piece;
+    uint16_t lines[SNAPSHOT_MAX_LINES];
+    uint16_t clear_ticks;
+    uint16_t clear_timer;
+    uint8_t line_count;
+    uint8_t buffered_input;
+    uint8_t fall;
+    uint8_t yspeed;
+    bool over;
+    uint32_t score;
+    uint32_t lines_cleared;
+    uint32_t rng;
+    struct Snapshot *next_free;
+    // one row per board row, top to bottom
+    SnapshotRow *rows[];
+} Snapshot;
+
+// every snapshot of an arena is of a board of the same size
+typedef struct {
+    int width;
+    int height;
+    size_t row_size;
+    size_t snapshot_size;
+    SnapshotRow *empty;
+    SnapshotRow *free_rows;
+    Snapshot *free_snapshots;
+    // every block allocated so far
+    void **blocks;
+    int block_count;
+    int block_capacity;
+    // handed out right now and waiting in the free lists
+    int snapshots_used;
+    int snapshots_free;
+    int rows_used;
+    int rows_free;
+} SnapshotArena;
+
+bool snapshot_arena_init(SnapshotArena *arena, int width, int height);
+
+// fills the free lists with room for that many snapshots and rows
+bool snapshot_arena_reserve(SnapshotArena *arena, int snapshots, int rows);
+
+// takes a snapshot of state and starts tracking the board changes anew.
+// base must be NULL or the snapshot that state was last taken as or
+// restored to, the rows the board didn't change since are shared with it.
+// returns NULL when out of memory
+Snapshot *snapshot_take(SnapshotArena *arena, GameState *state,
+                        const Snapshot *base);
+
+// puts state back to where it was when snapshot was taken, base as for
+// snapshot_take. the rows written are marked dirty
+void snapshot_restore(const SnapshotArena *arena, GameState *state,
+                      const Snapshot *snapshot, const Snapshot *base);
+
+// gives the snapshot back to the arena, together with the rows no other
+// snapshot uses. NULL is ignored
+void snapshot_release(SnapshotArena *arena, Snapshot *snapshot);
+
+// frees every block, snapshots still held become invalid
+void snapshot_arena_free(SnapshotArena *arena);
+
+#endif
@@ -0,0 +1,228 @@
+#include "spectate.h"
+
+#include <SDL2/SDL_error.h>
+#include <SDL2/SDL_timer.h>
+#include <stdlib.h>
+#include <string.h>
+
+// one tick of the games of a task, on the bot of the worker running it
+static void tick_games(void *arg, int worker) {
+    SpectatorTask *task = arg;
+    Spectator *spectator = task->spectator;
+    Bot *bot = &spectator->bots[worker];
+
+    for (int i = task->first; i < task->first + task->count; i++) {
+        GameState *state = &spectator->games[i];
+        if (state->over) {
+            if (++spectator->over_ticks[i] < SPECTATE_RESTART_TICKS)
+                continue;
+            // the next seed comes from the last game, so every board
+            // goes on with games of its own
+            uint32_t rng = state->rng;
+            game_state_reset(state, engine_rand(&rng));
+            spectator->over_ticks[i] = 0;
+            spectator->ready[i] = false;
+        }
+
+        if (!spectator->ready[i]) {
+            spectator->moves[i] = bot_decide(bot, state);
+            spectator->ready[i] = true;
+        }
+        game_state_apply_input(state,
+                               bot_input(&state->piece, spectator->moves[i]));
+        if (game_state_step(state) & STEP_LOCKED) {
+            spectator->ready[i] = false;
+            SDL_AtomicAdd(&spectator->pieces, 1);
+        }
+    }
+}
+
+static bool frame_init(SpectatorFrame *frame, int count, int width,
+                       int height) {
+    frame->cells = malloc((size_t)count * width * height);
+    frame->pieces = malloc(count * sizeof(Piece));
+    frame->over = malloc(count * sizeof(bool));
+    return frame->cells != NULL && frame->pieces != NULL &&
+           frame->over != NULL;
+}
+
+static void frame_free(SpectatorFrame *frame) {
+    free(frame->cells);
+    free(frame->pieces);
+    free(frame->over);
+}
+
+static void write_frame(Spectator *spectator, SpectatorFrame *frame) {
+    size_t size = (size_t)spectator->width * spectator->height;
+    for (int i = 0; i < spectator->count; i++) {
+        const GameState *state = &spectator->games[i];
+        memcpy(frame->cells + i * size, state->board.cells, size);
+        frame->pieces[i] = state->piece;
+        frame->over[i] = state->over;
+    }
+    frame->tick = SDL_AtomicGet(&spectator->ticks);
+}
+
+// writes the frame the screen isn't drawing and makes it the newest
+static void publish(Spectator *spectator) {
+    SDL_LockMutex(spectator->lock);
+    int back = 1 - spectator->front;
+    bool busy = spectator->reading == back;
+    SDL_UnlockMutex(spectator->lock);
+    if (busy) {
+        SDL_AtomicAdd(&spectator->skipped_frames, 1);
+        return;
+    }
+
+    // only this thread changes front, the screen takes the other frame
+    write_frame(spectator, &spectator->frames[back]);
+    SDL_LockMutex(spectator->lock);
+    spectator->front = back;
+    SDL_UnlockMutex(spectator->lock);
+}
+
+// runs the ticks on time. when they fall more than a quarter second behind
+// the rest is dropped, the way the play screen drops a stall
+static int run_games(void *data) {
+    Spectator *spectator = data;
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 tick_length = frequency / TICK_RATE;
+    Uint64 max_late = frequency / 4;
+    Uint64 next = SDL_GetPerformanceCounter();
+
+    while (!SDL_AtomicGet(&spectator->quit)) {
+        for (int i = 0; i < spectator->task_count; i++)
+            pool_push(&spectator->pool, 0, tick_games, &spectator->tasks[i]);
+        pool_run(&spectator->pool);
+        SDL_AtomicAdd(&spectator->ticks, 1);
+        publish(spectator);
+
+        next += tick_length;
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < next) {
+            SDL_Delay((next - now) * 1000 / frequency);
+        } else if (now - next > max_late) {
+            SDL_AtomicAdd(&spectator->dropped_ticks,
+                          (now - next) / tick_length);
+            next = now;
+        }
+    }
+    return 0;
+}
+
+bool spectator_init(Spectator *spectator, int count, int width, int height,
+                    int clear_ticks, uint32_t seed, int bot_depth,
+                    float bot_budget, const BotWeights *weights,
+                    int threads) {
+    memset(spectator, 0, sizeof(*spectator));
+    spectator->count = count;
+    spectator->width = width;
+    spectator->height = height;
+    spectator->reading = -1;
+
+    spectator->games = calloc(count, sizeof(GameState));
+    spectator->moves = calloc(count, sizeof(BotMove));
+    spectator->ready = calloc(count, sizeof(bool));
+    spectator->over_ticks = calloc(count, sizeof(int));
+    spectator->task_count =
+        (count + SPECTATE_TASK_GAMES - 1) / SPECTATE_TASK_GAMES;
+    spectator->tasks = calloc(spectator->task_count, sizeof(SpectatorTask));
+    if (spectator->games == NULL || spectator->moves == NULL ||
+        spectator->ready == NULL || spectator->over_ticks == NULL ||
+        spectator->tasks == NULL ||
+        !frame_init(&spectator->frames[0], count, width, height) ||
+        !frame_init(&spectator->frames[1], count, width, height)) {
+        SDL_SetError("out of memory");
+        spectator_free(spectator);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!game_state_init(&spectator->games[i], width, height, seed + i)) {
+            SDL_SetError("out of memory");
+            spectator_free(spectator);
+            return false;
+        }
+        spectator->games[i].clear_ticks = clear_ticks;
+    }
+    for (int i = 0; i < spectator->task_count; i++) {
+        spectator->tasks[i] = (SpectatorTask){
+            .spectator = spectator,
+            .first = i * SPECTATE_TASK_GAMES,
+            .count = SDL_min(SPECTATE_TASK_GAMES,
+                             count - i * SPECTATE_TASK_GAMES)};
+    }
+
+    // the searches stay on the worker that asked, each bot on one thread
+    if (!pool_init(&spectator->pool, threads)) {
+        spectator_free(spectator);
+        return false;
+    }
+    spectator->bots = calloc(spectator->pool.thread_count, sizeof(Bot));
+    if (spectator->bots == NULL) {
+        SDL_SetError("out of memory");
+        spectator_free(spectator);
+        return false;
+    }
+    spectator->bot_count = spectator->pool.thread_count;
+    for (int i = 0; i < spectator->bot_count; i++) {
+        if (!bot_init(&spectator->bots[i], width, height, bot_depth, 1)) {
+            spectator_free(spectator);
+            return false;
+        }
+        spectator->bots[i].weights = *weights;
+        spectator->bots[i].budget_ms = bot_budget;
+    }
+
+    spectator->lock = SDL_CreateMutex();
+    if (spectator->lock == NULL) {
+        spectator_free(spectator);
+        return false;
+    }
+    write_frame(spectator, &spectator->frames[0]);
+
+    spectator->thread = SDL_CreateThread(run_games, "spectator", spectator);
+    if (spectator->thread == NULL) {
+        spectator_free(spectator);
+        return false;
+    }
+    return true;
+}
+
+const SpectatorFrame *spectator_acquire(Spectator *spectator) {
+    SDL_LockMutex(spectator->lock);
+    spectator->reading = spectator->front;
+    SDL_UnlockMutex(spectator->lock);
+    return &spectator->frames[spectator->reading];
+}
+
+void spectator_release(Spectator *spectator) {
+    SDL_LockMutex(spectator->lock);
+    spectator->reading = -1;
+    SDL_UnlockMutex(spectator->lock);
+}
+
+void spectator_free(Spectator *spectator) {
+    if (spectator->thread != NULL) {
+        SDL_AtomicSet(&spectator->quit, 1);
+        SDL_WaitThread(spectator->thread, NULL);
+    }
+    for (int i = 0; i < spectator->bot_count; i++)
+        bot_free(&spectator->bots[i]);
+    free(spectator->bots);
+    pool_free(&spectator->pool);
+    if (spectator->games != NULL) {
+        for (int i = 0; i < spectator->count; i++)
+            game_state_free(&spectator->games[i]);
+    }
+    free(spectator->games);
+    free(spectator->moves);
+    free(spectator->ready);
+    free(spectator->over_ticks);
+    free(spectator->tasks);
+    frame_free(&spectator->frames[0]);
+    frame_free(&spectator->frames[1]);
+    if (spectator->lock != NULL)
+        SDL_DestroyMutex(spectator->lock);
+    memset(spectator, 0, sizeof(*spectator));
+}
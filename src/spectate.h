@@ -0,0 +1,100 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+// many bot games at once, for watching tournaments and demos. the games
+// advance at TICK_RATE on a thread of their own, which spreads every tick
+// over a task pool with a bot per worker. a game that ends starts over
+// with a new seed once it was shown for SPECTATE_RESTART_TICKS
+//
+// the screen never touches the games. after every tick the simulation
+// copies what there is to draw into one of two frames and publishes it,
+// the screen draws the newest published frame while the next tick is
+// written into the other one. a tick that finds the other frame still
+// being drawn isn't published, the screen just shows the one before
+// again
+
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bot.h"
+#include "engine.h"
+#include "pool.h"
+
+#define SPECTATE_MIN_GAMES 16
+#define SPECTATE_MAX_GAMES 256
+// games ticked by one pool task
+#define SPECTATE_TASK_GAMES 8
+#define SPECTATE_RESTART_TICKS (2 * TICK_RATE)
+
+// what the screen draws of every game
+typedef struct {
+    // width * height cells per game, one game after the other
+    unsigned char *cells;
+    Piece *pieces;
+    bool *over;
+    // tick of the simulation the frame shows
+    uint32_t tick;
+} SpectatorFrame;
+
+typedef struct Spectator Spectator;
+
+// the games of one pool task
+typedef struct {
+    Spectator *spectator;
+    int first;
+    int count;
+} SpectatorTask;
+
+struct Spectator {
+    int count;
+    int width;
+    int height;
+    GameState *games;
+    BotMove *moves;
+    bool *ready;
+    // ticks since a game ended
+    int *over_ticks;
+
+    TaskPool pool;
+    // one per worker, a bot searches on the thread that runs the task
+    Bot *bots;
+    int bot_count;
+    SpectatorTask *tasks;
+    int task_count;
+    SDL_Thread *thread;
+    SDL_atomic_t quit;
+
+    SpectatorFrame frames[2];
+    // the frame published last and the one the screen is drawing, -1 when
+    // it draws none. lock guards both
+    SDL_mutex *lock;
+    int front;
+    int reading;
+
+    // written by the simulation, read by the screen for the statistics
+    SDL_atomic_t ticks;
+    SDL_atomic_t dropped_ticks;
+    SDL_atomic_t skipped_frames;
+    SDL_atomic_t pieces;
+};
+
+// starts count games on boards of that size and the thread that runs them.
+// bot_depth, bot_budget and weights set up the bots as for --bot, threads
+// <= 0 uses one per core. returns false with the SDL error set on failure
+bool spectator_init(Spectator *spectator, int count, int width, int height,
+                    int clear_ticks, uint32_t seed, int bot_depth,
+                    float bot_budget, const BotWeights *weights,
+                    int threads);
+
+// the newest frame, the simulation doesn't write it until
+// spectator_release
+const SpectatorFrame *spectator_acquire(Spectator *spectator);
+void spectator_release(Spectator *spectator);
+
+// stops the simulation and frees everything
+void spectator_free(Spectator *spectator);
+
+#endif
@@ -0,0 +1,122 @@
+#include "sprite_batch.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void sprite_batch_init(SpriteBatch *batch, SDL_Renderer *renderer,
+                       SDL_Texture *atlas, const SDL_Rect *solid) {
+    memset(batch, 0, sizeof(*batch));
+    batch->renderer = renderer;
+    sprite_batch_set_atlas(batch, atlas, solid);
+}
+
+void sprite_batch_set_atlas(SpriteBatch *batch, SDL_Texture *atlas,
+                            const SDL_Rect *solid) {
+    sprite_batch_flush(batch);
+    batch->atlas = atlas;
+    if (atlas != NULL) {
+        SDL_QueryTexture(atlas, NULL, NULL, &batch->atlas_w, &batch->atlas_h);
+        batch->solid = *solid;
+    }
+}
+
+void sprite_batch_use_raster(SpriteBatch *batch, Raster *raster,
+                             const RasterImage *atlas_image) {
+    sprite_batch_flush(batch);
+    batch->raster = raster;
+    batch->atlas_image = atlas_image;
+}
+
+// makes room for one more quad, the buffers only grow so a steady frame
+// doesn't allocate
+static bool reserve_quad(SpriteBatch *batch) {
+    if (batch->quad_count < batch->quad_capacity)
+        return true;
+
+    int capacity = batch->quad_capacity ? batch->quad_capacity * 2 : 256;
+    SDL_Vertex *vertices =
+        realloc(batch->vertices, capacity * 4 * sizeof(SDL_Vertex));
+    if (vertices == NULL)
+        return false;
+    batch->vertices = vertices;
+
+    int *indices = realloc(batch->indices, capacity * 6 * sizeof(int));
+    if (indices == NULL)
+        return false;
+    batch->indices = indices;
+
+    // the index pattern never changes, fill it once
+    for (int i = batch->quad_capacity; i < capacity; i++) {
+        int *idx = batch->indices + i * 6;
+        idx[0] = i * 4;
+        idx[1] = i * 4 + 1;
+        idx[2] = i * 4 + 2;
+        idx[3] = i * 4 + 2;
+        idx[4] = i * 4 + 3;
+        idx[5] = i * 4;
+    }
+
+    batch->quad_capacity = capacity;
+    return true;
+}
+
+static void push_quad(SpriteBatch *batch, const SDL_FRect *dst, float u0,
+                      float v0, float u1, float v1, SDL_Color color) {
+    if (!reserve_quad(batch)) {
+        fprintf(stderr, "WARNING: sprite batch is out of memory\n");
+        return;
+    }
+
+    SDL_Vertex *v = batch->vertices + batch->quad_count * 4;
+    v[0] = (SDL_Vertex){{dst->x, dst->y}, color, {u0, v0}};
+    v[1] = (SDL_Vertex){{dst->x + dst->w, dst->y}, color, {u1, v0}};
+    v[2] = (SDL_Vertex){{dst->x + dst->w, dst->y + dst->h}, color, {u1, v1}};
+    v[3] = (SDL_Vertex){{dst->x, dst->y + dst->h}, color, {u0, v1}};
+    batch->quad_count++;
+}
+
+void sprite_batch_add(SpriteBatch *batch, const SDL_Rect *src,
+                      const SDL_FRect *dst, SDL_Color color) {
+    if (batch->raster != NULL) {
+        raster_blit(batch->raster, batch->atlas_image, src, dst);
+        return;
+    }
+
+    float w = batch->atlas_w;
+    float h = batch->atlas_h;
+    push_quad(batch, dst, src->x / w, src->y / h, (src->x + src->w) / w,
+              (src->y + src->h) / h, color);
+}
+
+void sprite_batch_fill(SpriteBatch *batch, const SDL_FRect *dst,
+                       SDL_Color color) {
+    if (batch->raster != NULL) {
+        raster_fill(batch->raster, dst, color);
+        return;
+    }
+
+    // sample the middle of the white tile so filtering never reaches the
+    // neighbouring tiles, the vertex color does the rest
+    float u = (batch->solid.x + batch->solid.w / 2.0f) / batch->atlas_w;
+    float v = (batch->solid.y + batch->solid.h / 2.0f) / batch->atlas_h;
+    push_quad(batch, dst, u, v, u, v, color);
+}
+
+void sprite_batch_flush(SpriteBatch *batch) {
+    if (batch->quad_count == 0)
+        return;
+
+    SDL_RenderGeometry(batch->renderer, batch->atlas, batch->vertices,
+                       batch->quad_count * 4, batch->indices,
+                       batch->quad_count * 6);
+    batch->draw_calls++;
+    batch->quad_count = 0;
+}
+
+void sprite_batch_free(SpriteBatch *batch) {
+    free(batch->vertices);
+    free(batch->indices);
+    memset(batch, 0, sizeof(*batch));
+}
@@ -0,0 +1,60 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_render.h>
+
+#include "raster.h"
+
+// layout of pallete.svg, one tile per piece color followed by a solid
+// white tile used for flat colored quads
+#define ATLAS_COLUMNS 8
+#define ATLAS_SOLID_TILE 7
+
+// collects textured quads from one atlas and submits them with a single
+// SDL_RenderGeometry call. with a raster set the quads are drawn into it
+// right away instead, untinted
+typedef struct {
+    SDL_Renderer *renderer;
+    SDL_Texture *atlas;
+    int atlas_w;
+    int atlas_h;
+    // region of the atlas that is solid white
+    SDL_Rect solid;
+    Raster *raster;
+    const RasterImage *atlas_image;
+    SDL_Vertex *vertices;
+    int *indices;
+    int quad_count;
+    int quad_capacity;
+    // geometry submissions since the counter was last reset
+    int draw_calls;
+} SpriteBatch;
+
+void sprite_batch_init(SpriteBatch *batch, SDL_Renderer *renderer,
+                       SDL_Texture *atlas, const SDL_Rect *solid);
+
+// draws from another atlas from now on, solid as for sprite_batch_init
+void sprite_batch_set_atlas(SpriteBatch *batch, SDL_Texture *atlas,
+                            const SDL_Rect *solid);
+
+// draws into raster from now on, atlas_image being the pixels of the
+// atlas. NULL goes back to the renderer
+void sprite_batch_use_raster(SpriteBatch *batch, Raster *raster,
+                             const RasterImage *atlas_image);
+
+// queues the src region of the atlas stretched over dst, tinted by color
+void sprite_batch_add(SpriteBatch *batch, const SDL_Rect *src,
+                      const SDL_FRect *dst, SDL_Color color);
+
+// queues dst filled with a flat color
+void sprite_batch_fill(SpriteBatch *batch, const SDL_FRect *dst,
+                       SDL_Color color);
+
+// submits every queued quad and empties the batch
+void sprite_batch_flush(SpriteBatch *batch);
+
+void sprite_batch_free(SpriteBatch *batch);
+
+#endif
@@ -0,0 +1,20 @@
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_float(const void *a, const void *b) {
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+void percentiles(const float *samples, int count, float *p50, float *p99,
+                 float *max) {
+    float sorted[STATS_MAX_SAMPLES];
+    memcpy(sorted, samples, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), compare_float);
+    *p50 = sorted[count / 2];
+    *p99 = sorted[(count * 99 + 99) / 100 - 1];
+    *max = sorted[count - 1];
+}
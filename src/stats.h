@@ -0,0 +1,17 @@
+#ifndef STATS_H
+#define STATS_H
+
+// summaries of the timing windows the game reports with --stats and in
+// the profiler overlay
+
+// most samples percentiles takes, the longest window kept anywhere
+#define STATS_MAX_SAMPLES 1024
+
+// the median, the 99th percentile and the largest of count samples,
+// 1 <= count <= STATS_MAX_SAMPLES. the 99th percentile is the smallest
+// sample that at least 99% of them are at or below. samples is left as
+// it is
+void percentiles(const float *samples, int count, float *p50, float *p99,
+                 float *max);
+
+#endif
@@ -0,0 +1,218 @@
+#include "svg.h"
+
+#include <SDL2/SDL_error.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_stdinc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "assets.h"
+
+// a cached strip is the magic, its width and height as native u32 and
+// the ARGB8888 rows without padding
+#define CACHE_MAGIC "TSVG"
+#define CACHE_PATH_MAX 1024
+
+static char *cache_dir;
+
+void svg_set_cache_dir(const char *dir) {
+    free(cache_dir);
+    cache_dir = dir != NULL ? strdup(dir) : NULL;
+}
+
+// FNV-1a, the same as the game state hash
+static uint64_t hash_data(const unsigned char *data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ data[i]) * 0x100000001b3;
+    return hash;
+}
+
+static void cache_path(char *path, size_t size, const char *name,
+                       uint64_t hash, int height) {
+    const char *base = strrchr(name, '/');
+    base = base != NULL ? base + 1 : name;
+    const char *dot = strrchr(base, '.');
+    int length = dot != NULL ? dot - base : (int)strlen(base);
+    snprintf(path, size, "%s%.*s-%016llx-%d.argb", cache_dir, length, base,
+             (unsigned long long)hash, height);
+}
+
+static SDL_Surface *cache_read(const char *path, int w, int h) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    char magic[4];
+    uint32_t size[2];
+    SDL_Surface *strip = NULL;
+    if (fread(magic, 4, 1, file) == 1 && memcmp(magic, CACHE_MAGIC, 4) == 0 &&
+        fread(size, sizeof(size), 1, file) == 1 && size[0] == (uint32_t)w &&
+        size[1] == (uint32_t)h)
+        strip = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32,
+                                               SDL_PIXELFORMAT_ARGB8888);
+    for (int y = 0; strip != NULL && y < h; y++) {
+        if (fread((uint8_t *)strip->pixels + y * strip->pitch, w * 4, 1,
+                  file) != 1) {
+            SDL_FreeSurface(strip);
+            strip = NULL;
+        }
+    }
+    fclose(file);
+    return strip;
+}
+
+// written under a name of its own and renamed, so another instance never
+// reads half a file
+static void cache_write(const char *path, const SDL_Surface *strip) {
+    // room for the pid after the longest path
+    char temp[CACHE_PATH_MAX + 16];
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+    FILE *file = fopen(temp, "wb");
+    if (file == NULL)
+        return;
+
+    uint32_t size[2] = {strip->w, strip->h};
+    bool ok = fwrite(CACHE_MAGIC, 4, 1, file) == 1 &&
+              fwrite(size, sizeof(size), 1, file) == 1;
+    for (int y = 0; ok && y < strip->h; y++) {
+        ok = fwrite((const uint8_t *)strip->pixels + y * strip->pitch,
+                    strip->w * 4, 1, file) == 1;
+    }
+    if (fclose(file) != 0 || !ok || rename(temp, path) != 0) {
+        fprintf(stderr, "WARNING: failed to cache %s\n", path);
+        remove(temp);
+    }
+}
+
+static SDL_Surface *rasterize_strip(SvgStrips *strips, const char *name,
+                                    const void *data, size_t length,
+                                    uint64_t hash, int size) {
+    int w = strips->columns * size;
+    char path[CACHE_PATH_MAX];
+    if (cache_dir != NULL) {
+        cache_path(path, sizeof(path), name, hash, size);
+        SDL_Surface *strip = cache_read(path, w, size);
+        if (strip != NULL) {
+            strips->cache_hits++;
+            return strip;
+        }
+    }
+
+    SDL_RWops *rw = SDL_RWFromConstMem(data, length);
+    SDL_Surface *image = rw != NULL ? IMG_LoadSizedSVG_RW(rw, w, size) : NULL;
+    if (rw != NULL)
+        SDL_RWclose(rw);
+    SDL_Surface *strip =
+        image != NULL
+            ? SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0)
+            : NULL;
+    SDL_FreeSurface(image);
+    if (strip == NULL)
+        return NULL;
+    strips->rasterized++;
+    if (cache_dir != NULL)
+        cache_write(path, strip);
+    return strip;
+}
+
+static int find_strip(const SvgStrips *strips, int size) {
+    for (int i = 0; i < strips->count; i++) {
+        if (strips->sizes[i] == size)
+            return i;
+    }
+    return -1;
+}
+
+static void copy_rows(SDL_Surface *to, int y, const SDL_Surface *from,
+                      int from_y, int rows) {
+    for (int i = 0; i < rows; i++) {
+        memcpy((uint8_t *)to->pixels + (y + i) * to->pitch,
+               (const uint8_t *)from->pixels + (from_y + i) * from->pitch,
+               from->w * 4);
+    }
+}
+
+bool svg_rasterize(SvgStrips *strips, const char *name, int columns,
+                   const int *sizes, int count) {
+    SvgStrips next = {.columns = columns,
+                      .cache_hits = strips->cache_hits,
+                      .rasterized = strips->rasterized};
+    int w = 0;
+    int h = 0;
+    for (int i = 0; i < count && next.count < SVG_MAX_STRIPS; i++) {
+        if (sizes[i] < 1 || find_strip(&next, sizes[i]) >= 0)
+            continue;
+        next.sizes[next.count] = sizes[i];
+        next.y[next.count++] = h;
+        w = SDL_max(w, columns * sizes[i]);
+        h += sizes[i];
+    }
+    if (next.count == 0) {
+        SDL_SetError("no size to rasterize %s at", name);
+        return false;
+    }
+
+    size_t length;
+    const void *data = asset_data(name, &length);
+    if (data == NULL)
+        return false;
+    uint64_t hash = hash_data(data, length);
+
+    // the rows nothing is copied into stay transparent
+    next.surface =
+        SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (next.surface == NULL)
+        return false;
+    for (int i = 0; i < next.count; i++) {
+        int size = next.sizes[i];
+        int old = strips->columns == columns ? find_strip(strips, size) : -1;
+        if (old >= 0) {
+            copy_rows(next.surface, next.y[i], strips->surface,
+                      strips->y[old], size);
+            continue;
+        }
+
+        SDL_Surface *strip =
+            rasterize_strip(&next, name, data, length, hash, size);
+        if (strip == NULL) {
+            SDL_FreeSurface(next.surface);
+            return false;
+        }
+        copy_rows(next.surface, next.y[i], strip, 0, size);
+        SDL_FreeSurface(strip);
+    }
+
+    svg_free(strips);
+    *strips = next;
+    return true;
+}
+
+bool svg_has_sizes(const SvgStrips *strips, const int *sizes, int count) {
+    for (int i = 0; i < count; i++) {
+        if (sizes[i] >= 1 && find_strip(strips, sizes[i]) < 0)
+            return false;
+    }
+    return true;
+}
+
+SDL_Rect svg_cell(const SvgStrips *strips, int size) {
+    int i = find_strip(strips, size);
+    if (i < 0) {
+        i = 0;
+        for (int j = 1; j < strips->count; j++) {
+            if (strips->sizes[j] > strips->sizes[i])
+                i = j;
+        }
+    }
+    return (SDL_Rect){0, strips->y[i], strips->sizes[i], strips->sizes[i]};
+}
+
+void svg_free(SvgStrips *strips) {
+    if (strips->surface != NULL)
+        SDL_FreeSurface(strips->surface);
+    memset(strips, 0, sizeof(*strips));
+}
@@ -0,0 +1,55 @@
+#ifndef SVG_H
+#define SVG_H
+
+// the images of the game are SVGs, rasterized at run time at exactly the
+// size they are drawn at, so copying a tile is a 1:1 blit. an image can be
+// needed at several sizes at once, like the tiles of the board and the
+// larger ones of the next piece, so it is rasterized into strips, one per
+// size, stacked top to bottom in one surface that becomes one texture
+//
+// rasterizing is what makes a resize slow. every strip is written to a
+// cache directory under a name made of the hash of the SVG and the size,
+// and read back from there the next time that size comes up
+
+#include <SDL2/SDL_rect.h>
+#include <SDL2/SDL_surface.h>
+#include <stdbool.h>
+
+#define SVG_MAX_STRIPS 32
+
+typedef struct {
+    // ARGB8888, NULL until the first svg_rasterize
+    SDL_Surface *surface;
+    // the image is columns times as wide as it is high. strip i is
+    // sizes[i] pixels high and starts at row y[i]
+    int columns;
+    int count;
+    int sizes[SVG_MAX_STRIPS];
+    int y[SVG_MAX_STRIPS];
+    // strips read from the cache and rasterized from the SVG so far
+    int cache_hits;
+    int rasterized;
+} SvgStrips;
+
+// where the strips are cached, NULL turns the cache off. the path is
+// copied and has to end with a separator
+void svg_set_cache_dir(const char *dir);
+
+// rasterizes the packed SVG name, which is columns times as wide as it is
+// high, at every size of sizes. strips it already has are copied over,
+// the others come from the cache or the SVG. returns false with the SDL
+// error set and strips left as they were on failure
+bool svg_rasterize(SvgStrips *strips, const char *name, int columns,
+                   const int *sizes, int count);
+
+// true when there is a strip of every size of sizes
+bool svg_has_sizes(const SvgStrips *strips, const int *sizes, int count);
+
+// the first square of the strip of that size, or of the largest strip
+// when there is none. the squares of a strip follow each other to the
+// right
+SDL_Rect svg_cell(const SvgStrips *strips, int size);
+
+void svg_free(SvgStrips *strips);
+
+#endif
@@ -0,0 +1,134 @@
+#include "text.h"
+
+#include <SDL2/SDL_surface.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+void text_cache_init(TextCache *cache, SDL_Renderer *renderer, TTF_Font *font) {
+    memset(cache, 0, sizeof(*cache));
+    cache->renderer = renderer;
+    cache->font = font;
+}
+
+static bool entry_used(const TextEntry *entry) {
+    return entry->texture != NULL || entry->image.pixels != NULL;
+}
+
+static void entry_free(TextEntry *entry) {
+    if (entry->texture != NULL)
+        SDL_DestroyTexture(entry->texture);
+    raster_image_free(&entry->image);
+    entry->texture = NULL;
+}
+
+static bool entry_matches(const TextEntry *entry, const char *text, int size,
+                          SDL_Color color) {
+    return entry_used(entry) && entry->size == size &&
+           entry->color.r == color.r && entry->color.g == color.g &&
+           entry->color.b == color.b && entry->color.a == color.a &&
+           strncmp(entry->text, text, TEXT_MAX_LENGTH - 1) == 0;
+}
+
+const TextEntry *text_cache_get(TextCache *cache, const char *text, int size,
+                                SDL_Color color) {
+    cache->clock++;
+
+    TextEntry *victim = &cache->entries[0];
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        TextEntry *entry = &cache->entries[i];
+        if (entry_matches(entry, text, size, color)) {
+            entry->last_used = cache->clock;
+            return entry;
+        }
+
+        if (!entry_used(entry)) {
+            if (entry_used(victim))
+                victim = entry;
+        } else if (entry_used(victim) &&
+                   entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+
+    // miss, rasterize into the free or least recently used slot
+    TextEntry entry = {.size = size, .color = color};
+    snprintf(entry.text, sizeof(entry.text), "%s", text);
+
+    TTF_SetFontSize(cache->font, size);
+    SDL_Surface *surface = TTF_RenderText_Solid(cache->font, entry.text, color);
+    if (surface == NULL)
+        return NULL;
+
+    bool ok;
+    if (cache->raster != NULL) {
+        ok = raster_image_from_surface(&entry.image, surface);
+    } else {
+        entry.texture = SDL_CreateTextureFromSurface(cache->renderer, surface);
+        ok = entry.texture != NULL;
+    }
+    entry.w = surface->w;
+    entry.h = surface->h;
+    SDL_FreeSurface(surface);
+    if (!ok)
+        return NULL;
+
+    entry_free(victim);
+
+    entry.last_used = cache->clock;
+    *victim = entry;
+    cache->rasterized++;
+    return victim;
+}
+
+void text_draw(TextCache *cache, const char *text, int size, SDL_Color color,
+               const SDL_Rect *dst) {
+    const TextEntry *entry = text_cache_get(cache, text, size, color);
+    if (entry == NULL)
+        return;
+
+    if (cache->raster != NULL) {
+        raster_blit(cache->raster, &entry->image, NULL,
+                    &(SDL_FRect){dst->x, dst->y, dst->w, dst->h});
+    } else {
+        SDL_RenderCopy(cache->renderer, entry->texture, NULL, dst);
+        cache->draw_calls++;
+    }
+}
+
+int text_draw_glyphs(TextCache *cache, const char *text, int size,
+                     SDL_Color color, int x, int y) {
+    int start = x;
+    char glyph[2] = {0};
+
+    for (const char *c = text; *c != '\0'; c++) {
+        glyph[0] = *c;
+        const TextEntry *entry = text_cache_get(cache, glyph, size, color);
+        if (entry == NULL)
+            continue;
+
+        if (cache->raster != NULL) {
+            raster_blit(cache->raster, &entry->image, NULL,
+                        &(SDL_FRect){x, y, entry->w, entry->h});
+        } else {
+            SDL_RenderCopy(cache->renderer, entry->texture, NULL,
+                           &(SDL_Rect){x, y, entry->w, entry->h});
+            cache->draw_calls++;
+        }
+        x += entry->w;
+    }
+
+    return x - start;
+}
+
+void text_cache_use_raster(TextCache *cache, Raster *raster) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++)
+        entry_free(&cache->entries[i]);
+    cache->raster = raster;
+}
+
+void text_cache_free(TextCache *cache) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++)
+        entry_free(&cache->entries[i]);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,64 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <SDL2/SDL_pixels.h>
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdint.h>
+
+#include "raster.h"
+
+#define TEXT_CACHE_SIZE 64
+// longer strings are cut
+#define TEXT_MAX_LENGTH 64
+
+// rasterized string kept across frames
+typedef struct {
+    char text[TEXT_MAX_LENGTH];
+    int size;
+    SDL_Color color;
+    // one of them is set, image when the cache draws into a raster
+    SDL_Texture *texture;
+    RasterImage image;
+    int w;
+    int h;
+    uint32_t last_used;
+} TextEntry;
+
+// textures keyed by (text, font size, color), the least recently used entry
+// is replaced once the cache is full
+typedef struct {
+    SDL_Renderer *renderer;
+    TTF_Font *font;
+    Raster *raster;
+    TextEntry entries[TEXT_CACHE_SIZE];
+    uint32_t clock;
+    uint32_t rasterized;
+    // copies issued since the counter was last reset
+    int draw_calls;
+} TextCache;
+
+void text_cache_init(TextCache *cache, SDL_Renderer *renderer, TTF_Font *font);
+
+// draws into raster from now on, NULL goes back to the renderer. the
+// cached strings are dropped
+void text_cache_use_raster(TextCache *cache, Raster *raster);
+
+// returns the cached entry for the text, rasterizing it on a miss. NULL if
+// the text could not be rendered
+const TextEntry *text_cache_get(TextCache *cache, const char *text, int size,
+                                SDL_Color color);
+
+// draws the whole string stretched into dst
+void text_draw(TextCache *cache, const char *text, int size, SDL_Color color,
+               const SDL_Rect *dst);
+
+// draws the string glyph by glyph at its natural size starting at (x, y)
+// and returns the width drawn. meant for text that changes often, like
+// numbers, since every glyph is rasterized only once
+int text_draw_glyphs(TextCache *cache, const char *text, int size,
+                     SDL_Color color, int x, int y);
+
+void text_cache_free(TextCache *cache);
+
+#endif
@@ -0,0 +1,509 @@
+#include "versus.h"
+
+#include <SDL2/SDL_timer.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+#define PACKET_MAGIC 0x53525654 // "TVRS"
+// magic, seed, tick, ack, advantage, hash tick, hash, first input, count
+#define PACKET_HEADER 37
+
+// garbage rows sent by clearing 0-4 lines
+static const int garbage_rows[5] = {0, 0, 1, 2, 4};
+
+bool match_init(Match *match, int width, int height, uint32_t seed) {
+    memset(match, 0, sizeof(*match));
+    bool ok = true;
+    for (int p = 0; p < VERSUS_PLAYERS; p++)
+        ok = game_state_init(&match->players[p], width, height, seed) && ok;
+    if (!ok) {
+        match_free(match);
+        return false;
+    }
+    match_reset(match, seed);
+    return true;
+}
+
+void match_reset(Match *match, uint32_t seed) {
+    // both players get the same pieces, the holes come from a sequence of
+    // their own
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        game_state_reset(&match->players[p], seed);
+        match->pending[p] = 0;
+    }
+    match->garbage_rng = seed ^ 0x85ebca6bu;
+    if (match->garbage_rng == 0)
+        match->garbage_rng = 1;
+    match->tick = 0;
+    match->winner = -1;
+}
+
+void match_step(Match *match, const int inputs[VERSUS_PLAYERS],
+                int events[VERSUS_PLAYERS]) {
+    for (int p = 0; p < VERSUS_PLAYERS; p++)
+        events[p] = 0;
+    if (match->winner >= 0)
+        return;
+
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        GameState *state = &match->players[p];
+        // lines are counted once they collapse unless they stay on the
+        // board for a while
+        uint32_t cleared = state->lines_cleared;
+        game_state_apply_input(state, inputs[p]);
+        events[p] = game_state_step(state);
+        if (!(events[p] & STEP_LOCKED) || (events[p] & STEP_OVER))
+            continue;
+
+        int *pending = &match->pending[p];
+        if (events[p] & STEP_LINES) {
+            int lines = state->line_count + state->lines_cleared - cleared;
+            int sent = garbage_rows[SDL_min(lines, 4)];
+            int cancelled = SDL_min(*pending, sent);
+            *pending -= cancelled;
+            match->pending[1 - p] += sent - cancelled;
+        } else if (*pending > 0) {
+            int hole = engine_rand(&match->garbage_rng) % state->board.width;
+            game_state_add_garbage(state, *pending, hole);
+            *pending = 0;
+            if (state->over)
+                events[p] |= STEP_OVER;
+        }
+    }
+
+    bool over[VERSUS_PLAYERS];
+    for (int p = 0; p < VERSUS_PLAYERS; p++)
+        over[p] = match->players[p].over;
+    if (over[0] && over[1])
+        match->winner = VERSUS_PLAYERS;
+    else if (over[0] || over[1])
+        match->winner = over[0] ? 1 : 0;
+    match->tick++;
+}
+
+static uint64_t fnv(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+// hashes the parts of a game that decide how it goes on, except for the
+// board
+static uint64_t hash_scalars(uint64_t hash, const GameState *state) {
+    uint32_t scalars[] = {state->piece.type,
+                          state->piece.x,
+                          state->piece.y,
+                          state->piece.rotation,
+                          state->next_piece.type,
+                          state->fall,
+                          state->score,
+                          state->lines_cleared,
+                          state->rng,
+                          state->line_count,
+                          state->clear_timer,
+                          state->buffered_input,
+                          state->over};
+    return fnv(hash, scalars, sizeof(scalars));
+}
+
+static uint64_t hash_match_scalars(uint64_t hash, const Match *match) {
+    uint32_t scalars[] = {match->pending[0], match->pending[1],
+                          match->garbage_rng, match->tick, match->winner};
+    return fnv(hash, scalars, sizeof(scalars));
+}
+
+uint64_t match_hash(const Match *match) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        const Board *board = &match->players[p].board;
+        hash = hash_scalars(hash, &match->players[p]);
+        hash = fnv(hash, board->cells, (size_t)board->width * board->height);
+    }
+    return hash_match_scalars(hash, match);
+}
+
+void match_free(Match *match) {
+    for (int p = 0; p < VERSUS_PLAYERS; p++)
+        game_state_free(&match->players[p]);
+}
+
+static bool snapshot_alloc(MatchSnapshot *snapshot, int width, int height) {
+    bool ok = true;
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        snapshot->cells[p] = malloc((size_t)width * height);
+        snapshot->rows[p] = malloc(height * sizeof(uint64_t));
+        snapshot->fill[p] = malloc(height * sizeof(int));
+        ok = ok && snapshot->cells[p] != NULL && snapshot->rows[p] != NULL &&
+             snapshot->fill[p] != NULL;
+    }
+    return ok;
+}
+
+static void snapshot_free(MatchSnapshot *snapshot) {
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        free(snapshot->cells[p]);
+        free(snapshot->rows[p]);
+        free(snapshot->fill[p]);
+    }
+}
+
+static void snapshot_save(MatchSnapshot *snapshot, const Match *match) {
+    snapshot->match = *match;
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        const GameState *state = &match->players[p];
+        const Board *board = &state->board;
+        memcpy(snapshot->lines[p], state->lines,
+               state->line_count * sizeof(int));
+
+        int top = 0;
+        while (top < board->height && board->rows[top] == 0)
+            top++;
+        int rows = board->height - top;
+        snapshot->top[p] = top;
+        memcpy(snapshot->cells[p], board->cells + top * board->width,
+               (size_t)rows * board->width);
+        memcpy(snapshot->rows[p], board->rows + top, rows * sizeof(uint64_t));
+        memcpy(snapshot->fill[p], board->fill + top, rows * sizeof(int));
+    }
+}
+
+static void snapshot_restore(const MatchSnapshot *snapshot, Match *match) {
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        GameState *state = &match->players[p];
+        Board *board = &state->board;
+        // the rows above the stack of the snapshot are empty there
+        int top = 0;
+        while (top < board->height && board->rows[top] == 0)
+            top++;
+        int snapshot_top = snapshot->top[p];
+        if (top < snapshot_top) {
+            int rows = snapshot_top - top;
+            memset(board->cells + top * board->width, 0,
+                   (size_t)rows * board->width);
+            memset(board->rows + top, 0, rows * sizeof(uint64_t));
+            memset(board->fill + top, 0, rows * sizeof(int));
+        }
+
+        int rows = board->height - snapshot_top;
+        memcpy(board->cells + snapshot_top * board->width,
+               snapshot->cells[p], (size_t)rows * board->width);
+        memcpy(board->rows + snapshot_top, snapshot->rows[p],
+               rows * sizeof(uint64_t));
+        memcpy(board->fill + snapshot_top, snapshot->fill[p],
+               rows * sizeof(int));
+
+        // everything but the memory the game points to comes back
+        Board live = *board;
+        int *lines = state->lines;
+        *state = snapshot->match.players[p];
+        state->board = live;
+        state->lines = lines;
+        memcpy(state->lines, snapshot->lines[p],
+               state->line_count * sizeof(int));
+        board->dirty_top = SDL_min(top, snapshot_top);
+        board->dirty_bottom = board->height - 1;
+        board->changed_top = SDL_min(board->changed_top, board->dirty_top);
+        board->changed_bottom = board->height - 1;
+    }
+
+    match->pending[0] = snapshot->match.pending[0];
+    match->pending[1] = snapshot->match.pending[1];
+    match->garbage_rng = snapshot->match.garbage_rng;
+    match->tick = snapshot->match.tick;
+    match->winner = snapshot->match.winner;
+}
+
+// match_hash of the match the snapshot was taken of
+static uint64_t snapshot_hash(const MatchSnapshot *snapshot) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (int p = 0; p < VERSUS_PLAYERS; p++) {
+        const GameState *state = &snapshot->match.players[p];
+        int width = state->board.width;
+        hash = hash_scalars(hash, state);
+        // the empty rows above the stack, xor with 0 changes nothing
+        for (size_t i = 0; i < (size_t)snapshot->top[p] * width; i++)
+            hash *= UINT64_C(0x100000001b3);
+        hash = fnv(hash, snapshot->cells[p],
+                   (size_t)(state->board.height - snapshot->top[p]) * width);
+    }
+    return hash_match_scalars(hash, &snapshot->match);
+}
+
+bool versus_init(Versus *versus, int width, int height, int clear_ticks,
+                 uint32_t seed, int local_port, const char *host, int port,
+                 LinkConditions link) {
+    memset(versus, 0, sizeof(*versus));
+    if (local_port == port) {
+        errno = EADDRINUSE;
+        return false;
+    }
+    versus->local = local_port < port ? 0 : 1;
+    versus->remote = 1 - versus->local;
+    versus->seed = seed;
+    versus->next_hash = VERSUS_HASH_INTERVAL;
+
+    if (!match_init(&versus->match, width, height, seed))
+        return false;
+    for (int p = 0; p < VERSUS_PLAYERS; p++)
+        versus->match.players[p].clear_ticks = clear_ticks;
+
+    bool ok = true;
+    for (int i = 0; i < ROLLBACK_WINDOW; i++)
+        ok = snapshot_alloc(&versus->snapshots[i], width, height) && ok;
+    if (!ok || !net_open(&versus->net, local_port, host, port, link)) {
+        int error = errno;
+        versus_free(versus);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+static void put32(uint8_t *p, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        p[i] = value >> (8 * i);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void send_inputs(Versus *versus) {
+    uint8_t packet[PACKET_HEADER + VERSUS_PACKET_INPUTS];
+    uint32_t tick = versus->match.tick;
+    uint32_t first = versus->acked;
+    int count = SDL_min(tick - first, VERSUS_PACKET_INPUTS);
+    // the newest confirmed hash, if it wasn't skipped
+    uint32_t hash_tick = versus->next_hash - VERSUS_HASH_INTERVAL;
+    int h = hash_tick / VERSUS_HASH_INTERVAL % VERSUS_HASHES;
+    uint64_t hash = versus->hashes[h];
+    if (versus->hash_ticks[h] != hash_tick)
+        hash_tick = 0;
+
+    put32(packet, PACKET_MAGIC);
+    put32(packet + 4, versus->seed);
+    put32(packet + 8, tick);
+    put32(packet + 12, versus->confirmed);
+    put32(packet + 16, tick - versus->remote_tick);
+    put32(packet + 20, hash_tick);
+    put32(packet + 24, hash);
+    put32(packet + 28, hash >> 32);
+    put32(packet + 32, first);
+    packet[36] = count;
+    for (int i = 0; i < count; i++) {
+        packet[PACKET_HEADER + i] =
+            versus->inputs[versus->local][(first + i) % VERSUS_HISTORY];
+    }
+    net_send(&versus->net, packet, PACKET_HEADER + count);
+}
+
+// compares the hashes of slot h once both sides have one for the same tick
+static void compare_hashes(Versus *versus, int h) {
+    uint32_t tick = versus->hash_ticks[h];
+    if (tick == 0 || tick != versus->remote_hash_ticks[h])
+        return;
+
+    versus->hash_checks++;
+    if (versus->hashes[h] != versus->remote_hashes[h]) {
+        if (versus->desyncs == 0) {
+            fprintf(stderr, "WARNING: versus match out of sync at tick %u\n",
+                    tick);
+        }
+        versus->desyncs++;
+    }
+}
+
+// takes in the packets of the peer, returns the first tick whose remote
+// input was predicted wrong, or the current tick when all were right
+static uint32_t receive_inputs(Versus *versus) {
+    uint32_t wrong = versus->match.tick;
+    uint8_t packet[NET_MAX_PACKET];
+    int size;
+    while ((size = net_receive(&versus->net, packet, sizeof(packet))) > 0) {
+        if (size < PACKET_HEADER || get32(packet) != PACKET_MAGIC ||
+            size < PACKET_HEADER + packet[36])
+            continue;
+
+        if (!versus->connected) {
+            // player 0 deals, nothing was simulated yet
+            uint32_t seed = get32(packet + 4);
+            if (versus->local == 1 && seed != versus->seed) {
+                versus->seed = seed;
+                match_reset(&versus->match, seed);
+            }
+            versus->connected = true;
+        }
+
+        uint32_t tick = get32(packet + 8);
+        if ((int32_t)(tick - versus->remote_tick) > 0) {
+            versus->remote_tick = tick;
+            versus->remote_advantage = (int32_t)get32(packet + 16);
+        }
+        uint32_t ack = get32(packet + 12);
+        if ((int32_t)(ack - versus->acked) > 0)
+            versus->acked = ack;
+
+        uint32_t hash_tick = get32(packet + 20);
+        int h = hash_tick / VERSUS_HASH_INTERVAL % VERSUS_HASHES;
+        if (hash_tick != 0 && versus->remote_hash_ticks[h] != hash_tick) {
+            versus->remote_hash_ticks[h] = hash_tick;
+            versus->remote_hashes[h] =
+                get32(packet + 24) | (uint64_t)get32(packet + 28) << 32;
+            compare_hashes(versus, h);
+        }
+
+        // only inputs that follow the confirmed ones without a gap count
+        uint32_t first = get32(packet + 32);
+        int count = packet[36];
+        for (int i = 0; i < count; i++) {
+            uint32_t t = first + i;
+            if (t != versus->confirmed)
+                continue;
+
+            uint8_t *input =
+                &versus->inputs[versus->remote][t % VERSUS_HISTORY];
+            uint8_t real = packet[PACKET_HEADER + i];
+            if (t < versus->match.tick && *input != real && t < wrong)
+                wrong = t;
+            *input = real;
+            versus->confirmed++;
+        }
+    }
+    return wrong;
+}
+
+// held soft drop repeats every tick, everything else is a tap. so the
+// remote player most likely keeps holding soft drop and presses nothing
+// else
+static uint8_t predict(const Versus *versus) {
+    if (versus->confirmed == 0)
+        return INPUT_NONE;
+    uint32_t last = (versus->confirmed - 1) % VERSUS_HISTORY;
+    return versus->inputs[versus->remote][last] & INPUT_SOFT_DROP;
+}
+
+static void simulate(Versus *versus, int events[VERSUS_PLAYERS]) {
+    Match *match = &versus->match;
+    uint32_t t = match->tick;
+    if (t >= versus->confirmed)
+        versus->inputs[versus->remote][t % VERSUS_HISTORY] = predict(versus);
+    snapshot_save(&versus->snapshots[t % ROLLBACK_WINDOW], match);
+
+    int inputs[VERSUS_PLAYERS];
+    for (int p = 0; p < VERSUS_PLAYERS; p++)
+        inputs[p] = versus->inputs[p][t % VERSUS_HISTORY];
+    match_step(match, inputs, events);
+}
+
+static void rollback(Versus *versus, uint32_t tick) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    Match *match = &versus->match;
+    uint32_t present = match->tick;
+    snapshot_restore(&versus->snapshots[tick % ROLLBACK_WINDOW], match);
+
+    int events[VERSUS_PLAYERS];
+    while (match->tick < present && match->winner < 0)
+        simulate(versus, events);
+
+    versus->rollbacks++;
+    versus->resimulated += present - tick;
+    versus->max_rollback = SDL_max(versus->max_rollback, present - tick);
+    versus->rollback_ms += (double)(SDL_GetPerformanceCounter() - start) *
+                           1000 / SDL_GetPerformanceFrequency();
+    versus->rolled_back = true;
+}
+
+// hashes the states every remote input before is known of
+static void hash_confirmed(Versus *versus) {
+    const Match *match = &versus->match;
+    while (versus->next_hash <= versus->confirmed &&
+           versus->next_hash < match->tick) {
+        uint32_t tick = versus->next_hash;
+        versus->next_hash += VERSUS_HASH_INTERVAL;
+        // too old to be in the ring anymore
+        if (tick + ROLLBACK_WINDOW <= match->tick)
+            continue;
+
+        // the snapshot is the state before the tick
+        int h = tick / VERSUS_HASH_INTERVAL % VERSUS_HASHES;
+        versus->hash_ticks[h] = tick;
+        versus->hashes[h] =
+            snapshot_hash(&versus->snapshots[tick % ROLLBACK_WINDOW]);
+        compare_hashes(versus, h);
+    }
+}
+
+bool versus_tick(Versus *versus, int input, int events[VERSUS_PLAYERS]) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    Match *match = &versus->match;
+    versus->rolled_back = false;
+
+    uint32_t wrong = receive_inputs(versus);
+    if (wrong < match->tick)
+        rollback(versus, wrong);
+    hash_confirmed(versus);
+
+    // wait for the peer to show up, for inputs to roll back to, for the
+    // peer to get the local inputs it misses, and now and then for the
+    // peer to catch up when it lags behind
+    bool wait = !versus->connected || match->winner >= 0;
+    if ((int32_t)(match->tick - versus->confirmed) >= ROLLBACK_WINDOW ||
+        match->tick - versus->acked >= VERSUS_PACKET_INPUTS) {
+        versus->stalls++;
+        wait = true;
+    }
+    // half the difference is how far this side is ahead for real, the
+    // average keeps jitter from making both sides wait in turns
+    int advantage = (int)(match->tick - versus->remote_tick);
+    versus->drift +=
+        ((advantage - versus->remote_advantage) / 2.0f - versus->drift) / 16;
+    if (!wait && versus->drift >= 1 &&
+        match->tick - versus->last_sync >= VERSUS_SYNC_INTERVAL) {
+        versus->last_sync = match->tick;
+        versus->sync_waits++;
+        wait = true;
+    }
+
+    if (!wait) {
+        versus->inputs[versus->local][match->tick % VERSUS_HISTORY] = input;
+        simulate(versus, events);
+    }
+    send_inputs(versus);
+
+    versus->tick_ms[versus->tick_next] =
+        (double)(SDL_GetPerformanceCounter() - start) * 1000 /
+        SDL_GetPerformanceFrequency();
+    versus->tick_next = (versus->tick_next + 1) % VERSUS_TIMES;
+    if (versus->tick_count < VERSUS_TIMES)
+        versus->tick_count++;
+    return !wait;
+}
+
+bool versus_finished(const Versus *versus) {
+    return versus->match.winner >= 0 &&
+           versus->confirmed >= versus->match.tick;
+}
+
+bool versus_tick_times(const Versus *versus, float *p50, float *p99,
+                       float *max) {
+    int count = versus->tick_count;
+    if (count == 0)
+        return false;
+
+    percentiles(versus->tick_ms, count, p50, p99, max);
+    return true;
+}
+
+void versus_free(Versus *versus) {
+    net_close(&versus->net);
+    match_free(&versus->match);
+    for (int i = 0; i < ROLLBACK_WINDOW; i++)
+        snapshot_free(&versus->snapshots[i]);
+}
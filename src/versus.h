@@ -0,0 +1,139 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+// head to head play between two instances of the game. both simulate the
+// whole match, the local game and the remote one, and exchange nothing but
+// their inputs. clearing 2, 3 or 4 lines sends 1, 2 or 4 garbage rows to
+// the opponent, which first cancel the rows still waiting to rise into the
+// own board and rise at the next lock without a clear
+//
+// waiting for the remote input of every tick would add a round trip to
+// every move, so the game runs ahead on a prediction of the remote input
+// instead. a compact snapshot of the match is kept for each of the last
+// ROLLBACK_WINDOW ticks, and when the real input of a tick turns out to be
+// different from the prediction the match is restored to that tick and
+// simulated again up to the present. the game waits when it gets
+// ROLLBACK_WINDOW ticks ahead of the remote inputs it has
+//
+// every packet carries all inputs the peer hasn't acknowledged yet, so a
+// lost packet costs nothing as long as a later one makes it. confirmed
+// states are hashed every VERSUS_HASH_INTERVAL ticks and compared with the
+// peer to catch a desync
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine.h"
+#include "net.h"
+
+#define VERSUS_PLAYERS 2
+// 200ms at TICK_RATE
+#define ROLLBACK_WINDOW 12
+// inputs kept per player, indexed by tick
+#define VERSUS_HISTORY 256
+#define VERSUS_PACKET_INPUTS 128
+#define VERSUS_HASH_INTERVAL 60
+#define VERSUS_HASHES 16
+// the game waits a tick at most once every VERSUS_SYNC_INTERVAL ticks to
+// let the peer catch up
+#define VERSUS_SYNC_INTERVAL 10
+#define VERSUS_DEFAULT_PORT 7777
+// tick times the statistics cover
+#define VERSUS_TIMES 1024
+
+typedef struct {
+    GameState players[VERSUS_PLAYERS];
+    // garbage rows waiting to rise into the board of each player
+    int pending[VERSUS_PLAYERS];
+    uint32_t garbage_rng;
+    // ticks simulated
+    uint32_t tick;
+    // player that won, -1 while both play and VERSUS_PLAYERS for a draw
+    int winner;
+} Match;
+
+// a match as it was before some tick. the games are copied without their
+// boards, which only keep the rows from the top of the stack down
+typedef struct {
+    Match match;
+    int lines[VERSUS_PLAYERS][4];
+    int top[VERSUS_PLAYERS];
+    unsigned char *cells[VERSUS_PLAYERS];
+    uint64_t *rows[VERSUS_PLAYERS];
+    int *fill[VERSUS_PLAYERS];
+} MatchSnapshot;
+
+typedef struct {
+    Match match;
+    // player index of this instance, the one on the lower port is 0
+    int local;
+    int remote;
+    NetLink net;
+    uint32_t seed;
+    // nothing is simulated before the peer answered, player 1 takes the
+    // seed of player 0 from its first packet
+    bool connected;
+    uint8_t inputs[VERSUS_PLAYERS][VERSUS_HISTORY];
+    // the remote inputs of all ticks before confirmed are known, later
+    // ones are predictions
+    uint32_t confirmed;
+    // the peer has the local inputs of all ticks before acked
+    uint32_t acked;
+    // tick of the newest packet of the peer, and how far it was ahead of
+    // the local game as far as it knew
+    uint32_t remote_tick;
+    int remote_advantage;
+    // running average of how many ticks this side is ahead of the peer
+    float drift;
+    uint32_t last_sync;
+    MatchSnapshot snapshots[ROLLBACK_WINDOW];
+    // hashes of the confirmed states at every VERSUS_HASH_INTERVAL ticks
+    uint32_t hash_ticks[VERSUS_HASHES];
+    uint64_t hashes[VERSUS_HASHES];
+    uint32_t remote_hash_ticks[VERSUS_HASHES];
+    uint64_t remote_hashes[VERSUS_HASHES];
+    uint32_t next_hash;
+    // the last versus_tick went back in time
+    bool rolled_back;
+
+    uint32_t rollbacks;
+    uint32_t resimulated;
+    uint32_t max_rollback;
+    uint32_t stalls;
+    uint32_t sync_waits;
+    uint32_t hash_checks;
+    uint32_t desyncs;
+    double rollback_ms;
+    // time every versus_tick took, rollback included
+    float tick_ms[VERSUS_TIMES];
+    int tick_next;
+    int tick_count;
+} Versus;
+
+bool match_init(Match *match, int width, int height, uint32_t seed);
+// starts over with both games dealt the pieces of seed
+void match_reset(Match *match, uint32_t seed);
+// advances both games by one tick and stores their STEP_* events
+void match_step(Match *match, const int inputs[VERSUS_PLAYERS],
+                int events[VERSUS_PLAYERS]);
+// FNV-1a hash of both games and the garbage in flight
+uint64_t match_hash(const Match *match);
+void match_free(Match *match);
+
+// opens the link to the peer at host:port, which has to be set up the
+// same way. returns false with errno set on failure
+bool versus_init(Versus *versus, int width, int height, int clear_ticks,
+                 uint32_t seed, int local_port, const char *host, int port,
+                 LinkConditions link);
+// exchanges inputs with the peer, rolls back when a prediction was wrong
+// and simulates the next tick with the local input. returns false when the
+// game has to wait for the peer instead, events is only set otherwise
+bool versus_tick(Versus *versus, int input, int events[VERSUS_PLAYERS]);
+// the match has a winner that no remote input can change anymore
+bool versus_finished(const Versus *versus);
+// percentiles of the versus_tick times in ms, false without samples
+bool versus_tick_times(const Versus *versus, float *p50, float *p99,
+                       float *max);
+void versus_free(Versus *versus);
+
+#endif
@@ -0,0 +1,80 @@
+// compares two runs of build/bench, benchmark by benchmark
+//
+// usage: bench_compare BASE.json NEW.json
+// prints the median of every benchmark found in both and how many times
+// faster NEW is, and the geometric mean of that over all of them
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RESULTS 256
+#define NAME_LENGTH 64
+
+typedef struct {
+    char name[NAME_LENGTH];
+    double median;
+} Result;
+
+// reads the one result per line that build/bench prints
+static int read_results(const char *path, Result *results) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: failed to open %s\n", path);
+        exit(1);
+    }
+
+    int count = 0;
+    char line[512];
+    while (count < MAX_RESULTS && fgets(line, sizeof(line), file) != NULL) {
+        const char *name = strstr(line, "\"name\": \"");
+        const char *median = strstr(line, "\"median\": ");
+        if (name == NULL || median == NULL)
+            continue;
+        Result *result = &results[count];
+        if (sscanf(name + 9, "%63[^\"]", result->name) == 1 &&
+            sscanf(median + 10, "%lf", &result->median) == 1)
+            count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s BASE.json NEW.json\n", argv[0]);
+        exit(1);
+    }
+
+    static Result base[MAX_RESULTS], new[MAX_RESULTS];
+    int base_count = read_results(argv[1], base);
+    int new_count = read_results(argv[2], new);
+
+    printf("%-28s %14s %14s %8s\n", "benchmark", "base ns/op", "new ns/op",
+           "speedup");
+    double log_sum = 0;
+    int matched = 0;
+    for (int i = 0; i < base_count; i++) {
+        for (int j = 0; j < new_count; j++) {
+            if (strcmp(base[i].name, new[j].name) != 0 ||
+                new[j].median <= 0 || base[i].median <= 0)
+                continue;
+            double speedup = base[i].median / new[j].median;
+            printf("%-28s %14.2f %14.2f %7.2fx\n", base[i].name,
+                   base[i].median, new[j].median, speedup);
+            log_sum += log(speedup);
+            matched++;
+            break;
+        }
+    }
+
+    if (matched == 0) {
+        fprintf(stderr, "ERROR: no benchmark is in both %s and %s\n",
+                argv[1], argv[2]);
+        exit(1);
+    }
+    printf("geometric mean of %d: %.2fx\n", matched, exp(log_sum / matched));
+    return 0;
+}
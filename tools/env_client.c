@@ -0,0 +1,128 @@
+// example trainer for the shared memory environment, plays random
+// placements in every game and reports the step rate
+//
+// usage: env_client NAME [STEPS]
+// with the environment started by: tetris --env NAME [--envs N]
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/env.h"
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// publishes step n and waits until the environment has played it. the
+// wait spins and only yields now and then, in case both sides share a core
+static void run_step(EnvHeader *header, uint64_t n) {
+    atomic_store_explicit(&header->request, n, memory_order_release);
+    for (int spins = 1;
+         atomic_load_explicit(&header->done, memory_order_acquire) < n;
+         spins++) {
+        if (spins % 1024 == 0)
+            sched_yield();
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s NAME [STEPS]\n", argv[0]);
+        exit(1);
+    }
+    long steps = argc > 2 ? atol(argv[2]) : 10000;
+
+    // wait for the environment to come up
+    int fd = -1;
+    for (int tries = 0; fd < 0 && tries < 100; tries++) {
+        fd = shm_open(argv[1], O_RDWR, 0);
+        if (fd < 0)
+            usleep(50000);
+    }
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "ERROR: failed to open environment %s\n", argv[1]);
+        exit(1);
+    }
+
+    EnvHeader *header =
+        mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        fprintf(stderr, "ERROR: failed to map environment %s\n", argv[1]);
+        exit(1);
+    }
+
+    while (atomic_load_explicit(&header->magic, memory_order_acquire) !=
+           ENV_MAGIC)
+        usleep(1000);
+    if (header->version != ENV_VERSION) {
+        fprintf(stderr, "ERROR: environment version %u, expected %d\n",
+                header->version, ENV_VERSION);
+        exit(1);
+    }
+
+    int count = header->count;
+    printf("%d games on %ux%u boards\n", count, header->width,
+           header->height);
+
+    uint64_t n = atomic_load(&header->done);
+    uint32_t rng = 1;
+
+    // start from a known piece sequence
+    EnvSlot *slot = ENV_SLOT(header, ++n);
+    slot->command = ENV_RESET;
+    slot->seed = 42;
+    run_step(header, n);
+
+    long long reward = 0;
+    long long episodes = 0;
+    double start = now();
+
+    for (long s = 0; s < steps; s++) {
+        slot = ENV_SLOT(header, ++n);
+        slot->command = ENV_STEP;
+        EnvAction *actions = ENV_ACTIONS(header, slot);
+        for (int i = 0; i < count; i++) {
+            actions[i].rotation = xorshift(&rng) % 4;
+            actions[i].x = (int)(xorshift(&rng) % (header->width + 2)) - 1;
+        }
+
+        run_step(header, n);
+
+        const EnvObservation *obs = ENV_OBSERVATIONS(header, slot);
+        for (int i = 0; i < count; i++) {
+            reward += obs[i].reward;
+            episodes += obs[i].done;
+        }
+    }
+
+    double elapsed = now() - start;
+    printf("%ld steps of %d games in %.3fs: %.0f env steps/s, %lld "
+           "episodes, reward %lld\n",
+           steps, count, elapsed, steps * count / elapsed, episodes,
+           reward);
+
+    slot = ENV_SLOT(header, ++n);
+    slot->command = ENV_CLOSE;
+    atomic_store_explicit(&header->request, n, memory_order_release);
+
+    munmap(header, st.st_size);
+    return 0;
+}
@@ -0,0 +1,149 @@
+// checks the row masks of the engine against its cells
+//
+// usage: fit_check [SEED]
+// fills random boards of several sizes, up to BOARD_MAX_WIDTH wide, and
+// compares bitboard_piece_fits with does_piece_fit for every piece type,
+// rotation and position, the ones hanging off every edge included. then
+// plays random games on them and compares rows and fill with the cells
+// after every tick. exits with 1 on the first difference
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/engine.h"
+
+// boards filled per size, fill percentages cycle through these
+#define BOARDS 8
+#define GAME_TICKS 20000
+
+static const int sizes[][2] = {
+    {4, 4},   {BOARD_WIDTH, BOARD_HEIGHT}, {7, 13},
+    {31, 9},  {BOARD_MAX_WIDTH, 64},       {BOARD_MAX_WIDTH, 400},
+    {17, BOARD_MAX_HEIGHT},
+};
+static const int percents[] = {0, 20, 60, 95};
+
+// the same filling as the benchmarks, rows from the bottom up
+static void fill_board(GameState *state, int rows, int percent,
+                       uint32_t *rng) {
+    Board *board = &state->board;
+    for (int y = board->height - rows; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            if ((int)(engine_rand(rng) % 100) >= percent)
+                continue;
+            board->cells[y * board->width + x] = 1;
+            board->rows[y] |= UINT64_C(1) << x;
+            board->fill[y]++;
+        }
+    }
+}
+
+static bool check_fits(const Board *board) {
+    for (int type = 0; type < PIECE_COUNT; type++) {
+        for (int rotation = 0; rotation < 4; rotation++) {
+            for (int y = -4; y <= board->height; y++) {
+                for (int x = -5; x <= board->width + 1; x++) {
+                    bool expected =
+                        does_piece_fit(board, type, x, y, rotation);
+                    if (bitboard_piece_fits(board, type, x, y, rotation) ==
+                        expected)
+                        continue;
+                    fprintf(stderr,
+                            "ERROR: %dx%d board, piece %d rotation %d at "
+                            "%d,%d: cells say %s, masks disagree\n",
+                            board->width, board->height, type, rotation, x,
+                            y, expected ? "fits" : "doesn't fit");
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool check_rows(const Board *board, int tick) {
+    for (int y = 0; y < board->height; y++) {
+        uint64_t bits = 0;
+        int fill = 0;
+        for (int x = 0; x < board->width; x++) {
+            if (board->cells[y * board->width + x] != 0) {
+                bits |= UINT64_C(1) << x;
+                fill++;
+            }
+        }
+        if (board->rows[y] == bits && board->fill[y] == fill)
+            continue;
+        fprintf(stderr,
+                "ERROR: %dx%d board, tick %d: row %d is %016llx with %d "
+                "cells, the cells make %016llx with %d\n",
+                board->width, board->height, tick, y,
+                (unsigned long long)board->rows[y], board->fill[y],
+                (unsigned long long)bits, fill);
+        return false;
+    }
+    return true;
+}
+
+// a new game on a board filled below the 4 rows the pieces spawn in
+static void start_game(GameState *state, uint32_t *rng) {
+    game_state_reset(state, engine_rand(rng));
+    int rows = state->board.height / 2;
+    if (rows > state->board.height - 4)
+        rows = state->board.height - 4;
+    fill_board(state, rows, 40, rng);
+}
+
+// random inputs on a filled board, every lock and line clear has to keep
+// the masks in step with the cells
+static bool check_game(GameState *state, uint32_t *rng) {
+    start_game(state, rng);
+    for (int tick = 0; tick < GAME_TICKS; tick++) {
+        uint32_t r = engine_rand(rng);
+        int input = r & (INPUT_LEFT | INPUT_RIGHT | INPUT_ROTATE);
+        if (r & 0x100)
+            input |= INPUT_SOFT_DROP;
+        game_state_apply_input(state, input);
+        int events = game_state_step(state);
+        if ((events & (STEP_LOCKED | STEP_CLEARED)) &&
+            !check_rows(&state->board, tick))
+            return false;
+        if (events & STEP_OVER)
+            start_game(state, rng);
+    }
+    return check_rows(&state->board, GAME_TICKS);
+}
+
+int main(int argc, char **argv) {
+    uint32_t rng = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+    if (rng == 0)
+        rng = 1;
+
+    int count = sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < count; i++) {
+        int width = sizes[i][0];
+        int height = sizes[i][1];
+        GameState state;
+        if (!game_state_init(&state, width, height, engine_rand(&rng))) {
+            fprintf(stderr, "ERROR: failed to set up a %dx%d board\n", width,
+                    height);
+            return 1;
+        }
+
+        for (int b = 0; b < BOARDS; b++) {
+            game_state_reset(&state, engine_rand(&rng));
+            int rows = 1 + engine_rand(&rng) % height;
+            fill_board(&state, rows, percents[b % 4], &rng);
+            if (!check_fits(&state.board)) {
+                game_state_free(&state);
+                return 1;
+            }
+        }
+        bool ok = check_game(&state, &rng);
+        game_state_free(&state);
+        if (!ok)
+            return 1;
+        printf("%dx%d ok\n", width, height);
+    }
+    return 0;
+}
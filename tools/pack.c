@@ -0,0 +1,109 @@
+// packs files into the format described in src/assets.h
+//
+// usage: pack ROOT OUT NAME...
+// reads ROOT/NAME for every NAME and stores it under NAME
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/assets.h"
+
+#define HEADER_SIZE 8
+#define ENTRY_SIZE (ASSET_NAME_LENGTH + 8)
+#define ALIGN 16
+
+static void put_u32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        p[i] = value >> (8 * i);
+}
+
+static unsigned char *read_file(const char *path, long *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    unsigned char *data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (*size = ftell(file)) >= 0 &&
+        fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc(*size + 1);
+        if (data != NULL && fread(data, 1, *size, file) != (size_t)*size) {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+    return data;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s ROOT OUT NAME...\n", argv[0]);
+        exit(1);
+    }
+
+    int count = argc - 3;
+    size_t index_size = HEADER_SIZE + (size_t)count * ENTRY_SIZE;
+    size_t offset = (index_size + ALIGN - 1) / ALIGN * ALIGN;
+
+    unsigned char *index = calloc(offset, 1);
+    unsigned char **files = calloc(count, sizeof(unsigned char *));
+    long *sizes = calloc(count, sizeof(long));
+    if (index == NULL || files == NULL || sizes == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    memcpy(index, "TPAK", 4);
+    put_u32(index + 4, count);
+
+    for (int i = 0; i < count; i++) {
+        const char *name = argv[i + 3];
+        if (strlen(name) >= ASSET_NAME_LENGTH) {
+            fprintf(stderr, "ERROR: asset name %s is too long\n", name);
+            exit(1);
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", argv[1], name);
+        files[i] = read_file(path, &sizes[i]);
+        if (files[i] == NULL) {
+            fprintf(stderr, "ERROR: failed to read %s\n", path);
+            exit(1);
+        }
+
+        unsigned char *entry = index + HEADER_SIZE + i * ENTRY_SIZE;
+        memcpy(entry, name, strlen(name));
+        put_u32(entry + ASSET_NAME_LENGTH, offset);
+        put_u32(entry + ASSET_NAME_LENGTH + 4, sizes[i]);
+        offset = (offset + sizes[i] + ALIGN - 1) / ALIGN * ALIGN;
+    }
+
+    if (offset > UINT32_MAX) {
+        fprintf(stderr, "ERROR: assets don't fit in a pack\n");
+        exit(1);
+    }
+
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: failed to open %s\n", argv[2]);
+        exit(1);
+    }
+
+    static const unsigned char padding[ALIGN];
+    size_t written = fwrite(index, 1, (index_size + ALIGN - 1) / ALIGN * ALIGN,
+                            out);
+    for (int i = 0; i < count; i++) {
+        written += fwrite(files[i], 1, sizes[i], out);
+        written += fwrite(padding, 1, -sizes[i] & (ALIGN - 1), out);
+    }
+
+    if (fclose(out) != 0 || written != offset) {
+        fprintf(stderr, "ERROR: failed to write %s\n", argv[2]);
+        exit(1);
+    }
+
+    return 0;
+}